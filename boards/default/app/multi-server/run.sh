@@ -1,6 +1,8 @@
 #!/usr/bin/env bash
 # run_udp_servers.sh — start N udp_server processes on ports 9000..9000+N-1
 # Clean shutdown: Ctrl-C kills all children (INT → TERM → KILL).
+# One process can serve the same ports with pinned worker threads instead:
+#   ./udp_server 0.0.0.0 9000 --threads <T> --ports <N>
 
 set -euo pipefail
 
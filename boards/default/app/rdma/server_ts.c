@@ -12,6 +12,8 @@
 #include <infiniband/verbs.h>
 #include <time.h>
 
+#include "results_sink.h"
+
 static void die(const char *m) { perror(m); exit(1); }
 
 /* ---------- signal handling ---------- */
@@ -85,7 +87,18 @@ static void rows_reserve(size_t need) {
     if (!n) { perror("realloc rows"); exit(2); }
     g_rows = n; g_rows_cap = ncap;
 }
+/* With -r, rows stream to a results file as they complete instead of piling up here */
+static struct results_stream *g_results = NULL;
+
 static inline void rows_push(row_t r) {
+    if (g_results) {
+        struct results_rec rec = {
+            .seq = (uint32_t)r.idx, .size = r.size,
+            .t = r.rx_ns, .value = (r.tx_ns >= r.rx_ns) ? (r.tx_ns - r.rx_ns) : 0ULL,
+        };
+        results_push(g_results, &rec);
+        return;
+    }
     if (g_rows_sz + 1 > g_rows_cap) rows_reserve(g_rows_sz + 1);
     g_rows[g_rows_sz++] = r;
 }
@@ -135,17 +148,32 @@ int main(int argc, char **argv) {
     const char *bind_ip = NULL;
     int port = 7471;
     int msg_size = 64;
+    const char *results_path = NULL;
 
     int opt;
-    while ((opt = getopt(argc, argv, "a:p:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "a:p:s:r:")) != -1) {
         if (opt == 'a') bind_ip = optarg;
         else if (opt == 'p') port = atoi(optarg);
         else if (opt == 's') msg_size = atoi(optarg);
+        else if (opt == 'r') results_path = optarg;
     }
-    if (!bind_ip) { fprintf(stderr, "Usage: %s -a <bind_ip> [-p port] [-s size]\n", argv[0]); return 2; }
+    if (!bind_ip) { fprintf(stderr, "Usage: %s -a <bind_ip> [-p port] [-s size] [-r results.bin]\n", argv[0]); return 2; }
 
     install_sig_handlers();
 
+    struct results_sink *sink = NULL;
+    if (results_path) {
+        struct results_sink_cfg rcfg = {
+            .scale = 1.0, .unit = "ns", .clock = "device-or-host",
+            .col_t = "rx_time", .col_value = "delta",
+            .writer_cpu = -1,
+        };
+        sink = results_sink_open(results_path, &rcfg);
+        if (!sink) die(results_path);
+        g_results = results_sink_stream(sink);
+        if (!g_results) die("results_sink_stream");
+    }
+
     // --- RDMA CM: resolve and listen ---
     struct rdma_event_channel *ec = rdma_create_event_channel();
     if (!ec) die("rdma_create_event_channel");
@@ -267,7 +295,13 @@ int main(int argc, char **argv) {
     }
 
     // --- dump CSV on signal/exit ---
-    write_csv((uint32_t)msg_size, port);
+    if (sink) {
+        int64_t n = results_sink_close(sink);
+        if (n < 0) fprintf(stderr, "write to %s failed\n", results_path);
+        else printf("Wrote %lld rows to %s\n", (long long)n, results_path);
+    } else {
+        write_csv((uint32_t)msg_size, port);
+    }
 
     // Cleanup
     rdma_disconnect(id);
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -18,6 +19,8 @@
 #include <unistd.h>
 #include <pthread.h>
 
+#include "results_sink.h"
+
 #ifndef CLOCK_MONOTONIC
 #define CLOCK_MONOTONIC 1
 #endif
@@ -29,6 +32,22 @@
 #define DEF_BASE_PORT   1200
 #define DEF_TIMEOUT_MS  1000
 #define DEF_OUTFILE     "udp_results.csv"
+#define DEF_WINDOW      1
+#define DEF_BATCH       32
+
+// ---------- event mode ----------
+#define EV_MAX_EVENTS   64
+#define EV_SCAN_NS      1000000LL   // timeout and refill scan period
+
+// Event mode carries its seq at this payload offset: udp_server increments byte 0 of each reply
+#define EV_SEQ_OFF      4
+
+// One request in flight on a flow, found again by seq % window
+struct ev_slot {
+    uint32_t        seq;
+    bool            busy;
+    long long       t0_ns;
+};
 
 // ---------- per-thread context ----------
 struct thread_ctx {
@@ -39,22 +58,56 @@ struct thread_ctx {
     size_t          size;
     int             timeout_ms;
 
-    long long      *rtt_us;      // per request; -1 on timeout
+    long long      *rtt_us;      // per request; -1 on timeout (NULL with --results)
+    struct results_stream *results;  // streamed samples with --results
+    long long       sum_ns;
     int             ok;
     int             timeouts;
+
+    // Event mode: the flow's socket and its window of outstanding requests
+    int             fd;
+    int             window;
+    int             next_seq;    // next request to send
+    int             resolved;    // requests answered or given up on
+    int             inflight;
+    struct ev_slot *slots;       // [window]
+    uint8_t        *txbuf;       // [window][size], one payload per slot
+};
+
+// Event mode: one pinned thread multiplexing a share of the flows
+struct worker_ctx {
+    int                 widx;
+    int                 cpu;         // -1: leave unpinned
+    int                 batch;       // recvmmsg/sendmmsg vector length
+    bool                spin;        // poll epoll instead of sleeping in it
+    struct thread_ctx **flows;
+    int                 nflows;
+    struct results_stream *results;
 };
 
+// Store one sample (ns, or -1 for a lost request) in the array or the results stream
+static inline void record_rtt(struct thread_ctx *ctx, int i, long long ns, long long t_ns) {
+    if (ctx->rtt_us) ctx->rtt_us[i] = ns;
+    if (ctx->results) {
+        struct results_rec rec = {
+            .seq = (uint32_t)i, .stream = ctx->dport, .size = (uint32_t)ctx->size,
+            .flags = ns < 0 ? RESULTS_F_LOST : 0,
+            .t = (uint64_t)t_ns, .value = ns < 0 ? 0 : (uint64_t)ns,
+        };
+        results_push(ctx->results, &rec);
+    }
+}
+
+static void record_all_lost(struct thread_ctx *ctx) {
+    for (int i = 0; i < ctx->count; i++) record_rtt(ctx, i, -1, 0);
+}
+
 static void print_per_connection_avg(struct thread_ctx *ctx, int nthreads, int count) {
     printf("Per-connection average RTTs:\n");
     for (int i = 0; i < nthreads; i++) {
-        long long sum_ns = 0;
-        int ok = 0;
-        for (int k = 0; k < count; k++) {
-            long long ns = ctx[i].rtt_us[k];    // stored in ns; -1 means timeout
-            if (ns >= 0) { sum_ns += ns; ok++; }
-        }
+        int ok = ctx[i].ok;
         if (ok > 0) {
-            double avg_us = (double)sum_ns / (double)ok / 1000.0;  // ns -> µs
+            double avg_us = (double)ctx[i].sum_ns / (double)ok / 1000.0;  // ns -> µs
             printf("  port %u: avg = %.1f us  (ok=%d/%d, timeouts=%d)\n",
                    (unsigned)ctx[i].dport, avg_us, ok, count, count - ok);
         } else {
@@ -69,6 +122,10 @@ static inline long long tsdiff_ns(struct timespec a, struct timespec b) {
     return sec * 1000000000LL + nsec; // total ns
 }
 
+static inline long long ts_ns(struct timespec t) {
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
 #include <linux/net_tstamp.h>
 #include <linux/sockios.h>
 #include <linux/if.h>
@@ -111,21 +168,12 @@ static int enable_sock_ts(int fd) {
     return 0;
 }
 
-static void *thread_main(void *arg) {
-    struct thread_ctx *ctx = (struct thread_ctx *)arg;
-
+// Socket bound to source port == destination port and connected to the server; -1 on error
+static int open_flow_socket(struct thread_ctx *ctx) {
     int fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (fd < 0) {
         perror("socket");
-        for (int i = 0; i < ctx->count; i++) ctx->rtt_us[i] = -1;
-        return NULL;
-    }
-
-    struct timeval tv;
-    tv.tv_sec  = ctx->timeout_ms / 1000;
-    tv.tv_usec = (ctx->timeout_ms % 1000) * 1000;
-    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        perror("setsockopt(SO_RCVTIMEO)");
+        return -1;
     }
 
     struct sockaddr_in dst = {0};
@@ -133,9 +181,8 @@ static void *thread_main(void *arg) {
     dst.sin_port        = htons(ctx->dport);
     if (inet_pton(AF_INET, ctx->server, &dst.sin_addr) != 1) {
         fprintf(stderr, "[t%02d] bad server IP: %s\n", ctx->tidx, ctx->server);
-        for (int i = 0; i < ctx->count; i++) ctx->rtt_us[i] = -1;
         close(fd);
-        return NULL;
+        return -1;
     }
 
     int one = 1;
@@ -149,23 +196,39 @@ static void *thread_main(void *arg) {
 
     if (bind(fd, (struct sockaddr*)&src, sizeof(src)) < 0) {
         perror("bind (source port == dest port)");
-        // mark this thread's requests as failed and exit gracefully
-        for (int i = 0; i < ctx->count; i++) ctx->rtt_us[i] = -1;
         close(fd);
-        return NULL;
+        return -1;
     }
 
     if (connect(fd, (struct sockaddr *)&dst, sizeof(dst)) < 0) {
         perror("connect");
-        for (int i = 0; i < ctx->count; i++) ctx->rtt_us[i] = -1;
         close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *thread_main(void *arg) {
+    struct thread_ctx *ctx = (struct thread_ctx *)arg;
+
+    int fd = open_flow_socket(ctx);
+    if (fd < 0) {
+        // mark this thread's requests as failed and exit gracefully
+        record_all_lost(ctx);
         return NULL;
     }
 
+    struct timeval tv;
+    tv.tv_sec  = ctx->timeout_ms / 1000;
+    tv.tv_usec = (ctx->timeout_ms % 1000) * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        perror("setsockopt(SO_RCVTIMEO)");
+    }
+
     uint8_t *buf = (uint8_t *)malloc(ctx->size);
     if (!buf) {
         perror("malloc payload");
-        for (int i = 0; i < ctx->count; i++) ctx->rtt_us[i] = -1;
+        record_all_lost(ctx);
         close(fd);
         return NULL;
     }
@@ -173,6 +236,7 @@ static void *thread_main(void *arg) {
 
     ctx->ok = 0;
     ctx->timeouts = 0;
+    ctx->sum_ns = 0;
 
     for (int i = 0; i < ctx->count; i++) {
         if (ctx->size >= 4) {
@@ -183,34 +247,36 @@ static void *thread_main(void *arg) {
         struct timespec t0, t1;
         if (clock_gettime(CLOCK_MONOTONIC, &t0) != 0) {
             perror("clock_gettime");
-            ctx->rtt_us[i] = -1;
+            record_rtt(ctx, i, -1, 0);
             continue;
         }
 
         ssize_t sret = send(fd, buf, ctx->size, 0);
         if (sret < 0) {
             perror("send");
-            ctx->rtt_us[i] = -1;
+            record_rtt(ctx, i, -1, ts_ns(t0));
             continue;
         }
 
         ssize_t rret = recv(fd, buf, ctx->size, 0);
         if (clock_gettime(CLOCK_MONOTONIC, &t1) != 0) {
             perror("clock_gettime");
-            ctx->rtt_us[i] = -1;
+            record_rtt(ctx, i, -1, 0);
             continue;
         }
 
+        long long t1_ns = ts_ns(t1);
         if (rret < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                ctx->rtt_us[i] = -1;
                 ctx->timeouts++;
             } else {
                 perror("recv");
-                ctx->rtt_us[i] = -1;
             }
+            record_rtt(ctx, i, -1, t1_ns);
         } else {
-            ctx->rtt_us[i] = tsdiff_ns(t0, t1);
+            long long ns = tsdiff_ns(t0, t1);
+            record_rtt(ctx, i, ns, t1_ns);
+            ctx->sum_ns += ns;
             ctx->ok++;
         }
     }
@@ -220,13 +286,253 @@ static void *thread_main(void *arg) {
     return NULL;
 }
 
+// ---------- event mode: few pinned workers, many flows ----------
+
+static inline long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ts_ns(t);
+}
+
+// Give up on one outstanding request (send error or timeout)
+static void flow_lose(struct thread_ctx *f, struct ev_slot *slot, long long t_ns) {
+    record_rtt(f, (int)slot->seq, -1, t_ns);
+    slot->busy = false;
+    f->inflight--;
+    f->resolved++;
+}
+
+// Top the flow's window up with one sendmmsg; the batch shares one send timestamp
+static void flow_fill(struct worker_ctx *w, struct thread_ctx *f,
+                      struct mmsghdr *msgs, struct iovec *iov) {
+    int n = 0;
+
+    // Stop at a slot still held by an older request, so replies always find their own
+    while (f->inflight + n < f->window && f->next_seq + n < f->count && n < w->batch &&
+           !f->slots[(f->next_seq + n) % f->window].busy) {
+        int seq = f->next_seq + n;
+        uint8_t *p = f->txbuf + (size_t)(seq % f->window) * f->size;
+        uint32_t nseq = htonl((uint32_t)seq);
+
+        memcpy(p + EV_SEQ_OFF, &nseq, 4);
+        iov[n].iov_base = p;
+        iov[n].iov_len  = f->size;
+        memset(&msgs[n].msg_hdr, 0, sizeof(msgs[n].msg_hdr));
+        msgs[n].msg_hdr.msg_iov    = &iov[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+        n++;
+    }
+    if (n == 0) return;
+
+    long long t0 = now_ns();
+    int sent = sendmmsg(f->fd, msgs, (unsigned)n, MSG_DONTWAIT);
+    if (sent < 0) {
+        // A full socket buffer is retried on the next scan; anything else loses the request
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        perror("sendmmsg");
+        sent = 0;
+        struct ev_slot *slot = &f->slots[f->next_seq % f->window];
+        slot->seq  = (uint32_t)f->next_seq++;
+        slot->busy = true;
+        f->inflight++;
+        flow_lose(f, slot, t0);
+        return;
+    }
+
+    for (int k = 0; k < sent; k++) {
+        struct ev_slot *slot = &f->slots[f->next_seq % f->window];
+        slot->seq   = (uint32_t)f->next_seq++;
+        slot->busy  = true;
+        slot->t0_ns = t0;
+        f->inflight++;
+    }
+}
+
+// Match every queued reply to its request by seq; one receive timestamp per recvmmsg
+static void flow_drain(struct worker_ctx *w, struct thread_ctx *f,
+                       struct mmsghdr *msgs, struct iovec *iov, uint8_t *rxbuf) {
+    for (;;) {
+        for (int k = 0; k < w->batch; k++) {
+            iov[k].iov_base = rxbuf + (size_t)k * f->size;
+            iov[k].iov_len  = f->size;
+            memset(&msgs[k].msg_hdr, 0, sizeof(msgs[k].msg_hdr));
+            msgs[k].msg_hdr.msg_iov    = &iov[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+        }
+
+        int got = recvmmsg(f->fd, msgs, (unsigned)w->batch, MSG_DONTWAIT, NULL);
+        long long t1 = now_ns();
+        if (got <= 0) {
+            if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+                perror("recvmmsg");
+            return;
+        }
+
+        for (int k = 0; k < got; k++) {
+            uint32_t seq;
+
+            if (msgs[k].msg_len < EV_SEQ_OFF + 4) continue;
+            memcpy(&seq, (uint8_t *)iov[k].iov_base + EV_SEQ_OFF, 4);
+            seq = ntohl(seq);
+
+            // A reply for a request that already timed out finds its slot reused or idle
+            struct ev_slot *slot = &f->slots[seq % (uint32_t)f->window];
+            if (!slot->busy || slot->seq != seq) continue;
+
+            long long ns = t1 - slot->t0_ns;
+            record_rtt(f, (int)seq, ns, t1);
+            f->sum_ns += ns;
+            f->ok++;
+            slot->busy = false;
+            f->inflight--;
+            f->resolved++;
+        }
+        if (got < w->batch) return;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker_ctx *w = (struct worker_ctx *)arg;
+    struct epoll_event evs[EV_MAX_EVENTS];
+    size_t maxsize = 0;
+    int active = 0;
+
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "[w%02d] cannot pin to cpu %d\n", w->widx, w->cpu);
+    }
+
+    int ep = epoll_create1(0);
+    if (ep < 0) {
+        perror("epoll_create1");
+        for (int i = 0; i < w->nflows; i++) record_all_lost(w->flows[i]);
+        return NULL;
+    }
+
+    for (int i = 0; i < w->nflows; i++) {
+        struct thread_ctx *f = w->flows[i];
+
+        f->results = w->results;
+        if (f->size > maxsize) maxsize = f->size;
+        f->fd = open_flow_socket(f);
+        if (f->fd < 0) {
+            record_all_lost(f);
+            f->resolved = f->count;
+            continue;
+        }
+
+        f->slots = (struct ev_slot *)calloc((size_t)f->window, sizeof(*f->slots));
+        f->txbuf = (uint8_t *)malloc((size_t)f->window * f->size);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = f };
+        if (!f->slots || !f->txbuf || epoll_ctl(ep, EPOLL_CTL_ADD, f->fd, &ev) < 0) {
+            perror("flow setup");
+            record_all_lost(f);
+            f->resolved = f->count;
+            close(f->fd);
+            f->fd = -1;
+            continue;
+        }
+        for (int k = 0; k < f->window; k++)
+            for (size_t b = 0; b < f->size; b++)
+                f->txbuf[(size_t)k * f->size + b] = (uint8_t)(b & 0xff);
+        active++;
+    }
+
+    struct mmsghdr *msgs = (struct mmsghdr *)calloc((size_t)w->batch, sizeof(*msgs));
+    struct iovec *iov = (struct iovec *)calloc((size_t)w->batch, sizeof(*iov));
+    uint8_t *rxbuf = (uint8_t *)malloc((size_t)w->batch * (maxsize ? maxsize : 1));
+    if (!msgs || !iov || !rxbuf) {
+        perror("malloc batch");
+        active = 0;
+    }
+
+    for (int i = 0; i < w->nflows && active; i++)
+        if (w->flows[i]->fd >= 0) flow_fill(w, w->flows[i], msgs, iov);
+
+    long long last_scan = now_ns();
+    while (active > 0) {
+        int n = epoll_wait(ep, evs, EV_MAX_EVENTS, w->spin ? 0 : 1);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct thread_ctx *f = (struct thread_ctx *)evs[i].data.ptr;
+            flow_drain(w, f, msgs, iov, rxbuf);
+            flow_fill(w, f, msgs, iov);
+        }
+
+        // Expire overdue requests, retry blocked sends and retire finished flows
+        long long now = now_ns();
+        if (now - last_scan < EV_SCAN_NS) continue;
+        last_scan = now;
+
+        for (int i = 0; i < w->nflows; i++) {
+            struct thread_ctx *f = w->flows[i];
+            if (f->fd < 0) continue;
+
+            for (int k = 0; k < f->window; k++) {
+                struct ev_slot *slot = &f->slots[k];
+                if (slot->busy && now - slot->t0_ns > (long long)f->timeout_ms * 1000000LL) {
+                    f->timeouts++;
+                    flow_lose(f, slot, now);
+                }
+            }
+            flow_fill(w, f, msgs, iov);
+
+            if (f->resolved >= f->count) {
+                close(f->fd);
+                f->fd = -1;
+                active--;
+            }
+        }
+    }
+
+    // Anything still open (epoll failure) never got an answer
+    for (int i = 0; i < w->nflows; i++) {
+        struct thread_ctx *f = w->flows[i];
+        if (f->fd >= 0) {
+            for (int k = 0; k < f->window; k++)
+                if (f->slots[k].busy) flow_lose(f, &f->slots[k], now_ns());
+            for (; f->next_seq < f->count; f->next_seq++) record_rtt(f, f->next_seq, -1, 0);
+            close(f->fd);
+            f->fd = -1;
+        }
+        free(f->slots);
+        free(f->txbuf);
+        f->slots = NULL;
+        f->txbuf = NULL;
+    }
+    free(msgs);
+    free(iov);
+    free(rxbuf);
+    close(ep);
+    return NULL;
+}
+
 static void usage(const char *p) {
     fprintf(stderr,
         "Usage: %s --server IP [--threads N] [--count K] [--size BYTES]\n"
         "          [--base-port P] [--timeout-ms MS] [--outfile PATH]\n"
+        "          [--results PATH]   stream samples to a binary file (see lib/results_dump)\n"
+        "                             instead of holding them for the CSV\n"
+        "          [--workers W [--window N] [--batch B] [--spin]]\n"
+        "\n"
+        "By default each of the --threads flows gets its own thread and blocking socket.\n"
+        "With --workers the flows are spread over W threads pinned to CPUs 0..W-1.\n"
+        "Each worker drives its sockets through epoll, keeping up to --window requests\n"
+        "in flight per flow. Replies are matched by sequence number and batched\n"
+        "through recvmmsg/sendmmsg (up to --batch per call, sharing one timestamp).\n"
+        "--spin polls epoll instead of sleeping in it.\n"
         "\n"
-        "Defaults: threads=%d count=%d size=%d base-port=%d timeout-ms=%d outfile=%s\n",
-        p, DEF_THREADS, DEF_COUNT, DEF_SIZE, DEF_BASE_PORT, DEF_TIMEOUT_MS, DEF_OUTFILE);
+        "Defaults: threads=%d count=%d size=%d base-port=%d timeout-ms=%d outfile=%s\n"
+        "          window=%d batch=%d\n",
+        p, DEF_THREADS, DEF_COUNT, DEF_SIZE, DEF_BASE_PORT, DEF_TIMEOUT_MS, DEF_OUTFILE,
+        DEF_WINDOW, DEF_BATCH);
 }
 
 int main(int argc, char **argv) {
@@ -238,6 +544,11 @@ int main(int argc, char **argv) {
         {"base-port",  required_argument, 0, 'p'},
         {"timeout-ms", required_argument, 0, 'm'},
         {"outfile",    required_argument, 0, 'o'},
+        {"results",    required_argument, 0, 'r'},
+        {"workers",    required_argument, 0, 'w'},
+        {"window",     required_argument, 0, 'W'},
+        {"batch",      required_argument, 0, 'b'},
+        {"spin",       no_argument,       0, 'S'},
         {"help",       no_argument,       0, 'h'},
         {0,0,0,0}
     };
@@ -250,11 +561,16 @@ int main(int argc, char **argv) {
     int   timeout_ms = DEF_TIMEOUT_MS;
     char  outfile[512];
     int   outfile_given = 0;                  // <— NEW
+    const char *results_path = NULL;
+    int   nworkers   = 0;                     // 0: one blocking thread per flow
+    int   window     = DEF_WINDOW;
+    int   batch      = DEF_BATCH;
+    bool  spin       = false;
     strncpy(outfile, DEF_OUTFILE, sizeof(outfile)-1);
     outfile[sizeof(outfile)-1] = '\0';
 
     int c;
-    while ((c = getopt_long(argc, argv, "s:t:c:z:p:m:o:h", opts, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "s:t:c:z:p:m:o:r:w:W:b:Sh", opts, NULL)) != -1) {
         switch (c) {
             case 's': strncpy(server, optarg, sizeof(server)-1); server[sizeof(server)-1] = '\0'; break;
             case 't': nthreads = atoi(optarg); break;
@@ -267,6 +583,11 @@ int main(int argc, char **argv) {
                 outfile[sizeof(outfile)-1] = '\0';
                 outfile_given = 1;                    // <— NEW
                 break;
+            case 'r': results_path = optarg; break;
+            case 'w': nworkers = atoi(optarg); break;
+            case 'W': window   = atoi(optarg); break;
+            case 'b': batch    = atoi(optarg); break;
+            case 'S': spin     = true; break;
             case 'h': default: usage(argv[0]); return (c=='h'?0:1);
         }
     }
@@ -276,6 +597,16 @@ int main(int argc, char **argv) {
         fprintf(stderr, "Invalid args: threads>0, count>0, size>0 required\n");
         return 1;
     }
+    if (nworkers < 0 || window <= 0 || batch <= 0) {
+        fprintf(stderr, "Invalid args: workers>=0, window>0, batch>0 required\n");
+        return 1;
+    }
+    if (nworkers > 0 && size < EV_SEQ_OFF + 4) {
+        fprintf(stderr, "Invalid args: --workers needs size>=%d to carry the sequence number\n",
+                EV_SEQ_OFF + 4);
+        return 1;
+    }
+    if (nworkers > nthreads) nworkers = nthreads;
     if (!outfile_given) {
         // udp_result_[nthread]_[packet_size].csv
         // (size is BYTES as passed via --size)
@@ -287,7 +618,25 @@ int main(int argc, char **argv) {
     pthread_t *ths = (pthread_t *)calloc(nthreads, sizeof(*ths));
     if (!ctx || !ths) { perror("calloc"); return 1; }
 
+    // With --results each thread streams into a fixed-size ring instead of count samples
+    struct results_sink *sink = NULL;
+    if (results_path) {
+        struct results_sink_cfg rcfg = {
+            .scale = 1e-3, .unit = "us", .clock = "CLOCK_MONOTONIC",
+            .col_t = "time", .col_value = "RTT",
+            .writer_cpu = -1,
+        };
+        sink = results_sink_open(results_path, &rcfg);
+        if (!sink) { perror(results_path); return 1; }
+    }
+
     for (int i = 0; i < nthreads; i++) {
+        if (sink && nworkers > 0) continue;  // workers own the streams, one each
+        if (sink) {
+            ctx[i].results = results_sink_stream(sink);
+            if (!ctx[i].results) { perror("results_sink_stream"); return 1; }
+            continue;
+        }
         ctx[i].rtt_us = (long long *)malloc(sizeof(long long) * (size_t)count);
         if (!ctx[i].rtt_us) { perror("malloc rtts"); return 1; }
         for (int k = 0; k < count; k++) ctx[i].rtt_us[k] = -1;
@@ -302,6 +651,9 @@ int main(int argc, char **argv) {
         ctx[i].count      = count;
         ctx[i].size       = size;
         ctx[i].timeout_ms = timeout_ms;
+        ctx[i].window     = window;
+        ctx[i].fd         = -1;
+        if (nworkers > 0) continue;
 
         int rc = pthread_create(&ths[i], NULL, thread_main, &ctx[i]);
         if (rc != 0) {
@@ -310,14 +662,56 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Event mode: flow i goes to worker i % W
+    struct worker_ctx *wk = NULL;
+    struct thread_ctx **flowv = NULL;
+    if (nworkers > 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        wk    = (struct worker_ctx *)calloc(nworkers, sizeof(*wk));
+        flowv = (struct thread_ctx **)calloc(nthreads, sizeof(*flowv));
+        if (!wk || !flowv) { perror("calloc"); return 1; }
+
+        int next = 0;
+        for (int w = 0; w < nworkers; w++) {
+            wk[w].widx  = w;
+            wk[w].cpu   = ncpu > 0 ? (int)(w % ncpu) : -1;
+            wk[w].batch = batch;
+            wk[w].spin  = spin;
+            wk[w].flows = &flowv[next];
+            for (int i = w; i < nthreads; i += nworkers) flowv[next++] = &ctx[i];
+            wk[w].nflows = (int)(&flowv[next] - wk[w].flows);
+            if (sink) {
+                wk[w].results = results_sink_stream(sink);
+                if (!wk[w].results) { perror("results_sink_stream"); return 1; }
+            }
+
+            int rc = pthread_create(&ths[w], NULL, worker_main, &wk[w]);
+            if (rc != 0) {
+                errno = rc;
+                perror("pthread_create");
+            }
+        }
+    }
+
     // ---------- wait for all ----------
     for (int i = 0; i < nthreads; i++) {
         if (ths[i]) pthread_join(ths[i], NULL);
     }
+    free(wk);
+    free(flowv);
 
     // Print averages to stdout
     print_per_connection_avg(ctx, nthreads, count);
 
+    if (sink) {
+        int64_t n = results_sink_close(sink);
+        if (n < 0) { fprintf(stderr, "write to %s failed\n", results_path); return 1; }
+        printf("Wrote %lld results to %s\n", (long long)n, results_path);
+        free(ths);
+        free(ctx);
+        return 0;
+    }
+
     // ---------- single CSV after all complete ----------
     FILE *f = fopen(outfile, "w");
     if (!f) { perror("fopen outfile"); return 1; }
@@ -8,49 +8,73 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "udp_echo_mt.h"
+
 #define DEFAULT_ADDR "0.0.0.0"   // listen on all interfaces by default
 #define DEFAULT_PORT 1111
 #define BUF_SIZE     1500        // Typical MTU; bump if you expect larger packets
 
 static void usage(const char *prog) {
     fprintf(stderr,
-            "Usage: %s [BIND_IP [PORT]]\n"
+            "Usage: %s [BIND_IP [PORT]] [--threads N ...]\n"
             "  BIND_IP : IPv4 address to bind (default %s)\n"
             "  PORT    : UDP port number (default %d)\n"
             "Examples:\n"
             "  %s                # listen on 0.0.0.0:%d (all interfaces)\n"
             "  %s 10.0.0.2       # listen on 10.0.0.2:%d\n"
-            "  %s 10.0.0.2 2222  # listen on 10.0.0.2:2222\n",
+            "  %s 10.0.0.2 2222  # listen on 10.0.0.2:2222\n"
+            "  %s 0.0.0.0 9000 --threads 4 --ports 16\n"
+            "                    # 4 workers serve ports 9000..9015 (replaces multi-server/run.sh 16)\n",
             prog, DEFAULT_ADDR, DEFAULT_PORT,
             prog, DEFAULT_PORT,
             prog, DEFAULT_PORT,
-            prog);
+            prog, prog);
+    udp_echo_usage(stderr);
 }
 
 int main(int argc, char **argv) {
     const char *bind_ip = DEFAULT_ADDR;
     int port = DEFAULT_PORT;
 
-    if (argc >= 2) {
-        if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+    struct udp_echo_cfg mt;
+    int npos = 0;
+
+    udp_echo_cfg_init(&mt);
+    mt.mutate = true;   // same replies as the single-socket loop
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
             usage(argv[0]);
             return 0;
         }
-        bind_ip = argv[1];
-    }
-    if (argc >= 3) {
-        char *end = NULL;
-        long p = strtol(argv[2], &end, 10);
-        if (!argv[2][0] || (end && *end) || p < 1 || p > 65535) {
-            fprintf(stderr, "Invalid port: %s\n", argv[2]);
+        int rc = udp_echo_parse_opt(&mt, argc, argv, &i);
+        if (rc < 0 || (rc == 0 && argv[i][0] == '-' && argv[i][1] == '-')) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (rc > 0) continue;
+
+        if (npos == 0) {
+            bind_ip = argv[i];
+        } else if (npos == 1) {
+            char *end = NULL;
+            long p = strtol(argv[i], &end, 10);
+            if (!argv[i][0] || (end && *end) || p < 1 || p > 65535) {
+                fprintf(stderr, "Invalid port: %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+            port = (int)p;
+        } else {
             usage(argv[0]);
             return 1;
         }
-        port = (int)p;
+        npos++;
     }
-    if (argc > 3) {
-        usage(argv[0]);
-        return 1;
+
+    if (mt.nthreads > 0) {
+        mt.port = (uint16_t)port;
+        return udp_echo_run(&mt, bind_ip);
     }
 
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
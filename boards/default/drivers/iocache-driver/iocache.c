@@ -32,6 +32,11 @@
 
 #include "iocache.h"
 #include "iocache_ioctl.h"
+
+#define CREATE_TRACE_POINTS
+#include "iocache_trace.h"
+
+#include "iocache_stats.c"
 #include "iocache_misc.c"
 #include "iocache_plic.c"
 
@@ -78,6 +83,9 @@ static irqreturn_t iocache_isr_rx(int irq, void *data) {
 	u64 raw_pointer;
 	struct iocache_device *iocache = data;
 	int cpu = smp_processor_id();
+	u64 now = ktime_get_mono_fast_ns();
+	u64 entry = riscv_get_irq_entry_ktime();
+	u64 claim;
 	
 	// printk(KERN_INFO "RX interrupt received at cpu %d\n", cpu);
 
@@ -88,8 +96,16 @@ static irqreturn_t iocache_isr_rx(int irq, void *data) {
 	uint32_t count = ioread32(REG(iocache->iomem, IOCACHE_REG_RX_KICK_ALL_COUNT));
 	uint64_t mask  = ioread64(REG(iocache->iomem, IOCACHE_REG_RX_KICK_ALL_MASK));
 
+	u64_stats_update_begin(&iocache->syncp);
+	iocache->entry_ktime = entry;
+	iocache->claim_ktime = claim = riscv_get_plic_claim_ktime();
+	iocache->isr_ktime   = now;
+	u64_stats_update_end(&iocache->syncp);
+
 	spin_unlock_irqrestore(&iocache->rxkick_lock, flags);
 
+	trace_iocache_kick(cpu, count, mask, entry, claim, now);
+
 	for (int i = 0; i < IOCACHE_CACHE_ENTRY_COUNT && count > 0; ++i) {
 		if (unlikely(mask & (1UL << i))) {
 			raw_pointer = ioread64(REG(iocache->iomem, IOCACHE_REG_PROC_PTR(i)));
@@ -99,7 +115,13 @@ static irqreturn_t iocache_isr_rx(int irq, void *data) {
 				continue;
 			}
 
+			WRITE_ONCE(iocache->row_entry_ktime[i], entry);
+			WRITE_ONCE(iocache->row_claim_ktime[i], claim);
+			WRITE_ONCE(iocache->row_isr_ktime[i], now);
+			iocache_stats_record(iocache, i, cpu, IOCACHE_HIST_IRQ_TO_ISR, now - entry);
+
 			fn = (struct task_struct *) raw_pointer;
+			trace_iocache_wake(i, cpu, fn->pid, now);
 			wake_up_process_iocache(fn);
 			--count;
 		}
@@ -115,8 +137,39 @@ static irqreturn_t iocache_isr_rx(int irq, void *data) {
 }
 
 static irqreturn_t iocache_isr_txcomp(int irq, void *data) {
-	printk(KERN_DEBUG "TX interrupt received\n");
-	// Nothing for now
+	unsigned long flags;
+	struct task_struct *fn;
+	struct iocache_device *iocache = data;
+	int cpu = smp_processor_id();
+	u64 now = ktime_get_mono_fast_ns();
+	bool woke = false;
+	int row;
+
+	spin_lock_irqsave(&iocache->txcomp_lock, flags);
+
+	for_each_set_bit(row, iocache->txcomp_waiting, IOCACHE_CACHE_ENTRY_COUNT) {
+		if (!ioread8(REG(iocache->iomem, IOCACHE_REG_TXCOMP_AVAILABLE(row))))
+			continue;
+
+		iowrite8(0, REG(iocache->iomem, IOCACHE_REG_TXCOMP_SUSPENDED(row)));
+		__clear_bit(row, iocache->txcomp_waiting);
+
+		fn = iocache->txcomp_task[row];
+		iocache->txcomp_task[row] = NULL;
+		if (unlikely(!fn))
+			continue;
+
+		trace_iocache_wake(row, cpu, fn->pid, now);
+		wake_up_process(fn);
+		woke = true;
+	}
+	mmiowb();
+
+	spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+
+	if (woke)
+		set_tsk_need_resched(current);
+
 	return IRQ_HANDLED;
 }
 
@@ -286,9 +339,11 @@ static int iocache_probe(struct platform_device *pdev) {
 
 	spin_lock_init(&iocache->ev_lock);
 	u64_stats_init(&iocache->syncp);
+	iocache_stats_init(iocache);
 	
 	spin_lock_init(&iocache->ring_alloc_lock);
 	spin_lock_init(&iocache->rxkick_lock);
+	spin_lock_init(&iocache->txcomp_lock);
 
 	register_iocache_forall(iocache->iomem);
 
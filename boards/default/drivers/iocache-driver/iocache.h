@@ -28,6 +28,9 @@
 #include <linux/uaccess.h>
 
 #include <linux/io.h>   /* iowriteXX */
+
+#include "iocache_ioctl.h"
+
 #define REG(base, off) ((void __iomem *)((u8 __iomem *)(base) + (off)))
 
 #define IOCACHE_NAME "iocache"
@@ -136,6 +139,12 @@
 
 #define MAGIC_CHAR 0xCCCCCCCCUL
 
+struct iocache_hist {
+	spinlock_t lock; /* ISR and ioctl writers, reset */
+	u64 count, sum_ns, max_ns;
+	u64 buckets[IOCACHE_HIST_BUCKETS];
+};
+
 struct iocache_device {
 	struct device *dev;
 	
@@ -153,6 +162,19 @@ struct iocache_device {
 
     spinlock_t          ring_alloc_lock;
     spinlock_t          rxkick_lock;
+    spinlock_t          txcomp_lock;
+
+	/* Rows with a task sleeping in WAIT_TXCOMP, protected by txcomp_lock */
+	DECLARE_BITMAP(txcomp_waiting, IOCACHE_CACHE_ENTRY_COUNT);
+	struct task_struct *txcomp_task[IOCACHE_CACHE_ENTRY_COUNT];
+
+	/* Row ownership, protected by ring_alloc_lock; rows are freed when the owning file is released */
+	DECLARE_BITMAP(row_used, IOCACHE_CACHE_ENTRY_COUNT);
+	struct file *row_owner[IOCACHE_CACHE_ENTRY_COUNT];
+
+	/* Mirror of IOCACHE_REG_PROC_CPU, protected by ring_alloc_lock */
+	int  row_cpu[IOCACHE_CACHE_ENTRY_COUNT];
+	bool row_pinned[IOCACHE_CACHE_ENTRY_COUNT];
 	
 	unsigned long magic;
 
@@ -172,9 +194,17 @@ struct iocache_device {
 	dma_addr_t 	dma_region_addr_udp_rx[IOCACHE_CACHE_ENTRY_COUNT];
 	dma_addr_t 	dma_region_addr_udp_rx_aligned[IOCACHE_CACHE_ENTRY_COUNT];
 
-	struct u64_stats_sync syncp;
+	struct u64_stats_sync syncp; /* protects the last-sample ktimes below */
     u64 isr_ktime, entry_ktime, claim_ktime, syscall_time;
 
+	/* Per-row / per-CPU wakeup latency histograms, see iocache_stats.c */
+	u64 row_isr_ktime[IOCACHE_CACHE_ENTRY_COUNT];
+	u64 row_entry_ktime[IOCACHE_CACHE_ENTRY_COUNT];	/* GET_ROW_KTIMES */
+	u64 row_claim_ktime[IOCACHE_CACHE_ENTRY_COUNT];
+	u64 row_wake_ktime[IOCACHE_CACHE_ENTRY_COUNT];
+	struct iocache_hist row_hist[IOCACHE_CACHE_ENTRY_COUNT][IOCACHE_HIST_STAGE_COUNT];
+	struct iocache_hist cpu_hist[NUM_CPUS][IOCACHE_HIST_STAGE_COUNT];
+
 	wait_queue_head_t wq;
     // atomic_t ready; 
 
@@ -188,5 +218,6 @@ static int iocache_misc_open(struct inode *inode, struct file *filp);
 static int iocache_misc_mmap(struct file *filp, struct vm_area_struct *vma);
 static int iocache_misc_release(struct inode *inode, struct file *filp);
 static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static int iocache_mmio_bench(struct iocache_device *iocache, struct iocache_ioctl_mmio_bench *mb);
 
 #endif /* __IOCACHE_H */
\ No newline at end of file
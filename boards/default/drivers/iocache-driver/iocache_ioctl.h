@@ -47,8 +47,103 @@ struct iocache_ioctl_region_info {
 
 #define IOCACHE_IOCTL_STOP_SCHEDULER _IOR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 10, __u64)
 
+/* Pass IOCACHE_ROW_ANY to let the driver pick a free row; the row is written back */
+#define IOCACHE_ROW_ANY         (-1)
 #define IOCACHE_IOCTL_RESERVE_RING _IOR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 11, __u64)
 
+/* Pass the row to free; it must have been reserved through this fd */
 #define IOCACHE_IOCTL_FREE_RING _IOR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 12, __u64)
 
+/* cpu = -1 lets the row follow its owning thread; PIN also migrates the owner */
+#define IOCACHE_AFFINITY_PIN    (1U << 0)
+
+struct iocache_ioctl_row_affinity {
+    __s32 row;
+    __s32 cpu;
+    __u32 flags;
+};
+#define IOCACHE_IOCTL_SET_ROW_AFFINITY _IOW(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 13, struct iocache_ioctl_row_affinity)
+
+/* Latency histograms: bucket i counts samples in [2^i, 2^(i+1)) ns, bucket 0 also holds 0 */
+#define IOCACHE_HIST_BUCKETS    32
+
+enum {
+    IOCACHE_HIST_IRQ_TO_ISR = 0,    /* IRQ entry -> iocache ISR */
+    IOCACHE_HIST_ISR_TO_RUN,        /* ISR wakeup -> waiting task running */
+    IOCACHE_HIST_WAIT,              /* whole WAIT_READY syscall */
+    IOCACHE_HIST_STAGE_COUNT
+};
+
+enum {
+    IOCACHE_HIST_SCOPE_ROW = 0,
+    IOCACHE_HIST_SCOPE_CPU
+};
+
+#define IOCACHE_HIST_RESET      (1U << 0)   /* clear after reading */
+
+struct iocache_ioctl_hist {
+    __u32 scope, index, stage, flags;
+    __u64 count, sum_ns, max_ns;
+    __u64 buckets[IOCACHE_HIST_BUCKETS];
+};
+#define IOCACHE_IOCTL_GET_HIST _IOWR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 14, struct iocache_ioctl_hist)
+
+/* Sleep until TX completions free space in the given row's TX ring (or 1s timeout) */
+#define IOCACHE_IOCTL_WAIT_TXCOMP _IOW(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 15, int)
+
+/*
+ * Sleep until any row in `mask` has RX data (or the timeout hits). Every
+ * row must have been reserved by the calling thread. On return `mask`
+ * holds the rows that are ready; 0 means timeout.
+ */
+struct iocache_ioctl_wait_mask {
+    __u64 mask;
+    __u32 timeout_us;       /* 0: 1s, like WAIT_READY */
+    __u32 rsvd;
+};
+#define IOCACHE_IOCTL_WAIT_READY_MASK _IOWR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 16, struct iocache_ioctl_wait_mask)
+
+/*
+ * Last wakeup of one row, all ktime_get_mono_fast_ns() (CLOCK_MONOTONIC):
+ * IRQ entry, PLIC claim and ISR of the interrupt that last woke the row,
+ * and when its waiter was running again in WAIT_READY(_MASK). Unlike
+ * GET_KTIMES these are not overwritten by other rows' interrupts.
+ */
+struct iocache_ioctl_row_ktimes {
+    __s32 row;
+    __u32 rsvd;
+    __u64 entry_ns, claim_ns, isr_ns, wake_ns;
+};
+#define IOCACHE_IOCTL_GET_ROW_KTIMES _IOWR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 17, struct iocache_ioctl_row_ktimes)
+
+/*
+ * Time MMIO reads from inside the kernel, for registers userspace has no
+ * mapping for. Each sample is one read bracketed by get_cycles() (rdcycle)
+ * with interrupts off. PLIC targets use the calling CPU's RX source. The
+ * claim register itself is never read, because that would take a pending
+ * interrupt away from the PLIC driver. The priority and pending words sit
+ * behind the same bus path and stand in for it. NONE times an empty
+ * bracket, the overhead to subtract. Buckets are log2 of cycles, like
+ * GET_HIST.
+ */
+enum {
+    IOCACHE_MMIO_NONE = 0,
+    IOCACHE_MMIO_PLIC_PRIORITY,     /* priority word of this CPU's RX source */
+    IOCACHE_MMIO_PLIC_PENDING,      /* pending word holding that source */
+    IOCACHE_MMIO_ROW_ENABLED,       /* iocache row field, as userspace reads it */
+    IOCACHE_MMIO_TARGET_COUNT
+};
+
+#define IOCACHE_MMIO_RELAXED    (1U << 0)   /* readl_relaxed(): no fences around the load */
+#define IOCACHE_MMIO_MAX_ITERS  100000
+
+struct iocache_ioctl_mmio_bench {
+    __u32 target, flags;
+    __u32 iters;            /* capped at IOCACHE_MMIO_MAX_ITERS */
+    __s32 row;              /* for ROW_ENABLED */
+    __u64 count, sum_cycles, min_cycles, max_cycles;
+    __u64 buckets[IOCACHE_HIST_BUCKETS];
+};
+#define IOCACHE_IOCTL_MMIO_BENCH _IOWR(IOCACHE_IOCTL_TYPE, IOCACHE_IOCTL_BASE + 18, struct iocache_ioctl_mmio_bench)
+
 #endif /* __IOCACHE_IOCTL_H */
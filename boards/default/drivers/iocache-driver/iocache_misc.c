@@ -21,6 +21,8 @@ static enum hrtimer_restart iocache_timeout_cb(struct hrtimer *t)
 	}
 
 	int suspended = ioread8(REG(tsk->iocache_iomem, IOCACHE_REG_RX_SUSPENDED(tsk->iocache_id)));
+
+	trace_iocache_timeout(tsk->iocache_id, smp_processor_id(), suspended, ktime_get_mono_fast_ns());
 	if (!suspended) {
 		printk(KERN_WARNING "Already awake\n");
 		wake_up_process(tsk);
@@ -44,6 +46,69 @@ static enum hrtimer_restart iocache_timeout_cb(struct hrtimer *t)
     return HRTIMER_NORESTART;
 }
 
+/* Drop any TX-completion waiter on @row, optionally waking it. The wakeup
+ * happens under txcomp_lock so the waiter cannot exit underneath us. */
+static void iocache_txcomp_disarm(struct iocache_device *iocache, int row, bool wake)
+{
+	struct task_struct *tsk;
+	unsigned long flags;
+
+	spin_lock_irqsave(&iocache->txcomp_lock, flags);
+	tsk = iocache->txcomp_task[row];
+	iocache->txcomp_task[row] = NULL;
+	if (__test_and_clear_bit(row, iocache->txcomp_waiting)) {
+		iowrite8(0, REG(iocache->iomem, IOCACHE_REG_TXCOMP_SUSPENDED(row)));
+		mmiowb();
+	}
+	if (wake && tsk)
+		wake_up_process(tsk);
+	spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+}
+
+/* Point the row's RX/TXCOMP interrupts at @cpu, and make sure that CPU
+ * takes them: a waiter armed the mask of the CPU it last saw the row on */
+static void iocache_set_row_cpu(struct iocache_device *iocache, int row, int cpu)
+{
+	spin_lock(&iocache->ring_alloc_lock);
+
+	iocache->row_cpu[row] = cpu;
+	iowrite32(cpu, 		REG(iocache->iomem, IOCACHE_REG_PROC_CPU(row)));
+	iowrite8 (1, 		REG(iocache->iomem, IOCACHE_REG_INTMASK_RX(cpu)));
+	iowrite8 (1, 		REG(iocache->iomem, IOCACHE_REG_INTMASK_TXCOMP(cpu)));
+	mmiowb();
+
+	spin_unlock(&iocache->ring_alloc_lock);
+}
+
+/* Pick a free row. ALLOC_FIRST_EMPTY reads 0 both for "row 0" and for "none",
+ * so its hint is only trusted when the bitmap agrees. Caller holds ring_alloc_lock. */
+static int iocache_find_free_row(struct iocache_device *iocache)
+{
+	u32 hint = ioread32(REG(iocache->iomem, IOCACHE_REG_ALLOC_FIRST_EMPTY));
+	unsigned long row;
+
+	if (hint < IOCACHE_CACHE_ENTRY_COUNT && !test_bit(hint, iocache->row_used))
+		return hint;
+
+	row = find_first_zero_bit(iocache->row_used, IOCACHE_CACHE_ENTRY_COUNT);
+	return (row < IOCACHE_CACHE_ENTRY_COUNT) ? (int) row : -ENOSPC;
+}
+
+/* Disable @row and forget its owner. Caller holds ring_alloc_lock. */
+static void __iocache_free_row(struct iocache_device *iocache, int row)
+{
+	__clear_bit(row, iocache->row_used);
+	iocache->row_owner[row] = NULL;
+	iocache->row_cpu[row] = 0;
+	iocache->row_pinned[row] = false;
+
+	iowrite8 (0, 		REG(iocache->iomem, IOCACHE_REG_ENABLED(row)));
+	iowrite8 (0, 		REG(iocache->iomem, IOCACHE_REG_RX_SUSPENDED(row)));
+	iowrite32(0, 		REG(iocache->iomem, IOCACHE_REG_PROC_CPU(row)));
+	iowrite64(0, 		REG(iocache->iomem, IOCACHE_REG_PROC_PTR(row)));
+	mmiowb();
+}
+
 static int iocache_misc_open(struct inode *inode, struct file *file) {
 	// printk(KERN_INFO "Openning iocache-misc\n");
     struct iocache_device *iocache = container_of(file->private_data, struct iocache_device, misc_dev);
@@ -85,11 +150,30 @@ static int iocache_misc_release(struct inode *inode, struct file *filp)
 
     if (iocache) {
         struct eventfd_ctx *old = NULL;
+        DECLARE_BITMAP(freed, IOCACHE_CACHE_ENTRY_COUNT);
+        int row;
+
         spin_lock(&iocache->ev_lock);
         old = iocache->ev_ctx;
         iocache->ev_ctx = NULL;
         spin_unlock(&iocache->ev_lock);
         if (old) eventfd_ctx_put(old);
+
+        /* Reclaim rows this file never freed (e.g. the process crashed) */
+        bitmap_zero(freed, IOCACHE_CACHE_ENTRY_COUNT);
+        spin_lock(&iocache->ring_alloc_lock);
+        for_each_set_bit(row, iocache->row_used, IOCACHE_CACHE_ENTRY_COUNT) {
+            if (iocache->row_owner[row] != filp)
+                continue;
+            __iocache_free_row(iocache, row);
+            __set_bit(row, freed);
+        }
+        spin_unlock(&iocache->ring_alloc_lock);
+
+        for_each_set_bit(row, freed, IOCACHE_CACHE_ENTRY_COUNT) {
+            iocache_txcomp_disarm(iocache, row, true);
+            trace_iocache_free(row, raw_smp_processor_id(), ktime_get_mono_fast_ns());
+        }
     }
 
 	/* 
@@ -204,11 +288,50 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
         if (old) eventfd_ctx_put(old);
         return 0;
     } else if (cmd == IOCACHE_IOCTL_GET_KTIMES) {
-		u64 val[4] = {iocache->entry_ktime, iocache->claim_ktime, iocache->isr_ktime, iocache->syscall_time};
+		u64 val[4];
+		unsigned int seq;
+
+		do {
+			seq = u64_stats_fetch_begin(&iocache->syncp);
+			val[0] = iocache->entry_ktime;
+			val[1] = iocache->claim_ktime;
+			val[2] = iocache->isr_ktime;
+		} while (u64_stats_fetch_retry(&iocache->syncp, seq));
+		val[3] = READ_ONCE(iocache->syscall_time);
 		
         if (copy_to_user((void __user *)arg, &val, sizeof(val)))
             return -EFAULT;
         return 0;
+    } else if (cmd == IOCACHE_IOCTL_GET_ROW_KTIMES) {
+		struct iocache_ioctl_row_ktimes kt;
+
+		if (copy_from_user(&kt, (void __user *)arg, sizeof(kt)))
+			return -EFAULT;
+
+		if (kt.row < 0 || kt.row >= IOCACHE_CACHE_ENTRY_COUNT)
+			return -EINVAL;
+
+		/* Not a consistent snapshot; userspace checks entry <= claim <= isr <= wake */
+		kt.entry_ns = READ_ONCE(iocache->row_entry_ktime[kt.row]);
+		kt.claim_ns = READ_ONCE(iocache->row_claim_ktime[kt.row]);
+		kt.isr_ns   = READ_ONCE(iocache->row_isr_ktime[kt.row]);
+		kt.wake_ns  = READ_ONCE(iocache->row_wake_ktime[kt.row]);
+
+		if (copy_to_user((void __user *)arg, &kt, sizeof(kt)))
+			return -EFAULT;
+		return 0;
+    } else if (cmd == IOCACHE_IOCTL_MMIO_BENCH) {
+		struct iocache_ioctl_mmio_bench mb;
+		int ret;
+
+		if (copy_from_user(&mb, (void __user *)arg, offsetofend(struct iocache_ioctl_mmio_bench, row)))
+			return -EFAULT;
+
+		ret = iocache_mmio_bench(iocache, &mb);
+		if (ret)
+			return ret;
+
+		return copy_to_user((void __user *)arg, &mb, sizeof(mb)) ? -EFAULT : 0;
     } else if (cmd == IOCACHE_IOCTL_GET_PROC_UTIL) {
 		// u64 usage;
 
@@ -224,12 +347,28 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
     } else if (cmd == IOCACHE_IOCTL_WAIT_READY) {
 		/* Prepare to sleep (interruptible) */
 		int row = READ_ONCE(current->iocache_id);
+		int cpu = raw_smp_processor_id();
+		u64 start = ktime_get_mono_fast_ns();
+		u64 now, isr;
+
+		/* iocache_id is stale for a thread that never reserved a row or has freed it */
+		if (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT)
+			return -EINVAL;
+		if (ioread64(REG(iocache->iomem, IOCACHE_REG_PROC_PTR(row))) != (u64) (uintptr_t) current)
+			return -EPERM;
+
+		/* The owner may have migrated since the last wait; follow it */
+		if (!READ_ONCE(iocache->row_pinned[row]) && READ_ONCE(iocache->row_cpu[row]) != cpu)
+			iocache_set_row_cpu(iocache, row, cpu);
+
 		set_current_state(TASK_INTERRUPTIBLE);
 
 		iowrite8 (1, 	REG(iocache->iomem, IOCACHE_REG_RX_SUSPENDED(row)));
 		// iowrite8 (1, 	REG(iocache->iomem, IOCACHE_REG_TXCOMP_SUSPENDED(row)));
 		mmiowb();
 
+		trace_iocache_suspend(row, cpu, start);
+
 		// printk(KERN_INFO "starting wait: id=%d\n", row);
 
 		/* Start a pinned hrtimer for the timeout on this CPU */
@@ -239,6 +378,7 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 		 * Device interrupt will set current to TASK_RUNNING and run this
 		 */
 		schedule();
+		now = ktime_get_mono_fast_ns();
 		// __set_current_state(TASK_RUNNING);
 		hrtimer_cancel(&current->to_hrtimer);
 
@@ -248,11 +388,147 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 		// iowrite8 (0, 	REG(iocache->iomem, IOCACHE_REG_TXCOMP_SUSPENDED(row)));
 		// mmiowb();
 
-		// iocache->syscall_time = ktime_get_mono_fast_ns();
+		WRITE_ONCE(iocache->syscall_time, now);
+		WRITE_ONCE(iocache->row_wake_ktime[row], now);
+
+		/* Only charge ISR->run when an ISR woke us during this wait (not the timeout) */
+		cpu = raw_smp_processor_id();
+		trace_iocache_resume(row, cpu, now);
+		isr = READ_ONCE(iocache->row_isr_ktime[row]);
+		if (isr > start && now >= isr)
+			iocache_stats_record(iocache, row, cpu, IOCACHE_HIST_ISR_TO_RUN, now - isr);
+		iocache_stats_record(iocache, row, cpu, IOCACHE_HIST_WAIT, now - start);
 
 		return 0;
+	} else if (cmd == IOCACHE_IOCTL_WAIT_TXCOMP) {
+		/* Unlike WAIT_READY this may be called from any thread sharing the row,
+		 * so the waiter is tracked here rather than through PROC_PTR */
+		ktime_t timeout = ktime_set(1, 0);
+		unsigned long flags;
+		int row;
+
+		if (copy_from_user(&row, (void __user *)arg, sizeof(row)))
+			return -EFAULT;
+
+		if (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT)
+			return -EINVAL;
+
+		spin_lock_irqsave(&iocache->txcomp_lock, flags);
+		/* Any thread may wait, but only on a row reserved through this fd.
+		 * Checked under txcomp_lock: a free clears the owner before its
+		 * disarm takes this lock, so it either fails us here or wakes us. */
+		if (READ_ONCE(iocache->row_owner[row]) != file) {
+			spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+			return -EPERM;
+		}
+		if (iocache->txcomp_task[row]) {
+			spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+			return -EBUSY;
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		iocache->txcomp_task[row] = current;
+		__set_bit(row, iocache->txcomp_waiting);
+		iowrite8 (1, 	REG(iocache->iomem, IOCACHE_REG_TXCOMP_SUSPENDED(row)));
+		mmiowb();
+
+		/* Completions that landed before we armed would never interrupt us */
+		if (ioread8(REG(iocache->iomem, IOCACHE_REG_TXCOMP_AVAILABLE(row)))) {
+			spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+			__set_current_state(TASK_RUNNING);
+			iocache_txcomp_disarm(iocache, row, false);
+			return 0;
+		}
+		spin_unlock_irqrestore(&iocache->txcomp_lock, flags);
+
+		schedule_hrtimeout(&timeout, HRTIMER_MODE_REL);
+
+		iocache_txcomp_disarm(iocache, row, false);
+
+		return signal_pending(current) ? -EINTR : 0;
+	} else if (cmd == IOCACHE_IOCTL_WAIT_READY_MASK) {
+		/* WAIT_READY over several rows owned by this thread. The RX ISR
+		 * already wakes PROC_PTR for whichever row fired, so the only
+		 * extra work is arming and disarming every row in the mask. */
+		struct iocache_ioctl_wait_mask wm;
+		ktime_t timeout;
+		u64 ready = 0, start, now, isr;
+		int cpu = raw_smp_processor_id();
+		int row;
+
+		if (copy_from_user(&wm, (void __user *)arg, sizeof(wm)))
+			return -EFAULT;
+
+		if (!wm.mask)
+			return -EINVAL;
+
+		for_each_set_bit(row, (unsigned long *)&wm.mask, IOCACHE_CACHE_ENTRY_COUNT) {
+			if (ioread64(REG(iocache->iomem, IOCACHE_REG_PROC_PTR(row))) != (u64) (uintptr_t) current)
+				return -EPERM;
+		}
+
+		timeout = wm.timeout_us ? ns_to_ktime((u64)wm.timeout_us * NSEC_PER_USEC) : ktime_set(1, 0);
+		start = ktime_get_mono_fast_ns();
+
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		for_each_set_bit(row, (unsigned long *)&wm.mask, IOCACHE_CACHE_ENTRY_COUNT) {
+			if (!READ_ONCE(iocache->row_pinned[row]) && READ_ONCE(iocache->row_cpu[row]) != cpu)
+				iocache_set_row_cpu(iocache, row, cpu);
+			iowrite8 (1, 	REG(iocache->iomem, IOCACHE_REG_RX_SUSPENDED(row)));
+		}
+		mmiowb();
+
+		/* Data that landed before a row was armed would never interrupt us */
+		for_each_set_bit(row, (unsigned long *)&wm.mask, IOCACHE_CACHE_ENTRY_COUNT) {
+			if (ioread8(REG(iocache->iomem, IOCACHE_REG_RX_AVAILABLE(row))))
+				ready |= BIT_ULL(row);
+		}
+
+		if (!ready) {
+			trace_iocache_suspend(__ffs64(wm.mask), cpu, start);
+			schedule_hrtimeout(&timeout, HRTIMER_MODE_REL);
+		} else {
+			__set_current_state(TASK_RUNNING);
+		}
+
+		for_each_set_bit(row, (unsigned long *)&wm.mask, IOCACHE_CACHE_ENTRY_COUNT)
+			iowrite8 (0, 	REG(iocache->iomem, IOCACHE_REG_RX_SUSPENDED(row)));
+		mmiowb();
+
+		now = ktime_get_mono_fast_ns();
+		WRITE_ONCE(iocache->syscall_time, now);
+		cpu = raw_smp_processor_id();
+
+		ready = 0;
+		for_each_set_bit(row, (unsigned long *)&wm.mask, IOCACHE_CACHE_ENTRY_COUNT) {
+			if (!ioread8(REG(iocache->iomem, IOCACHE_REG_RX_AVAILABLE(row))))
+				continue;
+			ready |= BIT_ULL(row);
+			WRITE_ONCE(iocache->row_wake_ktime[row], now);
+
+			isr = READ_ONCE(iocache->row_isr_ktime[row]);
+			if (isr > start && now >= isr)
+				iocache_stats_record(iocache, row, cpu, IOCACHE_HIST_ISR_TO_RUN, now - isr);
+			iocache_stats_record(iocache, row, cpu, IOCACHE_HIST_WAIT, now - start);
+		}
+		trace_iocache_resume(ready ? __ffs64(ready) : __ffs64(wm.mask), cpu, now);
+
+		wm.mask = ready;
+		if (copy_to_user((void __user *)arg, &wm, sizeof(wm)))
+			return -EFAULT;
+
+		return (!ready && signal_pending(current)) ? -EINTR : 0;
 	} else if (cmd == IOCACHE_IOCTL_GET_AVAIL_RING) {
-		int row = current->iocache_id;
+		/* Only a peek: the row may be gone by the time RESERVE_RING runs */
+		int row;
+
+		spin_lock(&iocache->ring_alloc_lock);
+		row = iocache_find_free_row(iocache);
+		spin_unlock(&iocache->ring_alloc_lock);
+
+		if (row < 0)
+			return row;
 
         if (copy_to_user((void __user *)arg, &row, sizeof(row)))
             return -EFAULT;
@@ -264,13 +540,33 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 		if (copy_from_user(&row, (void __user *)arg, sizeof(row)))
             return -EFAULT;
 
+		if (row != IOCACHE_ROW_ANY && (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT))
+			return -EINVAL;
+
 		migrate_disable();
 		cpu = smp_processor_id();
 
 		spin_lock(&iocache->ring_alloc_lock);
+
+		if (row == IOCACHE_ROW_ANY)
+			row = iocache_find_free_row(iocache);
+		else if (test_bit(row, iocache->row_used) && iocache->row_owner[row] != file)
+			row = -EBUSY;
+
+		if (row < 0) {
+			spin_unlock(&iocache->ring_alloc_lock);
+			migrate_enable();
+			return row;
+		}
+
+		__set_bit(row, iocache->row_used);
+		iocache->row_owner[row] = file;
 		
 		WRITE_ONCE(current->iocache_iomem, iocache->iomem);
 
+		iocache->row_cpu[row] = cpu;
+		iocache->row_pinned[row] = false;
+
 		iowrite8 (1, 							REG(iocache->iomem, IOCACHE_REG_ENABLED(row)));
 		iowrite32(cpu, 							REG(iocache->iomem, IOCACHE_REG_PROC_CPU(row)));
 		iowrite64((u64) (uintptr_t) current, 	REG(iocache->iomem, IOCACHE_REG_PROC_PTR(row)));
@@ -278,6 +574,11 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 
 		spin_unlock(&iocache->ring_alloc_lock);
 
+		/* PROC_CPU is re-synced on every wait, no need to hold the thread here */
+		migrate_enable();
+
+		trace_iocache_reserve(row, cpu, ktime_get_mono_fast_ns());
+
 		hrtimer_init(&current->to_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
 		current->to_hrtimer.function = iocache_timeout_cb;
 		current->to_period = ktime_set(1, 0); // 1s 
@@ -289,17 +590,34 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 
         return 0;
 	} else if (cmd == IOCACHE_IOCTL_FREE_RING) {
-		int row = current->iocache_id;
+		/* The row comes from the caller: a thread may hold several (one per fd) */
+		int row;
+
+		if (copy_from_user(&row, (void __user *)arg, sizeof(row)))
+			return -EFAULT;
+
+		if (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT)
+			return -EINVAL;
 
 		spin_lock(&iocache->ring_alloc_lock);
 
-		iowrite8 (0, 		REG(iocache->iomem, IOCACHE_REG_ENABLED(row)));
-		iowrite32(0, 		REG(iocache->iomem, IOCACHE_REG_PROC_CPU(row)));
-		iowrite64(0, 		REG(iocache->iomem, IOCACHE_REG_PROC_PTR(row)));
-		mmiowb();
+		if (iocache->row_owner[row] != file) {
+			spin_unlock(&iocache->ring_alloc_lock);
+			return -EINVAL;
+		}
+		__iocache_free_row(iocache, row);
 
 		spin_unlock(&iocache->ring_alloc_lock);
 
+		/* A stale id would let WAIT_READY arm a row someone else reserves next */
+		if (READ_ONCE(current->iocache_id) == row)
+			WRITE_ONCE(current->iocache_id, -1);
+
+		/* Don't leave a sender asleep on a row that no longer exists */
+		iocache_txcomp_disarm(iocache, row, true);
+
+		trace_iocache_free(row, raw_smp_processor_id(), ktime_get_mono_fast_ns());
+
         return 0;
 	} else if (cmd == IOCACHE_IOCTL_RUN_SCHEDULER) {
 		int row;
@@ -339,6 +657,53 @@ static long iocache_misc_ioctl(struct file *file, unsigned int cmd, unsigned lon
 
 		hrtimer_cancel(&current->to_hrtimer);
         return 0;
+	} else if (cmd == IOCACHE_IOCTL_GET_HIST) {
+		struct iocache_ioctl_hist hist;
+		struct iocache_hist *h;
+
+		if (copy_from_user(&hist, (void __user *)arg, offsetofend(struct iocache_ioctl_hist, flags)))
+			return -EFAULT;
+
+		h = iocache_stats_lookup(iocache, hist.scope, hist.index, hist.stage);
+		if (!h)
+			return -EINVAL;
+
+		iocache_hist_read(h, &hist, hist.flags & IOCACHE_HIST_RESET);
+
+		return copy_to_user((void __user *)arg, &hist, sizeof(hist)) ? -EFAULT : 0;
+	} else if (cmd == IOCACHE_IOCTL_SET_ROW_AFFINITY) {
+		struct iocache_ioctl_row_affinity aff;
+		int ret;
+
+		if (copy_from_user(&aff, (void __user *)arg, sizeof(aff)))
+			return -EFAULT;
+
+		if (aff.row < 0 || aff.row >= IOCACHE_CACHE_ENTRY_COUNT)
+			return -EINVAL;
+
+		/* Only the thread the row wakes up may steer it */
+		if (ioread64(REG(iocache->iomem, IOCACHE_REG_PROC_PTR(aff.row))) != (u64) (uintptr_t) current)
+			return -EPERM;
+
+		if (aff.cpu < 0) {
+			WRITE_ONCE(iocache->row_pinned[aff.row], false);
+			iocache_set_row_cpu(iocache, aff.row, raw_smp_processor_id());
+			return 0;
+		}
+
+		if (aff.cpu >= NUM_CPUS || !cpu_online(aff.cpu))
+			return -EINVAL;
+
+		if (aff.flags & IOCACHE_AFFINITY_PIN) {
+			ret = set_cpus_allowed_ptr(current, cpumask_of(aff.cpu));
+			if (ret)
+				return ret;
+		}
+
+		WRITE_ONCE(iocache->row_pinned[aff.row], true);
+		iocache_set_row_cpu(iocache, aff.row, aff.cpu);
+
+		return 0;
 	}
 
 	return -EINVAL;
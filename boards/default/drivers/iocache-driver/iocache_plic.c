@@ -15,7 +15,9 @@
 #include "iocache.h"
 
 #define PLIC_PRIO_OFF(hwirq)   (0x00000000u + 4u * (hwirq))
+#define PLIC_PENDING_OFF(hwirq) (0x00001000u + 4u * ((hwirq) / 32))
 #define MAX_PRIORITY           0xFFFFFFFF
+#define IOCACHE_MMIO_CHUNK     1024	/* MMIO bench samples between reschedule points */
 
 /* Provided by our patched PLIC file */
 int plic_register_source_handler(int hwirq,
@@ -137,4 +139,73 @@ static int plic_unregister_fast_path(struct iocache_device *iocache) {
 		plic_unregister_source_handler(iocache->txcomp_hwirq[i]);
 	}
 	return 0;
-}
\ No newline at end of file
+}
+
+/* IOCTL_MMIO_BENCH: see iocache_ioctl.h */
+static int iocache_mmio_bench(struct iocache_device *iocache, struct iocache_ioctl_mmio_bench *mb)
+{
+	void __iomem *addr = NULL;
+	bool relaxed = mb->flags & IOCACHE_MMIO_RELAXED;
+	u32 iters = clamp_t(u32, mb->iters, 1, IOCACHE_MMIO_MAX_ITERS);
+	unsigned long flags;
+	unsigned int hwirq;
+
+	if (mb->target >= IOCACHE_MMIO_TARGET_COUNT)
+		return -EINVAL;
+	if (mb->target == IOCACHE_MMIO_ROW_ENABLED &&
+	    (mb->row < 0 || mb->row >= IOCACHE_CACHE_ENTRY_COUNT))
+		return -EINVAL;
+	if ((mb->target == IOCACHE_MMIO_PLIC_PRIORITY || mb->target == IOCACHE_MMIO_PLIC_PENDING) &&
+	    !iocache->plic_base)
+		return -ENODEV;
+
+	/* Stay on one CPU so the PLIC words are this CPU's source throughout.
+	 * migrate_disable() rather than get_cpu(): the loop yields between chunks. */
+	migrate_disable();
+	hwirq = iocache->rx_hwirq[raw_smp_processor_id()];
+
+	if (mb->target == IOCACHE_MMIO_PLIC_PRIORITY)
+		addr = iocache->plic_base + PLIC_PRIO_OFF(hwirq);
+	else if (mb->target == IOCACHE_MMIO_PLIC_PENDING)
+		addr = iocache->plic_base + PLIC_PENDING_OFF(hwirq);
+	else if (mb->target == IOCACHE_MMIO_ROW_ENABLED)
+		addr = REG(iocache->iomem, IOCACHE_REG_ENABLED(mb->row));
+
+	mb->count = 0;
+	mb->sum_cycles = 0;
+	mb->min_cycles = U64_MAX;
+	mb->max_cycles = 0;
+	memset(mb->buckets, 0, sizeof(mb->buckets));
+
+	for (u32 i = 0; i < iters; i++) {
+		cycles_t c0, c1;
+		u64 d;
+		int b;
+
+		local_irq_save(flags);
+		c0 = get_cycles();
+		if (addr) {
+			if (relaxed)
+				(void)readl_relaxed(addr);
+			else
+				(void)readl(addr);
+		}
+		c1 = get_cycles();
+		local_irq_restore(flags);
+
+		d = c1 - c0;
+		b = d ? min_t(int, fls64(d) - 1, IOCACHE_HIST_BUCKETS - 1) : 0;
+		mb->count++;
+		mb->sum_cycles += d;
+		mb->min_cycles = min(mb->min_cycles, d);
+		mb->max_cycles = max(mb->max_cycles, d);
+		mb->buckets[b]++;
+
+		/* 100k reads over a slow uncached bus would trip the soft-lockup watchdog */
+		if ((i + 1) % IOCACHE_MMIO_CHUNK == 0)
+			cond_resched();
+	}
+
+	migrate_enable();
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <linux/bitops.h>
+#include <linux/spinlock.h>
+
+#include "iocache.h"
+#include "iocache_ioctl.h"
+
+static inline void iocache_hist_record(struct iocache_hist *h, u64 ns)
+{
+	int b = ns ? min_t(int, fls64(ns) - 1, IOCACHE_HIST_BUCKETS - 1) : 0;
+	unsigned long flags;
+
+	/*
+	 * Writers are the ISR and preemptible WAIT_READY callers on any CPU,
+	 * plus a concurrent reset, so the update needs a real lock.
+	 */
+	spin_lock_irqsave(&h->lock, flags);
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	h->buckets[b]++;
+	spin_unlock_irqrestore(&h->lock, flags);
+}
+
+/* Record one sample in both the row's and the CPU's histogram */
+static inline void iocache_stats_record(struct iocache_device *iocache, int row, int cpu, int stage, u64 ns)
+{
+	iocache_hist_record(&iocache->row_hist[row][stage], ns);
+	iocache_hist_record(&iocache->cpu_hist[cpu][stage], ns);
+}
+
+static void iocache_stats_init(struct iocache_device *iocache)
+{
+	for (int s = 0; s < IOCACHE_HIST_STAGE_COUNT; s++) {
+		for (int i = 0; i < IOCACHE_CACHE_ENTRY_COUNT; i++)
+			spin_lock_init(&iocache->row_hist[i][s].lock);
+		for (int c = 0; c < NUM_CPUS; c++)
+			spin_lock_init(&iocache->cpu_hist[c][s].lock);
+	}
+}
+
+static struct iocache_hist *iocache_stats_lookup(struct iocache_device *iocache,
+		u32 scope, u32 index, u32 stage)
+{
+	if (stage >= IOCACHE_HIST_STAGE_COUNT)
+		return NULL;
+
+	if (scope == IOCACHE_HIST_SCOPE_ROW && index < IOCACHE_CACHE_ENTRY_COUNT)
+		return &iocache->row_hist[index][stage];
+	if (scope == IOCACHE_HIST_SCOPE_CPU && index < NUM_CPUS)
+		return &iocache->cpu_hist[index][stage];
+
+	return NULL;
+}
+
+static void iocache_hist_read(struct iocache_hist *h, struct iocache_ioctl_hist *out, bool reset)
+{
+	unsigned long flags;
+
+	/* Snapshot and reset under one hold so no sample is lost in between */
+	spin_lock_irqsave(&h->lock, flags);
+	out->count  = h->count;
+	out->sum_ns = h->sum_ns;
+	out->max_ns = h->max_ns;
+	memcpy(out->buckets, h->buckets, sizeof(out->buckets));
+	if (reset) {
+		h->count = h->sum_ns = h->max_ns = 0;
+		memset(h->buckets, 0, sizeof(h->buckets));
+	}
+	spin_unlock_irqrestore(&h->lock, flags);
+}
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM iocache
+
+#if !defined(_IOCACHE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _IOCACHE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Wakeup path events. All timestamps are ktime_get_mono_fast_ns() (or the
+ * patched do_irq/PLIC equivalents), so they line up with each other and with
+ * CLOCK_MONOTONIC in userspace.
+ */
+
+TRACE_EVENT(iocache_kick,
+
+	TP_PROTO(int cpu, u32 count, u64 mask, u64 entry_ns, u64 claim_ns, u64 isr_ns),
+
+	TP_ARGS(cpu, count, mask, entry_ns, claim_ns, isr_ns),
+
+	TP_STRUCT__entry(
+		__field(int, cpu)
+		__field(u32, count)
+		__field(u64, mask)
+		__field(u64, entry_ns)
+		__field(u64, claim_ns)
+		__field(u64, isr_ns)
+	),
+
+	TP_fast_assign(
+		__entry->cpu      = cpu;
+		__entry->count    = count;
+		__entry->mask     = mask;
+		__entry->entry_ns = entry_ns;
+		__entry->claim_ns = claim_ns;
+		__entry->isr_ns   = isr_ns;
+	),
+
+	TP_printk("cpu=%d count=%u mask=0x%llx entry=%llu claim=%llu isr=%llu",
+		  __entry->cpu, __entry->count, __entry->mask,
+		  __entry->entry_ns, __entry->claim_ns, __entry->isr_ns)
+);
+
+TRACE_EVENT(iocache_wake,
+
+	TP_PROTO(int row, int cpu, pid_t pid, u64 isr_ns),
+
+	TP_ARGS(row, cpu, pid, isr_ns),
+
+	TP_STRUCT__entry(
+		__field(int, row)
+		__field(int, cpu)
+		__field(pid_t, pid)
+		__field(u64, isr_ns)
+	),
+
+	TP_fast_assign(
+		__entry->row    = row;
+		__entry->cpu    = cpu;
+		__entry->pid    = pid;
+		__entry->isr_ns = isr_ns;
+	),
+
+	TP_printk("row=%d cpu=%d pid=%d isr=%llu",
+		  __entry->row, __entry->cpu, __entry->pid, __entry->isr_ns)
+);
+
+TRACE_EVENT(iocache_timeout,
+
+	TP_PROTO(int row, int cpu, bool suspended, u64 ts_ns),
+
+	TP_ARGS(row, cpu, suspended, ts_ns),
+
+	TP_STRUCT__entry(
+		__field(int, row)
+		__field(int, cpu)
+		__field(bool, suspended)
+		__field(u64, ts_ns)
+	),
+
+	TP_fast_assign(
+		__entry->row       = row;
+		__entry->cpu       = cpu;
+		__entry->suspended = suspended;
+		__entry->ts_ns     = ts_ns;
+	),
+
+	TP_printk("row=%d cpu=%d suspended=%d ts=%llu",
+		  __entry->row, __entry->cpu, __entry->suspended, __entry->ts_ns)
+);
+
+DECLARE_EVENT_CLASS(iocache_row,
+
+	TP_PROTO(int row, int cpu, u64 ts_ns),
+
+	TP_ARGS(row, cpu, ts_ns),
+
+	TP_STRUCT__entry(
+		__field(int, row)
+		__field(int, cpu)
+		__field(u64, ts_ns)
+	),
+
+	TP_fast_assign(
+		__entry->row   = row;
+		__entry->cpu   = cpu;
+		__entry->ts_ns = ts_ns;
+	),
+
+	TP_printk("row=%d cpu=%d ts=%llu",
+		  __entry->row, __entry->cpu, __entry->ts_ns)
+);
+
+/* Task sets RX_SUSPENDED and goes to sleep in WAIT_READY */
+DEFINE_EVENT(iocache_row, iocache_suspend,
+	TP_PROTO(int row, int cpu, u64 ts_ns),
+	TP_ARGS(row, cpu, ts_ns)
+);
+
+/* Task is running again after WAIT_READY's schedule() */
+DEFINE_EVENT(iocache_row, iocache_resume,
+	TP_PROTO(int row, int cpu, u64 ts_ns),
+	TP_ARGS(row, cpu, ts_ns)
+);
+
+DEFINE_EVENT(iocache_row, iocache_reserve,
+	TP_PROTO(int row, int cpu, u64 ts_ns),
+	TP_ARGS(row, cpu, ts_ns)
+);
+
+DEFINE_EVENT(iocache_row, iocache_free,
+	TP_PROTO(int row, int cpu, u64 ts_ns),
+	TP_ARGS(row, cpu, ts_ns)
+);
+
+#endif /* _IOCACHE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE iocache_trace
+#include <trace/define_trace.h>
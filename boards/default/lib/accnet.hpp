@@ -0,0 +1,379 @@
+#ifndef __ACCNET_HPP
+#define __ACCNET_HPP
+
+/*
+ * C++17 header-only wrapper over accnet_lib / iocache_lib.
+ *
+ *   accnet::Row     owns an iocache row (fd, eventfd, DMA buffer mappings)
+ *   accnet::Device  owns the accnet register mappings bound to one Row
+ *   accnet::TxRing  / accnet::RxRing are cheap views over a Device's rings
+ *
+ * Row and Device are move-only and release everything in their destructor.
+ * Construction failures throw std::system_error carrying errno; the ring
+ * fast path never throws and reports a full/empty ring through its return
+ * value, like the C calls underneath.
+ *
+ * std::span is C++20, so ring ranges are exposed as accnet::Span, a minimal
+ * pointer+length view with the same shape.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "accnet_lib.h"
+#include "iocache_lib.h"
+
+namespace accnet {
+
+inline constexpr const char *kAccnetDevice  = "/dev/accnet-misc";
+inline constexpr const char *kIocacheDevice = "/dev/iocache-misc";
+
+[[noreturn]] inline void throw_errno(const char *what)
+{
+    throw std::system_error(errno ? errno : EIO, std::generic_category(), what);
+}
+
+/* Contiguous view; stand-in for std::span<T> */
+template <class T>
+class Span {
+public:
+    constexpr Span() noexcept = default;
+    constexpr Span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <class U, std::size_t N,
+              class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr Span(U (&arr)[N]) noexcept : data_(arr), size_(N) {}
+
+    /* Span<uint8_t> -> Span<const uint8_t> */
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr Span(const Span<U> &o) noexcept : data_(o.data()), size_(o.size()) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+    constexpr Span subspan(std::size_t off, std::size_t n) const noexcept { return {data_ + off, n}; }
+    constexpr Span first(std::size_t n) const noexcept { return {data_, n}; }
+
+private:
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+template <class T>
+inline Span<const uint8_t> as_bytes(const T &obj) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T>, "as_bytes needs a trivially copyable type");
+    return {reinterpret_cast<const uint8_t *>(&obj), sizeof(T)};
+}
+
+namespace detail {
+
+/*
+ * Copy a compile-time sized block. With N and both alignments known the
+ * compiler emits straight-line word moves instead of a memcpy call, which
+ * is what matters for small fixed-size messages. Each Align must hold for
+ * the pointer it describes; ring-side pointers go through copy_to_ring and
+ * copy_from_ring.
+ */
+template <std::size_t N, std::size_t DstAlign, std::size_t SrcAlign>
+inline void copy_fixed(uint8_t *dst, const uint8_t *src) noexcept
+{
+    static_assert(N > 0, "empty copy");
+    static_assert(DstAlign && (DstAlign & (DstAlign - 1)) == 0, "DstAlign must be a power of two");
+    static_assert(SrcAlign && (SrcAlign & (SrcAlign - 1)) == 0, "SrcAlign must be a power of two");
+
+    std::memcpy(__builtin_assume_aligned(dst, DstAlign), __builtin_assume_aligned(src, SrcAlign), N);
+}
+
+/*
+ * Nothing is known statically about a ring address: records sit at any
+ * byte offset. Check it at run time and only take the word-move path when
+ * it really is 8-byte aligned (framed records are 64-byte aligned, so that
+ * is the common case).
+ */
+template <std::size_t N, std::size_t Align>
+inline void copy_to_ring(uint8_t *ring, const uint8_t *src) noexcept
+{
+    if (N >= 8 && (reinterpret_cast<uintptr_t>(ring) & 7) == 0)
+        copy_fixed<N, 8, Align>(ring, src);
+    else
+        copy_fixed<N, 1, Align>(ring, src);
+}
+
+template <std::size_t N, std::size_t Align>
+inline void copy_from_ring(uint8_t *dst, const uint8_t *ring) noexcept
+{
+    if (N >= 8 && (reinterpret_cast<uintptr_t>(ring) & 7) == 0)
+        copy_fixed<N, Align, 8>(dst, ring);
+    else
+        copy_fixed<N, Align, 1>(dst, ring);
+}
+
+} // namespace detail
+
+/*
+ * A reserved (TX) or peeked (RX) range of a ring. It may wrap, so it is
+ * either one contiguous piece or two: first() then second().
+ */
+class RingSpan {
+public:
+    RingSpan() noexcept { std::memset(&raw_, 0, sizeof(raw_)); }
+    explicit RingSpan(const accnet_span &raw) noexcept : raw_(raw) {}
+
+    uint32_t size() const noexcept { return accnet_span_len(&raw_); }
+    bool empty() const noexcept { return size() == 0; }
+    bool contiguous() const noexcept { return raw_.len[1] == 0; }
+
+    Span<uint8_t> first() const noexcept { return {raw_.ptr[0], raw_.len[0]}; }
+    Span<uint8_t> second() const noexcept { return {raw_.ptr[1], raw_.len[1]}; }
+
+    void write(uint32_t off, Span<const uint8_t> src) const noexcept
+    {
+        accnet_span_write(&raw_, off, src.data(), (uint32_t)src.size());
+    }
+    void read(uint32_t off, Span<uint8_t> dst) const noexcept
+    {
+        accnet_span_read(&raw_, off, dst.data(), (uint32_t)dst.size());
+    }
+
+    /* Fixed-size store at @off; @src must be Align-aligned, the ring side need not be */
+    template <std::size_t N, std::size_t Align = 1>
+    void write_fixed(uint32_t off, const void *src) const noexcept
+    {
+        if (off + N <= raw_.len[0])
+            detail::copy_to_ring<N, Align>(raw_.ptr[0] + off, static_cast<const uint8_t *>(src));
+        else
+            accnet_span_write(&raw_, off, src, N);     /* straddles the wrap */
+    }
+
+    template <std::size_t N, std::size_t Align = 1>
+    void read_fixed(uint32_t off, void *dst) const noexcept
+    {
+        if (off + N <= raw_.len[0])
+            detail::copy_from_ring<N, Align>(static_cast<uint8_t *>(dst), raw_.ptr[0] + off);
+        else
+            accnet_span_read(&raw_, off, dst, N);
+    }
+
+    template <class T>
+    void put(uint32_t off, const T &obj) const noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ring records must be trivially copyable");
+        write_fixed<sizeof(T), alignof(T)>(off, &obj);
+    }
+
+    template <class T>
+    T get(uint32_t off) const noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ring records must be trivially copyable");
+        T obj;
+        read_fixed<sizeof(T), alignof(T)>(off, &obj);
+        return obj;
+    }
+
+    const accnet_span &raw() const noexcept { return raw_; }
+
+private:
+    accnet_span raw_;
+};
+
+/*
+ * One iocache row. The iocache_info lives on the heap so its address stays
+ * put when the Row moves; a Device keeps a pointer to it.
+ */
+class Row {
+public:
+    explicit Row(int row = IOCACHE_ROW_ANY, const char *dev = kIocacheDevice)
+        : info_(new iocache_info{})
+    {
+        if (iocache_open(dev, info_.get(), row) != 0)
+            throw_errno("iocache_open");
+    }
+
+    ~Row() { reset(); }
+
+    Row(Row &&) noexcept = default;
+    Row &operator=(Row &&o) noexcept
+    {
+        if (this != &o) {
+            reset();
+            info_ = std::move(o.info_);
+        }
+        return *this;
+    }
+    Row(const Row &) = delete;
+    Row &operator=(const Row &) = delete;
+
+    int index() const noexcept { return info_->row; }
+    iocache_info *get() const noexcept { return info_.get(); }
+    explicit operator bool() const noexcept { return info_ != nullptr; }
+
+    /* Block until the row has RX data / TX completions; -1 with errno on error */
+    int wait_rx() noexcept { return iocache_wait_on_rx(info_.get()); }
+    int wait_txcomp() noexcept { return iocache_wait_on_txcomp(info_.get()); }
+
+    void set_affinity(int cpu, bool pin = false)
+    {
+        if (iocache_set_row_affinity(info_.get(), cpu, pin) != 0)
+            throw_errno("iocache_set_row_affinity");
+    }
+
+private:
+    void reset() noexcept
+    {
+        if (info_) {
+            iocache_close(info_.get());
+            info_.reset();
+        }
+    }
+
+    std::unique_ptr<iocache_info> info_;
+};
+
+class TxRing {
+public:
+    explicit TxRing(accnet_info *a) noexcept : a_(a) {}
+
+    uint32_t capacity() const noexcept { return a_->ring.tx_size - 1; }
+    uint32_t space(uint32_t want) noexcept { return accnet_tx_space(a_, want); }
+
+    /* Room for @len bytes, or nullopt when the ring is full (errno set) */
+    std::optional<RingSpan> reserve(uint32_t len) noexcept
+    {
+        accnet_span raw;
+        if (accnet_tx_reserve(a_, len, &raw) != 0)
+            return std::nullopt;
+        return RingSpan(raw);
+    }
+
+    /* Publish the first @len bytes of @span and ring the doorbell */
+    void commit(const RingSpan &span, uint32_t len) noexcept { accnet_tx_commit(a_, &span.raw(), len); }
+    void commit(const RingSpan &span) noexcept { commit(span, span.size()); }
+
+    /* Copying send; false when the ring is full */
+    bool send(Span<const uint8_t> buf) noexcept
+    {
+        auto span = reserve((uint32_t)buf.size());
+        if (!span)
+            return false;
+        span->write(0, buf);
+        commit(*span);
+        return true;
+    }
+
+    /* Send a fixed-size record; the copy is specialized on its size and alignment */
+    template <class T>
+    bool send(const T &msg) noexcept
+    {
+        auto span = reserve(sizeof(T));
+        if (!span)
+            return false;
+        span->put(0, msg);
+        commit(*span);
+        return true;
+    }
+
+private:
+    accnet_info *a_;
+};
+
+class RxRing {
+public:
+    explicit RxRing(accnet_info *a) noexcept : a_(a) {}
+
+    uint32_t available(uint32_t want = 1) noexcept { return accnet_rx_avail(a_, want); }
+
+    /* Everything the NIC has written so far; empty() when nothing arrived */
+    RingSpan peek() noexcept
+    {
+        accnet_span raw;
+        accnet_rx_peek(a_, &raw);
+        return RingSpan(raw);
+    }
+
+    void release(const RingSpan &span, uint32_t len) noexcept { accnet_rx_release(a_, &span.raw(), len); }
+
+    /* Pop one fixed-size record, if a whole one is there */
+    template <class T>
+    std::optional<T> recv() noexcept
+    {
+        if (available(sizeof(T)) < sizeof(T))
+            return std::nullopt;
+        RingSpan span = peek();
+        T obj = span.get<T>(0);
+        release(span, sizeof(T));
+        return obj;
+    }
+
+private:
+    accnet_info *a_;
+};
+
+/* The accnet engine bound to one Row */
+class Device {
+public:
+    explicit Device(Row row, bool init = true, const char *dev = kAccnetDevice)
+        : row_(std::move(row)), info_(new accnet_info{})
+    {
+        if (accnet_open(dev, info_.get(), row_.get(), init) != 0)
+            throw_errno("accnet_open");
+    }
+
+    ~Device() { reset(); }
+
+    Device(Device &&) noexcept = default;
+    Device &operator=(Device &&o) noexcept
+    {
+        if (this != &o) {
+            reset();
+            row_  = std::move(o.row_);
+            info_ = std::move(o.info_);
+        }
+        return *this;
+    }
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+
+    void connect(const connection_info &conn)
+    {
+        connection_info c = conn;
+        iocache_setup_connection(row_.get(), &c);
+        if (accnet_setup_connection(info_.get(), &c) != 0)
+            throw_errno("accnet_setup_connection");
+    }
+
+    TxRing tx() noexcept { return TxRing(info_.get()); }
+    RxRing rx() noexcept { return RxRing(info_.get()); }
+
+    Row &row() noexcept { return row_; }
+    accnet_info *get() const noexcept { return info_.get(); }
+    uint64_t time() const noexcept { return accnet_get_time(info_.get()); }
+
+private:
+    void reset() noexcept
+    {
+        /* accnet_close() touches per-row registers, so it runs before the Row goes */
+        if (info_) {
+            accnet_close(info_.get());
+            info_.reset();
+        }
+    }
+
+    Row row_;       /* declared first: destroyed after info_ is closed */
+    std::unique_ptr<accnet_info> info_;
+};
+
+} // namespace accnet
+
+#endif /* __ACCNET_HPP */
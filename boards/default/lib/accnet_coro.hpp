@@ -0,0 +1,409 @@
+#ifndef __ACCNET_CORO_HPP
+#define __ACCNET_CORO_HPP
+
+/*
+ * C++20 coroutine layer over framed iocache rows.
+ *
+ *   accnet::coro::Scheduler  one per core; drives every AsyncRow it owns
+ *   accnet::coro::AsyncRow   a Device whose framed datagrams are awaited:
+ *                              Flow f    = co_await row.accept();
+ *                              Message m = co_await row.recv(f, buf);
+ *                              co_await row.send(hdr, payload);
+ *   accnet::coro::Task       a detached session coroutine
+ *
+ * Sessions are plain coroutines, so thousands of them can share the 64
+ * hardware rows on one thread. A row's records are split by the sender's
+ * frame tuple (accnet_demux.h), one Flow per tuple, so a session that
+ * owns a Flow only ever sees its own peer's datagrams. accept() hands out
+ * each new Flow once, in arrival order. recv() waiters on a Flow are
+ * served in FIFO order, one record each. A row is only registered with
+ * the underlying accnet_reactor while it has waiters, so the scheduler
+ * sleeps in the driver (IOCACHE_IOCTL_WAIT_READY_MASK) whenever no
+ * session can make progress.
+ *
+ * Everything runs on the scheduler's thread. That thread must be the one
+ * that reserved the rows (see accnet_reactor.h).
+ */
+
+#if __cplusplus < 202002L
+#error "accnet_coro.hpp needs C++20 (-std=c++20)"
+#endif
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include "accnet.hpp"
+#include "accnet_demux.h"
+#include "accnet_frame.h"
+#include "accnet_reactor.h"
+
+namespace accnet::coro {
+
+/* Detached, eagerly started coroutine; the frame frees itself on completion */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/* One received datagram: its header and how much payload landed in the caller's buffer */
+struct Message {
+    accnet_frame_hdr hdr;
+    uint32_t         len;       /* bytes copied; hdr.len may be larger if truncated */
+};
+
+class AsyncRow;
+
+/* One sender on a row, as named by its frame headers; valid until AsyncRow::close() */
+class Flow {
+public:
+    Flow() noexcept = default;
+
+    explicit operator bool() const noexcept { return flow_ != nullptr; }
+    uint8_t  protocol() const noexcept { return flow_->protocol; }
+    uint32_t peer_ip() const noexcept { return flow_->src_ip; }
+    uint16_t peer_port() const noexcept { return flow_->src_port; }
+
+private:
+    friend class AsyncRow;
+
+    explicit Flow(accnet_flow *flow) noexcept : flow_(flow) {}
+
+    accnet_flow *flow_ = nullptr;
+};
+
+class Scheduler {
+public:
+    /* @poll_us bounds each driver sleep while senders wait for TX space */
+    explicit Scheduler(uint32_t poll_us = 50) : poll_us_(poll_us) { accnet_reactor_init(&reactor_); }
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    void post(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+    /* Run until stop(), or until no session can ever wake again */
+    inline void run();
+    void stop() noexcept { stop_ = true; }
+
+    const accnet_reactor &reactor() const noexcept { return reactor_; }
+
+private:
+    friend class AsyncRow;
+
+    inline void watch(AsyncRow *row);
+    inline void want_tx(AsyncRow *row);
+
+    accnet_reactor reactor_;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::vector<AsyncRow *> rx_rows_;       /* rows registered with the reactor */
+    std::vector<AsyncRow *> tx_rows_;       /* rows with blocked senders */
+    uint32_t poll_us_;
+    bool stop_ = false;
+};
+
+class AsyncRow {
+public:
+    /* @max_flows senders at once, each queueing up to @queue_bytes until its session reads */
+    AsyncRow(Scheduler &sched, Device &dev, uint32_t max_flows = 256, uint32_t queue_bytes = 16 * 1024)
+        : sched_(sched), dev_(dev)
+    {
+        if (accnet_demux_init(&demux_, dev.get(), max_flows, queue_bytes) != 0)
+            throw_errno("accnet_demux_init");
+    }
+
+    ~AsyncRow()
+    {
+        for (uint32_t i = 0; i <= demux_.mask; i++)
+            delete static_cast<FlowState *>(demux_.flows[i].user);
+        accnet_demux_free(&demux_);
+    }
+
+    AsyncRow(const AsyncRow &) = delete;
+    AsyncRow &operator=(const AsyncRow &) = delete;
+
+    class AcceptAwaitable {
+    public:
+        explicit AcceptAwaitable(AsyncRow &row) noexcept : row_(row) {}
+
+        bool await_ready() noexcept
+        {
+            if (row_.accept_waiters_.empty() && !row_.pending_.empty()) {
+                flow_ = Flow(row_.pending_.front());
+                row_.pending_.pop_front();
+                return true;
+            }
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            h_ = h;
+            row_.accept_waiters_.push_back(this);
+            row_.sched_.watch(&row_);
+        }
+        Flow await_resume() const noexcept { return flow_; }
+
+    private:
+        friend class AsyncRow;
+
+        AsyncRow &row_;
+        Flow flow_;
+        std::coroutine_handle<> h_;
+    };
+
+    class RecvAwaitable {
+    public:
+        RecvAwaitable(AsyncRow &row, Flow flow, Span<uint8_t> buf) noexcept
+            : row_(row), flow_(flow), buf_(buf) {}
+
+        /* Fast path: the flow already holds a record and nobody is queued ahead of us */
+        bool await_ready() noexcept
+        {
+            return AsyncRow::state(flow_.flow_)->waiters.empty() && row_.take(flow_.flow_, this);
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            h_ = h;
+            AsyncRow::state(flow_.flow_)->waiters.push_back(this);
+            row_.recv_waiting_++;
+            row_.sched_.watch(&row_);
+        }
+        Message await_resume() const noexcept { return msg_; }
+
+    private:
+        friend class AsyncRow;
+
+        AsyncRow &row_;
+        Flow flow_;
+        Span<uint8_t> buf_;
+        Message msg_{};
+        std::coroutine_handle<> h_;
+    };
+
+    class SendAwaitable {
+    public:
+        SendAwaitable(AsyncRow &row, const accnet_frame_hdr &hdr, Span<const uint8_t> payload) noexcept
+            : row_(row), hdr_(hdr), payload_(payload)
+        {
+            hdr_.len = (uint16_t)payload.size();
+        }
+
+        /* Fast path: the ring has room and we never suspend */
+        bool await_ready() noexcept { return row_.send_waiters_.empty() && try_send(); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            h_ = h;
+            row_.send_waiters_.push_back(this);
+            row_.sched_.want_tx(&row_);
+        }
+        void await_resume() const noexcept {}
+
+    private:
+        friend class AsyncRow;
+
+        bool try_send() noexcept
+        {
+            return accnet_frame_send(row_.dev_.get(), &hdr_, payload_.data()) == 0;
+        }
+
+        AsyncRow &row_;
+        accnet_frame_hdr hdr_;
+        Span<const uint8_t> payload_;
+        std::coroutine_handle<> h_;
+    };
+
+    /* Next sender no session has taken yet */
+    AcceptAwaitable accept() noexcept { return AcceptAwaitable(*this); }
+
+    /* Next framed datagram from @flow; the payload is copied into @buf */
+    RecvAwaitable recv(Flow flow, Span<uint8_t> buf) noexcept { return RecvAwaitable(*this, flow, buf); }
+
+    /* Queue one framed datagram; tuple/seq/flags come from @hdr, len from @payload */
+    SendAwaitable send(const accnet_frame_hdr &hdr, Span<const uint8_t> payload) noexcept
+    {
+        return SendAwaitable(*this, hdr, payload);
+    }
+
+    /*
+     * Forget @flow; its slot and queued records go back to the demux. A
+     * receiver still waiting on it is resumed with an empty Message
+     * (hdr.magic == 0).
+     */
+    void close(Flow flow)
+    {
+        FlowState *st = state(flow.flow_);
+
+        for (RecvAwaitable *w : st->waiters) {
+            w->msg_ = Message{};
+            recv_waiting_--;
+            sched_.post(w->h_);
+        }
+        delete st;
+        flow.flow_->user = nullptr;
+        accnet_demux_flow_close(&demux_, flow.flow_);
+    }
+
+    Device &device() noexcept { return dev_; }
+    const accnet_demux &demux() const noexcept { return demux_; }
+    uint64_t resyncs() const noexcept { return demux_.resyncs; }
+
+private:
+    friend class Scheduler;
+
+    struct FlowState {
+        std::deque<RecvAwaitable *> waiters;
+    };
+
+    static FlowState *state(accnet_flow *flow) noexcept { return static_cast<FlowState *>(flow->user); }
+
+    bool has_waiters() const noexcept { return !accept_waiters_.empty() || recv_waiting_ > 0; }
+
+    /* Copy @flow's next record into @w; false if the flow is empty */
+    bool take(accnet_flow *flow, RecvAwaitable *w) noexcept
+    {
+        accnet_msg m = {};
+
+        m.buf     = w->buf_.data();
+        m.buf_len = (uint32_t)w->buf_.size();
+        if (!accnet_flow_recv(flow, &m))
+            return false;
+        w->msg_ = Message{m.hdr, m.msg_len};
+        return true;
+    }
+
+    /* accnet_reactor handler: queue every complete record by flow, then wake whoever it is for */
+    static uint32_t on_rx(struct accnet_info *accnet, const struct accnet_span *rx, void *arg)
+    {
+        auto *self = static_cast<AsyncRow *>(arg);
+        uint32_t used = accnet_demux_rx_handler(accnet, rx, &self->demux_);
+        accnet_flow *f;
+
+        while ((f = accnet_demux_next_ready(&self->demux_)) != nullptr) {
+            FlowState *st = state(f);
+
+            if (!st) {
+                /* First record from this sender: it becomes a Flow for accept() */
+                f->user = st = new FlowState;
+                if (!self->accept_waiters_.empty()) {
+                    AcceptAwaitable *a = self->accept_waiters_.front();
+                    self->accept_waiters_.pop_front();
+                    a->flow_ = Flow(f);
+                    self->sched_.post(a->h_);
+                } else {
+                    self->pending_.push_back(f);
+                }
+            }
+
+            /* Records nobody is waiting for stay queued on the flow for a later recv() */
+            while (!st->waiters.empty() && self->take(f, st->waiters.front())) {
+                self->sched_.post(st->waiters.front()->h_);
+                st->waiters.pop_front();
+                self->recv_waiting_--;
+            }
+        }
+        return used;
+    }
+
+    /* Retry blocked senders in order; true once none are left */
+    bool pump_tx() noexcept
+    {
+        while (!send_waiters_.empty()) {
+            SendAwaitable *w = send_waiters_.front();
+            if (!w->try_send())
+                return false;
+            send_waiters_.pop_front();
+            sched_.post(w->h_);
+        }
+        return true;
+    }
+
+    Scheduler &sched_;
+    Device &dev_;
+    accnet_demux demux_;
+    std::deque<accnet_flow *> pending_;             /* new flows not yet accepted */
+    std::deque<AcceptAwaitable *> accept_waiters_;
+    std::deque<SendAwaitable *> send_waiters_;
+    size_t recv_waiting_ = 0;
+    bool watched_ = false;
+    bool tx_pending_ = false;
+};
+
+inline void Scheduler::watch(AsyncRow *row)
+{
+    if (row->watched_)
+        return;
+    if (accnet_reactor_add(&reactor_, row->dev_.get(), &AsyncRow::on_rx, row) != 0)
+        throw_errno("accnet_reactor_add");
+    row->watched_ = true;
+    rx_rows_.push_back(row);
+}
+
+inline void Scheduler::want_tx(AsyncRow *row)
+{
+    if (!row->tx_pending_) {
+        row->tx_pending_ = true;
+        tx_rows_.push_back(row);
+    }
+}
+
+inline void Scheduler::run()
+{
+    stop_ = false;
+
+    while (!stop_) {
+        /* Run everything that became runnable; sessions may queue more */
+        while (!ready_.empty()) {
+            auto h = ready_.front();
+            ready_.pop_front();
+            h.resume();
+        }
+
+        for (size_t i = 0; i < tx_rows_.size();) {
+            if (tx_rows_[i]->pump_tx()) {
+                tx_rows_[i]->tx_pending_ = false;
+                tx_rows_[i] = tx_rows_.back();
+                tx_rows_.pop_back();
+            } else {
+                i++;
+            }
+        }
+
+        /* Rows nobody is receiving on leave the reactor so they cannot spin it */
+        for (size_t i = 0; i < rx_rows_.size();) {
+            AsyncRow *row = rx_rows_[i];
+            if (!row->has_waiters()) {
+                accnet_reactor_del(&reactor_, row->dev_.get());
+                row->watched_ = false;
+                rx_rows_[i] = rx_rows_.back();
+                rx_rows_.pop_back();
+            } else {
+                i++;
+            }
+        }
+
+        if (!ready_.empty())
+            continue;
+
+        if (reactor_.mask) {
+            /* Blocked senders need TX space polled, so keep sleeps short */
+            reactor_.timeout_us = tx_rows_.empty() ? 0 : poll_us_;
+            if (accnet_reactor_run_once(&reactor_) < 0)
+                throw_errno("accnet_reactor_run_once");
+        } else if (!tx_rows_.empty()) {
+            iocache_wait_on_txcomp(tx_rows_.front()->dev_.row().get());
+        } else {
+            break;      /* every session finished or is parked for good */
+        }
+    }
+}
+
+} // namespace accnet::coro
+
+#endif /* __ACCNET_CORO_HPP */
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "accnet_demux.h"
+
+#define ACCNET_FLOW_REC_ALIGN   8
+
+static inline uint32_t _accnet_flow_rec_size(uint32_t len)
+{
+    uint32_t n = (uint32_t)sizeof(struct accnet_frame_hdr) + len;
+    return (n + ACCNET_FLOW_REC_ALIGN - 1) & ~(uint32_t)(ACCNET_FLOW_REC_ALIGN - 1);
+}
+
+static inline uint64_t _accnet_demux_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t _accnet_flow_hash(uint8_t protocol, uint32_t ip, uint16_t port)
+{
+    uint64_t k = ((uint64_t)ip << 24) ^ ((uint64_t)port << 8) ^ protocol;
+
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (uint32_t)k;
+}
+
+int accnet_demux_init(struct accnet_demux *d, struct accnet_info *accnet,
+                      uint32_t max_flows, uint32_t queue_bytes)
+{
+    uint32_t slots = 1;
+
+    if (!max_flows || queue_bytes < _accnet_flow_rec_size(0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Keep the table at most half full so probe chains stay short */
+    while (slots < 2 * max_flows)
+        slots <<= 1;
+
+    memset(d, 0, sizeof(*d));
+    d->accnet      = accnet;
+    d->mask        = slots - 1;
+    d->max_flows   = max_flows;
+    d->queue_bytes = queue_bytes;
+
+    /* A closed-then-reused slot can sit on the list twice, hence 2x */
+    d->ready_cap = 2 * slots;
+    d->flows = calloc(slots, sizeof(*d->flows));
+    d->ready = calloc(d->ready_cap, sizeof(*d->ready));
+    if (!d->flows || !d->ready) {
+        free(d->flows);
+        free(d->ready);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void accnet_demux_free(struct accnet_demux *d)
+{
+    if (d->flows) {
+        for (uint32_t i = 0; i <= d->mask; i++)
+            free(d->flows[i].buf);
+    }
+    free(d->flows);
+    free(d->ready);
+    memset(d, 0, sizeof(*d));
+}
+
+struct accnet_flow *accnet_demux_lookup(struct accnet_demux *d, uint8_t protocol,
+                                        uint32_t src_ip, uint16_t src_port)
+{
+    uint32_t i = _accnet_flow_hash(protocol, src_ip, src_port) & d->mask;
+
+    /* Bounded: enough closed flows can leave no FREE slot to stop on */
+    for (uint32_t n = 0; n <= d->mask; n++, i = (i + 1) & d->mask) {
+        struct accnet_flow *f = &d->flows[i];
+
+        if (f->state == ACCNET_FLOW_FREE)
+            return NULL;
+        if (f->state == ACCNET_FLOW_USED && f->src_ip == src_ip &&
+            f->src_port == src_port && f->protocol == protocol)
+            return f;
+    }
+    return NULL;
+}
+
+static struct accnet_flow *_accnet_demux_insert(struct accnet_demux *d, uint8_t protocol,
+                                                uint32_t src_ip, uint16_t src_port)
+{
+    uint32_t i = _accnet_flow_hash(protocol, src_ip, src_port) & d->mask;
+    struct accnet_flow *f;
+
+    if (d->count >= d->max_flows)
+        return NULL;
+
+    /* Caller already missed in lookup, so the first reusable slot is ours */
+    while (d->flows[i].state == ACCNET_FLOW_USED)
+        i = (i + 1) & d->mask;
+    f = &d->flows[i];
+
+    if (!f->buf) {
+        f->buf = malloc(d->queue_bytes);
+        if (!f->buf)
+            return NULL;
+    }
+
+    f->src_ip   = src_ip;
+    f->src_port = src_port;
+    f->protocol = protocol;
+    f->state    = ACCNET_FLOW_USED;
+    f->size     = d->queue_bytes;
+    f->head     = 0;
+    f->used     = 0;
+    f->ready    = false;
+    f->rx_msgs  = 0;
+    f->drops    = 0;
+    f->last_ns  = 0;
+    f->user     = NULL;
+    d->count++;
+    return f;
+}
+
+void accnet_demux_flow_close(struct accnet_demux *d, struct accnet_flow *flow)
+{
+    if (flow->state != ACCNET_FLOW_USED)
+        return;
+
+    /* The buffer stays with the slot for the next flow that lands here */
+    flow->state = ACCNET_FLOW_DEAD;
+    flow->ready = false;
+    flow->used  = 0;
+    d->count--;
+}
+
+int accnet_demux_expire(struct accnet_demux *d, bool force)
+{
+    uint64_t now;
+    int closed = 0;
+
+    if (!d->idle_ns || !d->count)
+        return 0;
+
+    now = _accnet_demux_now_ns();
+    if (!force && now - d->last_sweep_ns < d->idle_ns / 4)
+        return 0;
+    d->last_sweep_ns = now;
+
+    for (uint32_t i = 0; i <= d->mask; i++) {
+        struct accnet_flow *f = &d->flows[i];
+
+        /* Queued data keeps a flow alive until the application drains it */
+        if (f->state != ACCNET_FLOW_USED || f->used || f->ready || now - f->last_ns < d->idle_ns)
+            continue;
+        accnet_demux_flow_close(d, f);
+        closed++;
+    }
+    d->expired += closed;
+    return closed;
+}
+
+static void _accnet_demux_mark_ready(struct accnet_demux *d, struct accnet_flow *flow)
+{
+    if (flow->ready || d->ready_count == d->ready_cap)
+        return;
+
+    flow->ready = true;
+    d->ready[(d->ready_head + d->ready_count) % d->ready_cap] = (uint32_t)(flow - d->flows);
+    d->ready_count++;
+}
+
+struct accnet_flow *accnet_demux_next_ready(struct accnet_demux *d)
+{
+    while (d->ready_count) {
+        struct accnet_flow *f = &d->flows[d->ready[d->ready_head]];
+
+        d->ready_head = (d->ready_head + 1) % d->ready_cap;
+        d->ready_count--;
+
+        /* Skip entries left behind by closed (or closed and reused) flows */
+        if (f->state != ACCNET_FLOW_USED || !f->ready)
+            continue;
+
+        f->ready = false;
+        return f;
+    }
+    return NULL;
+}
+
+static void _accnet_demux_enqueue(struct accnet_demux *d, const struct accnet_frame *frame, uint64_t now)
+{
+    const struct accnet_frame_hdr *hdr = &frame->hdr;
+    struct accnet_flow *f;
+    struct accnet_span dst;
+    uint32_t size = _accnet_flow_rec_size(hdr->len);
+
+    f = accnet_demux_lookup(d, hdr->protocol, hdr->src_ip, hdr->src_port);
+    if (!f)
+        f = _accnet_demux_insert(d, hdr->protocol, hdr->src_ip, hdr->src_port);
+    if (!f && d->count >= d->max_flows && accnet_demux_expire(d, true) > 0)
+        f = _accnet_demux_insert(d, hdr->protocol, hdr->src_ip, hdr->src_port);
+    if (!f) {
+        d->drops_no_flow++;
+        return;
+    }
+    f->last_ns = now;
+
+    if (f->size - f->used < size) {
+        f->drops++;
+        d->drops_queue_full++;
+        return;
+    }
+
+    /* Flow queues wrap like the rings, so the span helpers do the copy */
+    _accnet_span_init(&dst, f->buf, f->size, (f->head + f->used) % f->size, size);
+    accnet_span_write(&dst, 0, hdr, sizeof(*hdr));
+    accnet_span_copy(&dst, sizeof(*hdr), &frame->payload);
+    f->used += size;
+    f->rx_msgs++;
+    d->records++;
+
+    _accnet_demux_mark_ready(d, f);
+}
+
+uint32_t accnet_demux_rx_handler(struct accnet_info *accnet, const struct accnet_span *rx, void *arg)
+{
+    struct accnet_demux *d = arg;
+    struct accnet_frame_iter it = {
+        .accnet = accnet,
+        .span   = *rx,
+    };
+    struct accnet_frame frame;
+    uint64_t now = d->idle_ns ? _accnet_demux_now_ns() : 0;
+    int r;
+
+    while ((r = accnet_frame_next(&it, &frame)) != 0) {
+        if (r < 0) {
+            d->resyncs++;
+            continue;
+        }
+        _accnet_demux_enqueue(d, &frame, now);
+    }
+    return it.off;
+}
+
+int accnet_demux_poll(struct accnet_demux *d)
+{
+    struct accnet_span span;
+    uint64_t before = d->records;
+    uint32_t used;
+
+    accnet_demux_expire(d, false);
+
+    if (accnet_rx_peek(d->accnet, &span) == 0)
+        return 0;
+
+    used = accnet_demux_rx_handler(d->accnet, &span, d);
+    if (used)
+        accnet_rx_release(d->accnet, &span, used);
+
+    return (int)(d->records - before);
+}
+
+int accnet_flow_recv(struct accnet_flow *flow, struct accnet_msg *msg)
+{
+    struct accnet_span src;
+    uint32_t size;
+
+    if (flow->used == 0)
+        return 0;
+
+    _accnet_span_init(&src, flow->buf, flow->size, flow->head, flow->used);
+    accnet_span_read(&src, 0, &msg->hdr, sizeof(msg->hdr));
+
+    msg->msg_len = msg->hdr.len < msg->buf_len ? msg->hdr.len : msg->buf_len;
+    if (msg->msg_len)
+        accnet_span_read(&src, sizeof(msg->hdr), msg->buf, msg->msg_len);
+
+    size = _accnet_flow_rec_size(msg->hdr.len);
+    flow->head  = (flow->head + size) % flow->size;
+    flow->used -= size;
+    return 1;
+}
@@ -0,0 +1,125 @@
+#ifndef __ACCNET_DEMUX_H
+#define __ACCNET_DEMUX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "accnet_lib.h"
+#include "accnet_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Software flow demux for wildcard rows.
+ *
+ * A wildcard row (iocache_setup_wildcard()) takes datagrams for one local
+ * port from any remote host. Every datagram must be framed
+ * (accnet_frame.h). The demux walks the row's RX ring and copies each
+ * record into a per-flow queue, keyed by the sender's (protocol, src_ip,
+ * src_port) from the record header. Then it hands the RX bytes back to
+ * the NIC at once, so a slow flow cannot stall the shared hardware ring.
+ *
+ * The key is what the peer wrote into its frame header, not the packet's
+ * real source: the UDP RX ring is a plain byte stream and the engine
+ * records no per-packet tuple next to it. Peers must fill the header's
+ * tuple (accnet_frame_hdr_init() with their own connection_info), and a
+ * peer that lies about it lands in someone else's flow.
+ *
+ * Flows are created on their first datagram, up to max_flows. With idle_ns
+ * set, a flow that has been empty and silent that long is closed by
+ * accnet_demux_expire(), which accnet_demux_poll() runs, and a full table
+ * expires idle flows before it turns a new sender away. Beyond that,
+ * datagrams from new senders are dropped and counted. Flows that received
+ * data are queued on a ready list for accnet_demux_next_ready().
+ *
+ * accnet_demux_rx_handler() can be registered with an accnet_reactor
+ * directly. accnet_demux_poll() is the standalone equivalent.
+ */
+
+enum {
+    ACCNET_FLOW_FREE = 0,
+    ACCNET_FLOW_USED,
+    ACCNET_FLOW_DEAD,       /* closed; keeps hash probe chains intact */
+};
+
+struct accnet_flow {
+    uint32_t  src_ip;
+    uint16_t  src_port;
+    uint8_t   protocol;
+    uint8_t   state;
+
+    uint8_t  *buf;          /* records: header + payload, 8B padded */
+    uint32_t  size, head, used;
+    bool      ready;        /* on the demux ready list */
+
+    uint64_t  rx_msgs;
+    uint64_t  drops;        /* queue full */
+    uint64_t  last_ns;      /* CLOCK_MONOTONIC of the last datagram */
+    void     *user;         /* for the application; cleared when the slot is reused */
+};
+
+struct accnet_demux {
+    struct accnet_info *accnet;
+
+    struct accnet_flow *flows;
+    uint32_t mask;          /* table slots - 1 */
+    uint32_t count, max_flows;
+    uint32_t queue_bytes;
+
+    uint32_t *ready;        /* ring of slot indexes */
+    uint32_t ready_cap, ready_head, ready_count;
+
+    uint64_t idle_ns;       /* 0: flows live until accnet_demux_flow_close() */
+    uint64_t last_sweep_ns;
+
+    /* counters */
+    uint64_t records;
+    uint64_t drops_no_flow;     /* table full */
+    uint64_t drops_queue_full;
+    uint64_t resyncs;
+    uint64_t expired;
+};
+
+int  accnet_demux_init(struct accnet_demux *d, struct accnet_info *accnet,
+                       uint32_t max_flows, uint32_t queue_bytes);
+void accnet_demux_free(struct accnet_demux *d);
+
+/* Move every complete record from the RX ring into flow queues; returns records moved */
+int  accnet_demux_poll(struct accnet_demux *d);
+
+/* accnet_rx_handler_t flavour of accnet_demux_poll(); @arg is the demux */
+uint32_t accnet_demux_rx_handler(struct accnet_info *accnet, const struct accnet_span *rx, void *arg);
+
+/* Flow keyed by the sender-written header tuple, or NULL */
+struct accnet_flow *accnet_demux_lookup(struct accnet_demux *d, uint8_t protocol,
+                                        uint32_t src_ip, uint16_t src_port);
+
+/* Next flow that received data since it was last returned here, or NULL */
+struct accnet_flow *accnet_demux_next_ready(struct accnet_demux *d);
+
+void accnet_demux_flow_close(struct accnet_demux *d, struct accnet_flow *flow);
+
+/*
+ * Close every flow that is empty, off the ready list and silent for
+ * idle_ns. Sweeps at most every idle_ns / 4 unless @force. Returns flows closed.
+ */
+int  accnet_demux_expire(struct accnet_demux *d, bool force);
+
+/*
+ * Pop one message from @flow. The header and payload are copied into
+ * @msg (payload truncated to msg->buf_len). Returns 1, or 0 if the queue is empty.
+ */
+int  accnet_flow_recv(struct accnet_flow *flow, struct accnet_msg *msg);
+
+static inline bool accnet_flow_empty(const struct accnet_flow *flow)
+{
+    return flow->used == 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCNET_DEMUX_H */
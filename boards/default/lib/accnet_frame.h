@@ -0,0 +1,243 @@
+#ifndef __ACCNET_FRAME_H
+#define __ACCNET_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "accnet_lib.h"
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Framed datagram mode on top of the UDP byte rings.
+ *
+ * Every datagram is written as one record: a 32-byte header followed by
+ * the payload, padded so the next record starts on a 64-byte boundary.
+ * Both ends must use framed mode. The UDP MTU (1472) is itself a multiple
+ * of 64, so a dropped packet leaves the stream 64-byte aligned, and
+ * accnet_frame_next() can resync on the next valid header.
+ *
+ * Header fields are little-endian. The engine only exposes a per-ring
+ * "last packet" timestamp, so tx_timestamp carries the sender's
+ * ACCNET_CTRL_TIMESTAMP at enqueue. The iterator reports the receive-side
+ * timestamp once per walk.
+ */
+#define ACCNET_FRAME_ALIGN      64
+#define ACCNET_FRAME_MAGIC      0xA5
+#define ACCNET_FRAME_MAX_LEN    0xFFFF
+
+/* flags */
+#define ACCNET_FRAME_F_PAD      (1U << 0)   /* filler, no payload for the application */
+#define ACCNET_FRAME_F_REPLY    (1U << 1)   /* echo of a request with the same seq */
+
+struct accnet_frame_hdr {
+    uint16_t len;           /* payload bytes after the header */
+    uint8_t  magic;
+    uint8_t  flags;
+    uint8_t  protocol;
+    uint8_t  rsvd[3];
+    uint32_t src_ip, dst_ip;
+    uint16_t src_port, dst_port;
+    uint32_t seq;
+    uint64_t tx_timestamp;
+};
+
+#ifdef __cplusplus
+static_assert(sizeof(struct accnet_frame_hdr) == 32, "accnet_frame_hdr must be 32 bytes");
+#else
+_Static_assert(sizeof(struct accnet_frame_hdr) == 32, "accnet_frame_hdr must be 32 bytes");
+#endif
+
+/* One received record: a copy of its header and a view of its payload in the ring */
+struct accnet_frame {
+    struct accnet_frame_hdr hdr;
+    struct accnet_span      payload;
+};
+
+struct accnet_frame_iter {
+    struct accnet_info *accnet;
+    struct accnet_span  span;   /* everything readable when the walk started */
+    uint32_t off;               /* start of the next record within span */
+    uint64_t rx_timestamp;      /* RX_RING_LAST_TIMESTAMP at the start of the walk */
+};
+
+/* Ring bytes taken by a record carrying @len payload bytes */
+static inline uint32_t accnet_frame_size(uint32_t len)
+{
+    uint32_t n = (uint32_t)sizeof(struct accnet_frame_hdr) + len;
+    return (n + ACCNET_FRAME_ALIGN - 1) & ~(uint32_t)(ACCNET_FRAME_ALIGN - 1);
+}
+
+/* Fill a header for @conn; src/dst are from this host's point of view */
+static inline void accnet_frame_hdr_init(struct accnet_frame_hdr *hdr, const struct connection_info *conn,
+                                         uint32_t seq, uint16_t len, uint8_t flags)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->len      = len;
+    hdr->magic    = ACCNET_FRAME_MAGIC;
+    hdr->flags    = flags;
+    hdr->seq      = seq;
+    if (conn) {
+        hdr->protocol = conn->protocol;
+        hdr->src_ip   = conn->src_ip;
+        hdr->dst_ip   = conn->dst_ip;
+        hdr->src_port = conn->src_port;
+        hdr->dst_port = conn->dst_port;
+    }
+}
+
+/* Header for a reply to @req: same seq, tuple swapped */
+static inline void accnet_frame_hdr_reply(struct accnet_frame_hdr *hdr, const struct accnet_frame_hdr *req,
+                                          uint16_t len)
+{
+    *hdr = *req;
+    hdr->len      = len;
+    hdr->flags    = ACCNET_FRAME_F_REPLY;
+    hdr->src_ip   = req->dst_ip;
+    hdr->dst_ip   = req->src_ip;
+    hdr->src_port = req->dst_port;
+    hdr->dst_port = req->src_port;
+}
+
+/* Write one record at byte @off of a reserved TX @span; returns the bytes it takes */
+static inline uint32_t accnet_frame_write(const struct accnet_span *span, uint32_t off,
+                                          const struct accnet_frame_hdr *hdr, const void *payload)
+{
+    accnet_span_write(span, off, hdr, sizeof(*hdr));
+    if (hdr->len)
+        accnet_span_write(span, off + sizeof(*hdr), payload, hdr->len);
+    return accnet_frame_size(hdr->len);
+}
+
+/*
+ * Queue one framed datagram and ring the doorbell. The header's
+ * tx_timestamp is filled here. Returns 0, or -1 with errno = EAGAIN when
+ * the TX ring is full.
+ */
+static inline int accnet_frame_send(struct accnet_info *accnet, struct accnet_frame_hdr *hdr,
+                                    const void *payload)
+{
+    struct accnet_span span;
+    uint32_t size = accnet_frame_size(hdr->len);
+
+    if (accnet_tx_reserve(accnet, size, &span) != 0)
+        return -1;
+
+    hdr->tx_timestamp = accnet_get_time(accnet);
+    accnet_frame_write(&span, 0, hdr, payload);
+    accnet_tx_commit(accnet, &span, size);
+    return 0;
+}
+
+/* Start walking every record currently in the RX ring */
+static inline void accnet_frame_iter_init(struct accnet_info *accnet, struct accnet_frame_iter *it)
+{
+    it->accnet = accnet;
+    it->off    = 0;
+    accnet_rx_peek(accnet, &it->span);
+    it->rx_timestamp = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(accnet->iocache->row));
+}
+
+/*
+ * A record the ring can never hold in full (it keeps one byte free) is as
+ * corrupt as a bad magic: waiting for its tail would stall the walk forever.
+ */
+static inline bool _accnet_frame_hdr_ok(const struct accnet_frame_iter *it, const struct accnet_frame_hdr *hdr)
+{
+    return hdr->magic == ACCNET_FRAME_MAGIC && (hdr->rsvd[0] | hdr->rsvd[1] | hdr->rsvd[2]) == 0 &&
+           accnet_frame_size(hdr->len) < it->accnet->ring.rx_size;
+}
+
+/*
+ * Next complete record. Returns 1 and fills @frame, or 0 when the rest of
+ * the ring holds no complete record. Padding records are skipped. A
+ * corrupt header (lost packet, or a length the ring cannot hold) returns
+ * -1 with errno = EPROTO, after skipping forward to the next 64-byte slot
+ * that looks like a header.
+ */
+static inline int accnet_frame_next(struct accnet_frame_iter *it, struct accnet_frame *frame)
+{
+    uint32_t total = accnet_span_len(&it->span);
+
+    while (total - it->off >= sizeof(struct accnet_frame_hdr)) {
+        uint32_t size;
+
+        accnet_span_read(&it->span, it->off, &frame->hdr, sizeof(frame->hdr));
+
+        if (!_accnet_frame_hdr_ok(it, &frame->hdr)) {
+            /* Resync: leave the iterator on the next plausible header */
+            uint32_t start = it->off;
+
+            while (total - it->off >= ACCNET_FRAME_ALIGN + sizeof(struct accnet_frame_hdr)) {
+                it->off += ACCNET_FRAME_ALIGN;
+                accnet_span_read(&it->span, it->off, &frame->hdr, sizeof(frame->hdr));
+                if (_accnet_frame_hdr_ok(it, &frame->hdr))
+                    break;
+            }
+            if (it->off == start)
+                return 0;   /* need more bytes before we can skip ahead */
+            errno = EPROTO;
+            return -1;
+        }
+
+        size = accnet_frame_size(frame->hdr.len);
+        if (total - it->off < size)
+            return 0;       /* tail of the record has not arrived yet */
+
+        if (frame->hdr.flags & ACCNET_FRAME_F_PAD) {
+            it->off += size;
+            continue;
+        }
+
+        /* Payload view inside the ring; may wrap like any other span */
+        _accnet_span_init(&frame->payload, (uint8_t *)it->accnet->iocache->udp_rx_buffer,
+                          it->accnet->ring.rx_size,
+                          (it->span.pos + it->off + sizeof(frame->hdr)) % it->accnet->ring.rx_size,
+                          frame->hdr.len);
+        it->off += size;
+        return 1;
+    }
+    return 0;
+}
+
+/* Hand every record returned so far back to the NIC */
+static inline void accnet_frame_iter_done(struct accnet_frame_iter *it)
+{
+    if (it->off)
+        accnet_rx_release(it->accnet, &it->span, it->off);
+}
+
+/* ===================================================================== */
+/* ===================  Batched API (accnet_lib.c)  ==================== */
+/* ===================================================================== */
+/*
+ * recvmmsg/sendmmsg-style calls over framed rings. A whole batch costs one
+ * fence and one TX_TAIL doorbell (send), or one RX_HEAD update (recv).
+ */
+struct accnet_msg {
+    struct accnet_frame_hdr hdr;    /* send: len/tuple/seq from the caller; recv: copy of the header */
+    void     *buf;                  /* send: payload; recv: destination */
+    uint32_t  buf_len;              /* recv: capacity of buf */
+    uint32_t  msg_len;              /* recv: bytes copied into buf (payload truncated if > buf_len) */
+};
+
+/* Queue up to @n messages. Returns how many fit, or -1 with errno = EAGAIN if none did. */
+int accnet_send_batch(struct accnet_info *accnet, struct accnet_msg *msgs, unsigned int n);
+
+/*
+ * Receive up to @n complete messages, copying each payload into its buf.
+ * Returns the number received (0 if none). Use the accnet_frame_iter
+ * calls directly to read payloads in place without copying.
+ */
+int accnet_recv_batch(struct accnet_info *accnet, struct accnet_msg *msgs, unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCNET_FRAME_H */
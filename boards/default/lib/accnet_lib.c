@@ -11,9 +11,13 @@
 #include <limits.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
 
 #include "accnet_ioctl.h"
 #include "accnet_lib.h"
+#include "accnet_frame.h"
 #include "iocache_lib.h"
 #include "common.h"
 
@@ -116,8 +120,8 @@ int accnet_start_ring(struct accnet_info *accnet) {
 
 uint64_t accnet_get_outside_ticks(struct accnet_info *accnet) {
     int row = accnet->iocache->row;
-    volatile rx_timestamp = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(row));
-    volatile tx_timestamp = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row));
+    uint64_t rx_timestamp = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(row));
+    uint64_t tx_timestamp = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row));
 
     if (rx_timestamp <= tx_timestamp) {
         // printf("Warning: bad timestamps -- tx=%lu , rx=%lu\n", tx_timestamp, rx_timestamp);
@@ -126,27 +130,258 @@ uint64_t accnet_get_outside_ticks(struct accnet_info *accnet) {
     return (uint64_t)(rx_timestamp - tx_timestamp);
 }
 
-size_t accnet_send(struct accnet_info *accnet, void *buffer, size_t len) {
+/* Best of a few (CLOCK_MONOTONIC, tick, CLOCK_MONOTONIC) reads; the tick is pinned to the midpoint */
+static void _accnet_clock_anchor(struct accnet_info *accnet, uint64_t *tick, uint64_t *ns, uint64_t *err_ns) {
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < ACCNET_CLOCK_SAMPLES; i++) {
+        struct timespec a, b;
+        uint64_t t, a_ns, b_ns;
+
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        t = accnet_get_time(accnet);
+        clock_gettime(CLOCK_MONOTONIC, &b);
+
+        a_ns = (uint64_t)a.tv_sec * 1000000000ULL + (uint64_t)a.tv_nsec;
+        b_ns = (uint64_t)b.tv_sec * 1000000000ULL + (uint64_t)b.tv_nsec;
+        if (b_ns - a_ns < best) {
+            best  = b_ns - a_ns;
+            *tick = t;
+            *ns   = a_ns + best / 2;
+        }
+    }
+    *err_ns = best / 2;
+}
+
+int accnet_clock_sync(struct accnet_info *accnet, struct accnet_clock *clk, uint32_t span_us) {
+    uint64_t t1, ns1, err1;
+
+    _accnet_clock_anchor(accnet, &clk->tick0, &clk->ns0, &clk->err_ns);
+    clk->ns_per_tick = NS_PER_TICK;
+    if (span_us == 0)
+        return 0;
+
+    usleep(span_us);
+    _accnet_clock_anchor(accnet, &t1, &ns1, &err1);
+    if (t1 <= clk->tick0 || ns1 <= clk->ns0) {
+        errno = EIO;
+        return -1;
+    }
+
+    clk->ns_per_tick = (double)(ns1 - clk->ns0) / (double)(t1 - clk->tick0);
+    if (err1 > clk->err_ns)
+        clk->err_ns = err1;
+    return 0;
+}
+
+/* Reload the ring shadow from the device; needed after anything rewrites head/tail behind our back */
+void accnet_ring_sync(struct accnet_info *accnet) {
     struct iocache_info *iocache = accnet->iocache;
+    struct ring_info *ring = &accnet->ring;
+    int row = iocache->row;
+
+    ring->tx_size = reg_read32(iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
+    ring->rx_size = reg_read32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row));
+    if (ring->tx_size == 0) ring->tx_size = (uint32_t)iocache->udp_tx_size;
+    if (ring->rx_size == 0) ring->rx_size = (uint32_t)iocache->udp_rx_size;
+    ring->tx_head = accnet_get_tx_head(accnet);
+    ring->tx_tail = accnet_get_tx_tail(accnet);
+    ring->rx_head = accnet_get_rx_head(accnet);
+    ring->rx_tail = accnet_get_rx_tail(accnet);
+    mmio_rmb();
+}
 
-    uint32_t tx_head, tx_tail, tx_size;
+/* Copy @len bytes into the TX ring and ring the doorbell. Returns 0 if the ring is full. */
+size_t accnet_send(struct accnet_info *accnet, void *buffer, size_t len) {
+    struct accnet_span span;
 
-    tx_head = accnet_get_tx_head(accnet); 
-    tx_tail = accnet_get_tx_tail(accnet); 
-    tx_size = iocache->udp_tx_size;
+    if (len > UINT32_MAX || accnet_tx_reserve(accnet, (uint32_t)len, &span) != 0)
+        return 0;
 
-    uint32_t avail = (tx_tail > tx_head) ? tx_tail - tx_head : tx_size - (tx_head - tx_size);
-    uint32_t val = (tx_tail + len) % tx_size;
+    accnet_span_write(&span, 0, buffer, (uint32_t)len);
+    accnet_tx_commit(accnet, &span, (uint32_t)len);
 
-    memcpy((char *)iocache->udp_tx_buffer + tx_tail, buffer, len);
-    __sync_synchronize();
+    return len;
+}
 
-    accnet_set_tx_tail(accnet, val);
+int accnet_send_batch(struct accnet_info *accnet, struct accnet_msg *msgs, unsigned int n) {
+    struct accnet_span span;
+    uint32_t total = 0, off = 0;
+    uint32_t space;
+    uint64_t now;
+    unsigned int i, count;
+
+    /* Take as many whole messages as the ring has room for; TX_HEAD is only read if the shadow falls short */
+    for (i = 0; i < n; i++)
+        total += accnet_frame_size(msgs[i].hdr.len);
+    space = accnet_tx_space(accnet, total);
+
+    total = 0;
+    for (count = 0; count < n; count++) {
+        uint32_t size = accnet_frame_size(msgs[count].hdr.len);
+        if (total + size > space)
+            break;
+        total += size;
+    }
+
+    if (count == 0 || accnet_tx_reserve(accnet, total, &span) != 0) {
+        errno = EAGAIN;
+        return -1;
+    }
 
+    now = accnet_get_time(accnet);
+    for (i = 0; i < count; i++) {
+        msgs[i].hdr.magic = ACCNET_FRAME_MAGIC;
+        msgs[i].hdr.tx_timestamp = now;
+        off += accnet_frame_write(&span, off, &msgs[i].hdr, msgs[i].buf);
+    }
+
+    /* One fence + one doorbell for the whole batch */
+    accnet_tx_commit(accnet, &span, total);
+    return (int)count;
+}
+
+int accnet_recv_batch(struct accnet_info *accnet, struct accnet_msg *msgs, unsigned int n) {
+    struct accnet_frame_iter it;
+    struct accnet_frame frame;
+    unsigned int count = 0;
+    int r;
+
+    accnet_frame_iter_init(accnet, &it);
+    while (count < n && (r = accnet_frame_next(&it, &frame)) != 0) {
+        struct accnet_msg *m = &msgs[count];
+
+        if (r < 0)
+            continue;   /* resynced past a lost packet */
+
+        m->hdr = frame.hdr;
+        m->msg_len = (frame.hdr.len < m->buf_len) ? frame.hdr.len : m->buf_len;
+        if (m->msg_len)
+            accnet_span_read(&frame.payload, 0, m->buf, m->msg_len);
+        count++;
+    }
+
+    /* One RX_HEAD update for everything consumed */
+    accnet_frame_iter_done(&it);
+    return (int)count;
+}
+
+int accnet_mp_tx_init(struct accnet_mp_tx *mp, struct accnet_info *accnet) {
+    struct ring_info *ring = &accnet->ring;
+    uint64_t used;
+
+    if (!mp || !accnet || ring->tx_size == 0)
+        return -1;
+
+    accnet_ring_sync(accnet);
+    used = _accnet_ring_used(ring->tx_head, ring->tx_tail, ring->tx_size);
+
+    /* Stream offsets keep offset % size == ring position; start one lap in so head never underflows */
+    uint64_t tail = (uint64_t)ring->tx_tail + ring->tx_size;
+
+    mp->accnet = accnet;
+    mp->size   = ring->tx_size;
+    mp->rung   = tail;
+    atomic_init(&mp->reserved,  tail);
+    atomic_init(&mp->committed, tail);
+    atomic_init(&mp->head,      tail - used);
+    atomic_flag_clear(&mp->doorbell_lock);
+    return 0;
+}
+
+/* Re-read TX_HEAD and advance the shared stream view of it; returns the newest value */
+static uint64_t _accnet_mp_refresh_head(struct accnet_mp_tx *mp) {
+    uint64_t old = atomic_load_explicit(&mp->head, memory_order_acquire);
+    uint32_t hw  = accnet_get_tx_head(mp->accnet);
+    mmio_rmb();
+
+    /* The engine never gets more than one ring behind, so the distance is exact mod size */
+    uint64_t now = old + ((hw + mp->size - (uint32_t)(old % mp->size)) % mp->size);
+
+    while (now > old &&
+           !atomic_compare_exchange_weak_explicit(&mp->head, &old, now,
+                                                  memory_order_acq_rel, memory_order_acquire))
+        ;
+    return (now > old) ? now : old;
+}
+
+/*
+ * Claim @len bytes. Returns 0 and fills @slot, or -1 with errno = EAGAIN
+ * when the ring is full (EMSGSIZE if it never fits). A plain fetch-add
+ * could not back out on a full ring, so the claim is a CAS loop.
+ */
+int accnet_mp_tx_reserve(struct accnet_mp_tx *mp, uint32_t len, struct accnet_mp_slot *slot) {
+    uint64_t start = atomic_load_explicit(&mp->reserved, memory_order_relaxed);
+    uint64_t head  = atomic_load_explicit(&mp->head, memory_order_acquire);
+    bool refreshed = false;
+
+    if (len >= mp->size) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    for (;;) {
+        /* One byte stays empty, same as the single-producer path */
+        if (start + len - head > mp->size - 1) {
+            if (refreshed) {
+                errno = EAGAIN;
+                return -1;
+            }
+            head = _accnet_mp_refresh_head(mp);
+            refreshed = true;
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&mp->reserved, &start, start + len,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            break;
+    }
+
+    slot->start = start;
+    _accnet_span_init(&slot->span, (uint8_t *)mp->accnet->iocache->udp_tx_buffer,
+                      mp->size, (uint32_t)(start % mp->size), len);
+    return 0;
+}
+
+/* Publish a filled slot once every earlier slot is published */
+void accnet_mp_tx_commit(struct accnet_mp_tx *mp, const struct accnet_mp_slot *slot) {
+    uint64_t end = slot->start + accnet_span_len(&slot->span);
+    unsigned int spins = 0;
+
+    while (atomic_load_explicit(&mp->committed, memory_order_acquire) != slot->start) {
+        if (++spins % 1024 == 0)
+            sched_yield();
+    }
+    /* Release: our payload stores are ordered before the new commit point */
+    atomic_store_explicit(&mp->committed, end, memory_order_release);
+
+    /* Someone claimed after us: their doorbell will cover our bytes too */
+    if (atomic_load_explicit(&mp->reserved, memory_order_acquire) != end)
+        return;
+
+    while (atomic_flag_test_and_set_explicit(&mp->doorbell_lock, memory_order_acquire))
+        ;
+    uint64_t now = atomic_load_explicit(&mp->committed, memory_order_acquire);
+    if (now > mp->rung) {
+        mmio_wmb();
+        accnet_set_tx_tail(mp->accnet, (uint32_t)(now % mp->size));
+        mp->rung = now;
+    }
+    atomic_flag_clear_explicit(&mp->doorbell_lock, memory_order_release);
+}
+
+/* Multi-producer counterpart of accnet_send(); returns 0 if the ring is full */
+size_t accnet_mp_send(struct accnet_mp_tx *mp, const void *buffer, size_t len) {
+    struct accnet_mp_slot slot;
+
+    if (len > UINT32_MAX || accnet_mp_tx_reserve(mp, (uint32_t)len, &slot) != 0)
+        return 0;
+
+    accnet_span_write(&slot.span, 0, buffer, (uint32_t)len);
+    accnet_mp_tx_commit(mp, &slot);
     return len;
 }
 
-int accnet_open(char *file, struct accnet_info *accnet, struct iocache_info *iocache, bool do_init) {
+int accnet_open(const char *file, struct accnet_info *accnet, struct iocache_info *iocache, bool do_init) {
     uintptr_t p;
 
     if (!iocache) {
@@ -183,6 +418,7 @@ int accnet_open(char *file, struct accnet_info *accnet, struct iocache_info *ioc
     if (accnet->udp_tx_regs == MAP_FAILED)
     {
         perror("udp_tx_regs mmap regs failed");
+        munmap((void *)(uintptr_t) accnet->regs, accnet->regs_size);
         close(accnet->fd);
         return -1;
     }
@@ -191,6 +427,8 @@ int accnet_open(char *file, struct accnet_info *accnet, struct iocache_info *ioc
     if (accnet->udp_rx_regs == MAP_FAILED)
     {
         perror("udp_rx_regs mmap regs failed");
+        munmap((void *)(uintptr_t) accnet->udp_tx_regs, accnet->udp_tx_regs_size);
+        munmap((void *)(uintptr_t) accnet->regs, accnet->regs_size);
         close(accnet->fd);
         return -1;
     }
@@ -199,6 +437,8 @@ int accnet_open(char *file, struct accnet_info *accnet, struct iocache_info *ioc
         _init_regs(accnet, iocache->row);
     }
 
+    accnet_ring_sync(accnet);
+
     return 0;
 }
 
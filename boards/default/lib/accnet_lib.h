@@ -6,10 +6,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
 
 #include "iocache_lib.h"
+#include "ring_copy.h"
 #include "common.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* =========================  UDP  =========================== */
 #define ACCNET_UDP_RING_SIZE 	256 * 1024 		// 64KB
 #define ACCNET_UDP_RING_COUNT	1
@@ -69,6 +79,13 @@
 #define ACCNET_CTRL_INTR_MASK              0x00
 #define ACCNET_CTRL_TIMESTAMP              0x10
 
+/*
+ * Host-side shadow of the row's ring state, filled by accnet_ring_sync().
+ * Sizes never change after open and tx_tail/rx_head are only written by
+ * us, so those are never read back. tx_head/rx_tail are the last values
+ * seen from the engine and are only re-read over MMIO when the cached
+ * value cannot satisfy the caller.
+ */
 struct ring_info {
     uint32_t rx_head, rx_tail, rx_size;
     uint32_t tx_head, tx_tail, tx_size;
@@ -90,19 +107,44 @@ struct accnet_info {
     struct ring_info ring;
 };
 
-int accnet_open(char *file, struct accnet_info *accnet, struct iocache_info *iocache, bool do_init);
+int accnet_open(const char *file, struct accnet_info *accnet, struct iocache_info *iocache, bool do_init);
 int accnet_close(struct accnet_info *accnet);
 
 int accnet_start_ring(struct accnet_info *accnet);
 int accnet_setup_connection(struct accnet_info *accnet, struct connection_info *connection);
 
 uint64_t accnet_get_outside_ticks(struct accnet_info *accnet);
+void accnet_ring_sync(struct accnet_info *accnet);
 
 size_t accnet_send(struct accnet_info *accnet, void *buffer, size_t len);
 
 static inline uint64_t accnet_get_time(struct accnet_info *accnet) 
 {
-    reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+    return reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+}
+
+/*
+ * Mapping from device ticks (ACCNET_CTRL_TIMESTAMP and the ring
+ * LAST_TIMESTAMP registers) to CLOCK_MONOTONIC ns, the clock the driver
+ * stamps interrupts with. accnet_clock_sync() pins one tick to the
+ * midpoint of the tightest of ACCNET_CLOCK_SAMPLES bracketing clock reads,
+ * then measures the tick rate against a second anchor @span_us later. With
+ * span_us = 0 the nominal NS_PER_TICK is used. err_ns is half the widest
+ * bracket, the uncertainty of any converted timestamp.
+ */
+#define ACCNET_CLOCK_SAMPLES    32
+
+struct accnet_clock {
+    uint64_t tick0, ns0;
+    double   ns_per_tick;
+    uint64_t err_ns;
+};
+
+int accnet_clock_sync(struct accnet_info *accnet, struct accnet_clock *clk, uint32_t span_us);
+
+static inline uint64_t accnet_clock_to_ns(const struct accnet_clock *clk, uint64_t tick)
+{
+    return clk->ns0 + (int64_t)((double)(int64_t)(tick - clk->tick0) * clk->ns_per_tick);
 }
 
 static inline void accnet_set_rx_head(struct accnet_info *accnet, uint32_t val) 
@@ -111,23 +153,249 @@ static inline void accnet_set_rx_head(struct accnet_info *accnet, uint32_t val)
 }
 static inline void accnet_set_tx_tail(struct accnet_info *accnet, uint32_t val) 
 {
-    reg_write32(accnet->udp_rx_regs, ACCNET_UDP_TX_RING_TAIL(accnet->iocache->row), val);
+    reg_write32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(accnet->iocache->row), val);
 }
 static inline uint32_t accnet_get_rx_head(struct accnet_info *accnet) 
 {
-    return reg_read32(accnet, ACCNET_UDP_RX_RING_HEAD(accnet->iocache->row));
+    return reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(accnet->iocache->row));
 }
 static inline uint32_t accnet_get_rx_tail(struct accnet_info *accnet) 
 {
-    return reg_read32(accnet, ACCNET_UDP_RX_RING_TAIL(accnet->iocache->row));
+    return reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(accnet->iocache->row));
 }
 static inline uint32_t accnet_get_tx_head(struct accnet_info *accnet) 
 {
-    return reg_read32(accnet, ACCNET_UDP_TX_RING_HEAD(accnet->iocache->row));
+    return reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(accnet->iocache->row));
 }
 static inline uint32_t accnet_get_tx_tail(struct accnet_info *accnet) 
 {
-    return reg_read32(accnet, ACCNET_UDP_TX_RING_TAIL(accnet->iocache->row));
+    return reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(accnet->iocache->row));
+}
+
+/* ===================================================================== */
+/* =========================  Zero-copy ring API  ====================== */
+/* ===================================================================== */
+/*
+ * A byte range of a UDP ring in DMA memory. When the range runs past the
+ * end of the ring it is split in two: ptr[1]/len[1] is the part that
+ * wrapped to the start (len[1] == 0 otherwise). Rings keep one byte empty
+ * to tell full from empty.
+ *
+ *   TX: accnet_tx_reserve() -> write into the span -> accnet_tx_commit()
+ *   RX: accnet_rx_peek()    -> read from the span  -> accnet_rx_release()
+ */
+struct accnet_span {
+    uint8_t  *ptr[2];
+    uint32_t  len[2];
+    uint32_t  pos;          /* ring offset of ptr[0] */
+};
+
+static inline uint32_t accnet_span_len(const struct accnet_span *span)
+{
+    return span->len[0] + span->len[1];
+}
+
+static inline void _accnet_span_init(struct accnet_span *span, uint8_t *base,
+                                     uint32_t size, uint32_t pos, uint32_t len)
+{
+    uint32_t first = (len > size - pos) ? size - pos : len;
+
+    span->pos    = pos;
+    span->ptr[0] = base + pos;
+    span->len[0] = first;
+    span->ptr[1] = base;
+    span->len[1] = len - first;
+}
+
+/* Copy @len bytes from @src into @span starting at byte @off of the span */
+static inline void accnet_span_write(const struct accnet_span *span, uint32_t off,
+                                     const void *src, uint32_t len)
+{
+    const uint8_t *s = (const uint8_t *)src;
+
+    if (off < span->len[0]) {
+        uint32_t n = span->len[0] - off;
+        if (n > len) n = len;
+        ring_copy(span->ptr[0] + off, s, n);
+        s += n; len -= n; off = 0;
+    } else {
+        off -= span->len[0];
+    }
+    if (len)
+        ring_copy(span->ptr[1] + off, s, len);
+}
+
+/* Copy @len bytes out of @span starting at byte @off of the span */
+static inline void accnet_span_read(const struct accnet_span *span, uint32_t off,
+                                    void *dst, uint32_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+
+    if (off < span->len[0]) {
+        uint32_t n = span->len[0] - off;
+        if (n > len) n = len;
+        ring_copy(d, span->ptr[0] + off, n);
+        d += n; len -= n; off = 0;
+    } else {
+        off -= span->len[0];
+    }
+    if (len)
+        ring_copy(d, span->ptr[1] + off, len);
+}
+
+/* Copy all of @src (e.g. an RX span) into @dst starting at byte @off of @dst */
+static inline void accnet_span_copy(const struct accnet_span *dst, uint32_t off,
+                                    const struct accnet_span *src)
+{
+    accnet_span_write(dst, off, src->ptr[0], src->len[0]);
+    if (src->len[1])
+        accnet_span_write(dst, off + src->len[0], src->ptr[1], src->len[1]);
+}
+
+static inline uint32_t _accnet_ring_used(uint32_t head, uint32_t tail, uint32_t size)
+{
+    return (tail >= head) ? (tail - head) : (size - (head - tail));
+}
+
+/* Free TX bytes; TX_HEAD is only re-read when the shadow shows fewer than @want */
+static inline uint32_t accnet_tx_space(struct accnet_info *accnet, uint32_t want)
+{
+    struct ring_info *ring = &accnet->ring;
+    uint32_t space = ring->tx_size - _accnet_ring_used(ring->tx_head, ring->tx_tail, ring->tx_size) - 1;
+
+    if (space < want) {
+        ring->tx_head = accnet_get_tx_head(accnet);
+        mmio_rmb();
+        space = ring->tx_size - _accnet_ring_used(ring->tx_head, ring->tx_tail, ring->tx_size) - 1;
+    }
+    return space;
+}
+
+/* Readable RX bytes; RX_TAIL is only re-read when the shadow shows fewer than @want */
+static inline uint32_t accnet_rx_avail(struct accnet_info *accnet, uint32_t want)
+{
+    struct ring_info *ring = &accnet->ring;
+    uint32_t used = _accnet_ring_used(ring->rx_head, ring->rx_tail, ring->rx_size);
+
+    if (used < want) {
+        ring->rx_tail = accnet_get_rx_tail(accnet);
+        mmio_rmb();
+        used = _accnet_ring_used(ring->rx_head, ring->rx_tail, ring->rx_size);
+    }
+    return used;
+}
+
+/*
+ * Reserve @len writable bytes at the TX tail. Returns 0 and fills @span,
+ * or -1 with errno = EAGAIN if the ring does not have @len bytes free
+ * (EMSGSIZE if it never could). Nothing is visible to the NIC until
+ * accnet_tx_commit().
+ */
+static inline int accnet_tx_reserve(struct accnet_info *accnet, uint32_t len,
+                                    struct accnet_span *span)
+{
+    struct ring_info *ring = &accnet->ring;
+
+    if (len >= ring->tx_size) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    if (accnet_tx_space(accnet, len) < len) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    _accnet_span_init(span, (uint8_t *)accnet->iocache->udp_tx_buffer, ring->tx_size, ring->tx_tail, len);
+    return 0;
+}
+
+/* Publish the first @len bytes of a reserved @span to the NIC */
+static inline void accnet_tx_commit(struct accnet_info *accnet,
+                                    const struct accnet_span *span, uint32_t len)
+{
+    struct ring_info *ring = &accnet->ring;
+
+    ring->tx_tail = (span->pos + len) % ring->tx_size;
+
+    /* Payload stores must land before the tail doorbell */
+    mmio_wmb();
+    accnet_set_tx_tail(accnet, ring->tx_tail);
+}
+
+/*
+ * Map everything the NIC has written to the RX ring into @span.
+ * Returns the number of readable bytes (0 if the ring is empty).
+ * RX_TAIL is always re-read: a caller holding a partial record must see
+ * the bytes that complete it.
+ */
+static inline uint32_t accnet_rx_peek(struct accnet_info *accnet, struct accnet_span *span)
+{
+    struct ring_info *ring = &accnet->ring;
+    uint32_t used;
+
+    ring->rx_tail = accnet_get_rx_tail(accnet);
+    mmio_rmb();
+    used = _accnet_ring_used(ring->rx_head, ring->rx_tail, ring->rx_size);
+
+    _accnet_span_init(span, (uint8_t *)accnet->iocache->udp_rx_buffer, ring->rx_size, ring->rx_head, used);
+    return used;
+}
+
+/* Hand the first @len bytes of a peeked @span back to the NIC */
+static inline void accnet_rx_release(struct accnet_info *accnet,
+                                     const struct accnet_span *span, uint32_t len)
+{
+    struct ring_info *ring = &accnet->ring;
+
+    ring->rx_head = (span->pos + len) % ring->rx_size;
+
+    /* Finish reading the payload before the NIC may overwrite it */
+    mmio_rmb();
+    accnet_set_rx_head(accnet, ring->rx_head);
+}
+
+#ifndef __cplusplus  /* C11 atomics; not exposed to C++ users */
+/* ===================================================================== */
+/* ======================  Multi-producer TX  ========================== */
+/* ===================================================================== */
+/*
+ * Lets several threads share one row's TX ring. Producers claim space in
+ * a 64-bit byte stream with a CAS on @reserved, fill their slices in
+ * parallel, then publish strictly in claim order through @committed. A
+ * producer only rings the TX_TAIL doorbell when nobody has claimed space
+ * after it. Otherwise the later producer's doorbell also covers its bytes.
+ *
+ * While a row is in multi-producer mode, do not use the single-producer
+ * calls (accnet_tx_reserve/commit, accnet_send) on it. A producer that
+ * stalls between reserve and commit holds up everyone claimed after it.
+ */
+struct accnet_mp_tx {
+    struct accnet_info *accnet;
+    uint32_t size;
+
+    _Atomic uint64_t reserved;      /* end of the last claimed slice */
+    _Atomic uint64_t committed;     /* end of the last published slice */
+    _Atomic uint64_t head;          /* last-seen TX_HEAD, as a stream offset */
+
+    atomic_flag doorbell_lock;      /* keeps TX_TAIL writes monotonic */
+    uint64_t    rung;               /* stream offset last written to TX_TAIL, under doorbell_lock */
+};
+
+/* One producer's claim; commit it exactly once */
+struct accnet_mp_slot {
+    struct accnet_span span;
+    uint64_t start;
+};
+
+int  accnet_mp_tx_init(struct accnet_mp_tx *mp, struct accnet_info *accnet);
+int  accnet_mp_tx_reserve(struct accnet_mp_tx *mp, uint32_t len, struct accnet_mp_slot *slot);
+void accnet_mp_tx_commit(struct accnet_mp_tx *mp, const struct accnet_mp_slot *slot);
+size_t accnet_mp_send(struct accnet_mp_tx *mp, const void *buffer, size_t len);
+#endif /* !__cplusplus */
+
+#ifdef __cplusplus
 }
+#endif
 
 #endif /* ACCNET_LIB_H */
\ No newline at end of file
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "accnet_loadgen.h"
+
+#define TICKS_PER_SEC   (CPU_FREQ_MHZ * 1e6)
+
+/*
+ * One in-flight request. The sender publishes the times, then the tag
+ * (seq << 1 | 1), all before the request is committed to the TX ring, so a
+ * reply can never beat its slot. The receiver claims a slot by swapping
+ * the tag back to 0. If the sender has since reused the slot, the claim
+ * fails and the reply counts as unmatched.
+ */
+struct lg_slot {
+    _Atomic uint64_t tag;
+    uint64_t due;
+    uint64_t sent;
+};
+
+struct lg_shared {
+    const struct accnet_loadgen_cfg *cfg;
+    struct accnet_loadgen_result *res;
+    struct lg_slot *slots;
+
+    _Atomic uint64_t sent;
+    _Atomic bool     tx_done;
+    uint64_t         deadline;     /* device ticks; valid once tx_done */
+};
+
+static inline bool lg_stopped(const struct accnet_loadgen_cfg *cfg)
+{
+    return cfg->stop && *cfg->stop;
+}
+
+/* xorshift64*: cheap and reproducible across runs with the same seed */
+static inline uint64_t lg_rand(uint64_t *s)
+{
+    uint64_t x = *s;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Next inter-arrival gap in (fractional) device ticks */
+static inline double lg_gap(const struct accnet_loadgen_cfg *cfg, uint64_t *s, double mean)
+{
+    double u;
+
+    if (cfg->arrival == ACCNET_ARRIVAL_FIXED)
+        return mean;
+
+    u = (double)((lg_rand(s) >> 11) + 1) * 0x1.0p-53;   /* (0, 1] */
+    return -log(u) * mean;
+}
+
+static void lg_match(struct lg_shared *sh, const struct accnet_frame_hdr *hdr, uint64_t now)
+{
+    struct accnet_loadgen_result *res = sh->res;
+    struct lg_slot *slot = &sh->slots[hdr->seq & (ACCNET_LOADGEN_WINDOW - 1)];
+    uint64_t tag = ((uint64_t)hdr->seq << 1) | 1;
+    uint64_t due, sent;
+
+    if (!(hdr->flags & ACCNET_FRAME_F_REPLY) || atomic_load(&slot->tag) != tag) {
+        res->unmatched++;
+        return;
+    }
+
+    due  = slot->due;
+    sent = slot->sent;
+    if (!atomic_compare_exchange_strong(&slot->tag, &tag, 0)) {
+        res->unmatched++;
+        return;
+    }
+
+    hdr_hist_record(&res->service,   now > sent ? now - sent : 0);
+    hdr_hist_record(&res->corrected, now > due  ? now - due  : 0);
+    res->received++;
+}
+
+static void *lg_rx_fn(void *arg)
+{
+    struct lg_shared *sh = arg;
+    const struct accnet_loadgen_cfg *cfg = sh->cfg;
+    struct accnet_info *accnet = cfg->accnet;
+    struct accnet_frame_iter it;
+    struct accnet_frame frame;
+    int r;
+
+    if (cfg->rx_cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cfg->rx_cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "loadgen: cannot pin receiver to cpu %d\n", cfg->rx_cpu);
+    }
+
+    while (!lg_stopped(cfg)) {
+        if (atomic_load(&sh->tx_done) &&
+            (sh->res->received >= atomic_load(&sh->sent) || accnet_get_time(accnet) >= sh->deadline))
+            break;
+
+        accnet_frame_iter_init(accnet, &it);
+        if (accnet_span_len(&it.span) == 0)
+            continue;
+
+        /*
+         * One clock read per walk. The ring is polled continuously, so this
+         * overstates a reply's latency by at most one walk.
+         */
+        uint64_t now = accnet_get_time(accnet);
+
+        while ((r = accnet_frame_next(&it, &frame)) != 0) {
+            if (r < 0) {
+                sh->res->resyncs++;
+                continue;
+            }
+            lg_match(sh, &frame.hdr, now);
+        }
+        accnet_frame_iter_done(&it);
+    }
+    return NULL;
+}
+
+int accnet_loadgen_run(const struct accnet_loadgen_cfg *cfg, struct accnet_loadgen_result *res)
+{
+    struct accnet_info *accnet = cfg->accnet;
+    struct lg_shared sh;
+    struct accnet_frame_hdr hdr;
+    struct accnet_span span;
+    pthread_t rx;
+    uint32_t size = accnet_frame_size(cfg->payload_size);
+    uint64_t prng = cfg->seed ? cfg->seed : 0x9E3779B97F4A7C15ULL;
+    uint64_t start, last = 0;
+    double mean, due;
+    int err, ret;
+
+    if (cfg->rate_pps <= 0.0 || size >= accnet->ring.tx_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(res, 0, sizeof(*res));
+    hdr_hist_init(&res->service);
+    hdr_hist_init(&res->corrected);
+    res->offered_pps = cfg->rate_pps;
+
+    memset(&sh, 0, sizeof(sh));
+    sh.cfg   = cfg;
+    sh.res   = res;
+    sh.slots = calloc(ACCNET_LOADGEN_WINDOW, sizeof(*sh.slots));
+    if (!sh.slots) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    err = pthread_create(&rx, NULL, lg_rx_fn, &sh);
+    if (err) {
+        free(sh.slots);
+        errno = err;
+        return -1;
+    }
+
+    mean  = TICKS_PER_SEC / cfg->rate_pps;
+    start = accnet_get_time(accnet);
+    due   = (double)start;
+
+    for (uint64_t i = 0; i < cfg->count && !lg_stopped(cfg); i++) {
+        uint32_t seq = cfg->first_seq + (uint32_t)i;
+        struct lg_slot *slot = &sh.slots[seq & (ACCNET_LOADGEN_WINDOW - 1)];
+        uint64_t due_tick = (uint64_t)due;
+        uint64_t now;
+
+        while ((now = accnet_get_time(accnet)) < due_tick) {
+            if (lg_stopped(cfg))
+                break;
+        }
+
+        if (lg_stopped(cfg))
+            break;
+
+        /* Late sends stay on the original schedule; the corrected histogram sees the lag */
+        if (accnet_tx_reserve(accnet, size, &span) != 0) {
+            res->tx_stalls++;
+            while ((ret = accnet_tx_reserve(accnet, size, &span)) != 0 && !lg_stopped(cfg))
+                ;
+            if (ret != 0)
+                break;
+        }
+
+        now = accnet_get_time(accnet);
+        atomic_store(&slot->tag, 0);
+        slot->due  = due_tick;
+        slot->sent = now;
+        atomic_store(&slot->tag, ((uint64_t)seq << 1) | 1);
+
+        accnet_frame_hdr_init(&hdr, cfg->conn, seq, cfg->payload_size, 0);
+        hdr.tx_timestamp = now;
+        accnet_frame_write(&span, 0, &hdr, cfg->payload);
+        accnet_tx_commit(accnet, &span, size);
+        atomic_fetch_add(&sh.sent, 1);
+
+        if (now - due_tick > res->max_lag_ticks)
+            res->max_lag_ticks = now - due_tick;
+        last = now;
+        due += lg_gap(cfg, &prng, mean);
+    }
+
+    sh.deadline = accnet_get_time(accnet) + (uint64_t)(cfg->drain_us * (double)CPU_FREQ_MHZ);
+    atomic_store(&sh.tx_done, true);
+    pthread_join(rx, NULL);
+    free(sh.slots);
+
+    res->sent = atomic_load(&sh.sent);
+    res->duration_ticks = last > start ? last - start : 0;
+    if (res->duration_ticks) {
+        double secs = res->duration_ticks / TICKS_PER_SEC;
+
+        res->sent_pps = res->sent / secs;
+        res->recv_pps = res->received / secs;
+    }
+    return 0;
+}
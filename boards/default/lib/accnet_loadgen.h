@@ -0,0 +1,87 @@
+#ifndef __ACCNET_LOADGEN_H
+#define __ACCNET_LOADGEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+
+#include "accnet_lib.h"
+#include "accnet_frame.h"
+#include "hdr_hist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Open-loop load generator over one framed row.
+ *
+ * The caller's thread sends framed requests on a fixed schedule: Poisson
+ * or constant inter-arrival at cfg->rate_pps. It does not wait for
+ * replies. A second thread owns the RX ring. It matches each reply
+ * (ACCNET_FRAME_F_REPLY, same seq) to its request and records two
+ * latencies in device ticks:
+ *
+ *   service   - reply seen minus when the request actually left
+ *   corrected - reply seen minus when the request was due to leave
+ *
+ * If the sender falls behind (full TX ring, slow server), requests go out
+ * late. The service latency hides that delay; the corrected latency charges
+ * it to the requests that waited. This is coordinated-omission correction
+ * for an open-loop schedule. Report the corrected numbers against offered
+ * load.
+ *
+ * The peer must echo framed records (udp_exp --mode server --framed).
+ */
+enum accnet_arrival {
+    ACCNET_ARRIVAL_FIXED = 0,
+    ACCNET_ARRIVAL_POISSON,
+};
+
+/* In-flight requests tracked for matching; a reply older than this counts as lost */
+#define ACCNET_LOADGEN_WINDOW   (1U << 16)
+
+struct accnet_loadgen_cfg {
+    struct accnet_info *accnet;
+    const struct connection_info *conn;
+    const uint8_t *payload;
+    uint16_t payload_size;
+
+    double   rate_pps;              /* offered load */
+    enum accnet_arrival arrival;
+    uint64_t count;                 /* requests to send */
+    uint32_t first_seq;             /* keep runs apart when sweeping on one row */
+    uint64_t seed;                  /* inter-arrival PRNG; 0 picks a fixed default */
+    uint32_t drain_us;              /* wait for stragglers after the last send */
+    int      rx_cpu;                /* pin the receive thread; -1 leaves it alone */
+
+    volatile sig_atomic_t *stop;    /* optional; polled by both threads */
+};
+
+struct accnet_loadgen_result {
+    double   offered_pps;
+    double   sent_pps;              /* requests / send window */
+    double   recv_pps;              /* replies / send window */
+    uint64_t sent, received;
+    uint64_t unmatched;             /* replies with no outstanding request (late, dup, stale) */
+    uint64_t resyncs;
+    uint64_t tx_stalls;             /* sends that found the TX ring full */
+    uint64_t max_lag_ticks;         /* worst send - due */
+    uint64_t duration_ticks;        /* first due time to last send */
+
+    struct hdr_hist service;
+    struct hdr_hist corrected;
+};
+
+/*
+ * Run one load step. Blocks until every reply is in, or drain_us has
+ * passed since the last send. @res is fully overwritten; it is ~120 KB, so
+ * allocate it on the heap. Returns 0, or -1 with errno set.
+ */
+int accnet_loadgen_run(const struct accnet_loadgen_cfg *cfg, struct accnet_loadgen_result *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCNET_LOADGEN_H */
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "accnet_reactor.h"
+
+#define ACCNET_REACTOR_POLL_SPINS   64
+
+void accnet_reactor_init(struct accnet_reactor *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->poll_spins = ACCNET_REACTOR_POLL_SPINS;
+}
+
+int accnet_reactor_add(struct accnet_reactor *r, struct accnet_info *accnet,
+                       accnet_rx_handler_t fn, void *arg)
+{
+    int row = accnet->iocache->row;
+
+    if (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT || !fn) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (r->mask & (1ULL << row)) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    r->entry[row] = (struct accnet_reactor_entry) {
+        .accnet = accnet,
+        .fn     = fn,
+        .arg    = arg,
+    };
+    r->mask |= 1ULL << row;
+    if (!r->waiter)
+        r->waiter = accnet->iocache;
+    return 0;
+}
+
+int accnet_reactor_del(struct accnet_reactor *r, struct accnet_info *accnet)
+{
+    int row = accnet->iocache->row;
+
+    if (row < 0 || row >= IOCACHE_CACHE_ENTRY_COUNT || !(r->mask & (1ULL << row))) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    r->mask &= ~(1ULL << row);
+    memset(&r->entry[row], 0, sizeof(r->entry[row]));
+
+    /* The wait ioctl goes through any remaining row's fd */
+    if (r->waiter == accnet->iocache)
+        r->waiter = r->mask ? r->entry[__builtin_ctzll(r->mask)].accnet->iocache : NULL;
+    return 0;
+}
+
+/* Rows with readable bytes, from the shadow state (MMIO only when a shadow looks empty) */
+static uint64_t _accnet_reactor_poll(struct accnet_reactor *r)
+{
+    uint64_t ready = 0, m = r->mask;
+
+    while (m) {
+        int row = __builtin_ctzll(m);
+
+        m &= m - 1;
+        /* A stalled row is only ready once something beyond what it refused arrived */
+        if (accnet_rx_avail(r->entry[row].accnet, r->entry[row].stalled + 1) > r->entry[row].stalled)
+            ready |= 1ULL << row;
+    }
+    return ready;
+}
+
+static int _accnet_reactor_dispatch(struct accnet_reactor *r, uint64_t ready)
+{
+    int n = 0;
+
+    while (ready) {
+        int row = __builtin_ctzll(ready);
+        struct accnet_reactor_entry *e = &r->entry[row];
+        struct accnet_span span;
+        uint32_t len, used;
+
+        ready &= ready - 1;
+
+        /* The driver's mask says "not empty"; the handler already refused this much */
+        len = accnet_rx_peek(e->accnet, &span);
+        if (len <= e->stalled)
+            continue;
+
+        used = e->fn(e->accnet, &span, e->arg);
+        if (used > len)
+            used = len;
+        if (used)
+            accnet_rx_release(e->accnet, &span, used);
+        e->stalled = used ? 0 : len;
+
+        e->calls++;
+        e->bytes += used;
+        n++;
+    }
+
+    r->dispatches += n;
+    return n;
+}
+
+int accnet_reactor_run_once(struct accnet_reactor *r)
+{
+    uint64_t ready;
+
+    if (!r->mask) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i <= r->poll_spins; i++) {
+        ready = _accnet_reactor_poll(r);
+        if (ready)
+            return _accnet_reactor_dispatch(r, ready);
+    }
+
+    ready = r->mask;
+    r->sleeps++;
+    if (iocache_wait_on_rx_mask(r->waiter, &ready, r->timeout_us) != 0) {
+        if (errno == ETIMEDOUT || errno == EINTR) {
+            r->timeouts++;
+            return 0;
+        }
+        return -1;
+    }
+
+    /* The driver reports RX_AVAILABLE; the shadows catch up in rx_peek */
+    return _accnet_reactor_dispatch(r, ready);
+}
+
+int accnet_reactor_run(struct accnet_reactor *r)
+{
+    while (!r->stop) {
+        if (accnet_reactor_run_once(r) < 0)
+            return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef __ACCNET_REACTOR_H
+#define __ACCNET_REACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "accnet_lib.h"
+#include "iocache_lib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Run-to-completion RX loop over the rows owned by one thread.
+ *
+ * Each row registers a handler. accnet_reactor_run_once() finds the rows
+ * with RX data, polling the shadow ring state first and then sleeping in
+ * the driver on all rows at once (IOCACHE_IOCTL_WAIT_READY_MASK). It hands
+ * each ready row's readable bytes to its handler as one span, and releases
+ * however many bytes the handler consumed. RX_HEAD is written once per row
+ * per dispatch.
+ *
+ * Every row must be reserved (iocache_open) and polled by the same thread,
+ * because the RX interrupt wakes the row's owner.
+ */
+
+/*
+ * Consume a prefix of @rx. Return the number of bytes to hand back to the
+ * NIC; bytes left over are presented again on the next dispatch (e.g. a
+ * partial record, or a TX ring with no room for the reply). A row whose
+ * handler consumed nothing is not dispatched again until more bytes arrive,
+ * so a lone partial record sleeps in the driver instead of spinning.
+ */
+typedef uint32_t (*accnet_rx_handler_t)(struct accnet_info *accnet, const struct accnet_span *rx, void *arg);
+
+struct accnet_reactor_entry {
+    struct accnet_info  *accnet;
+    accnet_rx_handler_t  fn;
+    void                *arg;
+    uint32_t             stalled;   /* bytes left untouched by the last call; 0: none */
+    uint64_t             calls;
+    uint64_t             bytes;
+};
+
+struct accnet_reactor {
+    struct accnet_reactor_entry entry[IOCACHE_CACHE_ENTRY_COUNT];  /* indexed by row */
+    uint64_t mask;                  /* registered rows */
+    struct iocache_info *waiter;    /* fd used for the wait ioctl; any registered row */
+
+    uint32_t poll_spins;            /* empty polls before going to sleep */
+    uint32_t timeout_us;            /* per sleep; 0: the driver default (1s) */
+    volatile bool stop;
+
+    /* counters */
+    uint64_t dispatches;            /* handler calls */
+    uint64_t sleeps;                /* trips into the driver */
+    uint64_t timeouts;              /* sleeps that came back with nothing */
+};
+
+void accnet_reactor_init(struct accnet_reactor *r);
+int  accnet_reactor_add(struct accnet_reactor *r, struct accnet_info *accnet,
+                        accnet_rx_handler_t fn, void *arg);
+int  accnet_reactor_del(struct accnet_reactor *r, struct accnet_info *accnet);
+
+/* One poll/wait/dispatch round. Returns the number of rows dispatched, or -1 on error. */
+int  accnet_reactor_run_once(struct accnet_reactor *r);
+
+/* Loop until accnet_reactor_stop(); returns 0, or -1 on error */
+int  accnet_reactor_run(struct accnet_reactor *r);
+
+static inline void accnet_reactor_stop(struct accnet_reactor *r)
+{
+    r->stop = true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCNET_REACTOR_H */
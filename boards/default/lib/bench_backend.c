@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+#include "accnet_lib.h"
+#include "iocache_lib.h"
+#include "bench_backend.h"
+
+/* ===================================================================== */
+/* ========================  Kernel UDP socket  ======================== */
+/* ===================================================================== */
+
+struct kernel_priv {
+    int sock;
+    uint8_t buf[BENCH_MAX_PAYLOAD];
+};
+
+static inline uint64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int kernel_open(struct bench_backend *b, const struct bench_opts *o)
+{
+    struct kernel_priv *p = calloc(1, sizeof(*p));
+    struct sockaddr_in dst;
+    struct timeval tv = {
+        .tv_sec  = o->timeout_ms / 1000,
+        .tv_usec = (o->timeout_ms % 1000) * 1000,
+    };
+
+    if (!p)
+        return -1;
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port   = htons(o->kernel_port);
+    if (inet_pton(AF_INET, o->kernel_ip, &dst.sin_addr) != 1) {
+        fprintf(stderr, "kernel: bad server address %s\n", o->kernel_ip);
+        free(p);
+        return -1;
+    }
+
+    p->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (p->sock < 0) {
+        perror("socket");
+        free(p);
+        return -1;
+    }
+
+    /* connect() filters replies to the server's address, as the old client checked by hand */
+    if (setsockopt(p->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+        connect(p->sock, (struct sockaddr *)&dst, sizeof(dst)) != 0) {
+        perror("kernel socket setup");
+        close(p->sock);
+        free(p);
+        return -1;
+    }
+
+    b->priv = p;
+    return 0;
+}
+
+static int kernel_rtt(struct bench_backend *b, const uint8_t *payload, uint32_t len, uint64_t *rtt_ns)
+{
+    struct kernel_priv *p = b->priv;
+    uint64_t t0, t1;
+    ssize_t n;
+
+    /* Drop replies that came back after an earlier timeout */
+    while (recv(p->sock, p->buf, sizeof(p->buf), MSG_DONTWAIT) > 0)
+        ;
+
+    t0 = mono_ns();
+    if (send(p->sock, payload, len, 0) != (ssize_t)len)
+        return -1;
+    n = recv(p->sock, p->buf, sizeof(p->buf), 0);
+    t1 = mono_ns();
+
+    if (n != (ssize_t)len)
+        return -1;
+
+    *rtt_ns = t1 - t0;
+    return 0;
+}
+
+static void kernel_close(struct bench_backend *b)
+{
+    struct kernel_priv *p = b->priv;
+
+    if (!p)
+        return;
+    close(p->sock);
+    free(p);
+    b->priv = NULL;
+}
+
+const struct bench_backend_ops bench_backend_kernel = {
+    .name  = "kernel",
+    .clock = "CLOCK_MONOTONIC",
+    .open  = kernel_open,
+    .rtt   = kernel_rtt,
+    .close = kernel_close,
+};
+
+/* ===================================================================== */
+/* =======================  iocache/accnet bypass  ===================== */
+/* ===================================================================== */
+
+struct bypass_priv {
+    struct iocache_info iocache;
+    struct accnet_info  accnet;
+    bool     blocking;
+    uint64_t timeout_ticks;
+};
+
+static int bypass_open(struct bench_backend *b, const struct bench_opts *o)
+{
+    struct bypass_priv *p = calloc(1, sizeof(*p));
+    struct connection_info conn;
+
+    if (!p)
+        return -1;
+
+    if (conn_from_strings_mac(&conn, 0x11, o->src_mac, o->src_ip, o->src_port,
+                              o->dst_mac, o->dst_ip, o->dst_port) != 0) {
+        fprintf(stderr, "bypass: bad connection arguments\n");
+        free(p);
+        return -1;
+    }
+    if (iocache_open(o->iocache_filename, &p->iocache, o->ring) < 0) {
+        fprintf(stderr, "bypass: iocache_open failed\n");
+        free(p);
+        return -1;
+    }
+    if (accnet_open(o->accnet_filename, &p->accnet, &p->iocache, true) < 0) {
+        fprintf(stderr, "bypass: accnet_open failed\n");
+        iocache_close(&p->iocache);
+        free(p);
+        return -1;
+    }
+
+    accnet_setup_connection(&p->accnet, &conn);
+    iocache_setup_connection(&p->iocache, &conn);
+
+    p->blocking      = o->blocking;
+    p->timeout_ticks = (uint64_t)o->timeout_ms * 1000 * CPU_FREQ_MHZ;
+    b->priv = p;
+    return 0;
+}
+
+static int bypass_rtt(struct bench_backend *b, const uint8_t *payload, uint32_t len, uint64_t *rtt_ns)
+{
+    struct bypass_priv *p = b->priv;
+    struct accnet_info *accnet = &p->accnet;
+    struct accnet_span tx, rx;
+    uint64_t before, after;
+
+    /* Drop replies that came back after an earlier timeout */
+    if (accnet_rx_peek(accnet, &rx))
+        accnet_rx_release(accnet, &rx, accnet_span_len(&rx));
+
+    if (accnet_tx_reserve(accnet, len, &tx) != 0)
+        return -1;
+    accnet_span_write(&tx, 0, payload, len);
+
+    before = accnet_get_time(accnet);
+    mmio_rmb();
+    accnet_tx_commit(accnet, &tx, len);
+
+    while (accnet_rx_avail(accnet, len) < len) {
+        if (p->blocking) {
+            /* The driver gives up after its own 1s timeout */
+            if (iocache_wait_on_rx(&p->iocache) != 0)
+                return -1;
+        } else if (accnet_get_time(accnet) - before > p->timeout_ticks) {
+            return -1;
+        }
+    }
+
+    after = accnet_get_time(accnet);
+    mmio_rmb();
+
+    accnet_rx_peek(accnet, &rx);
+    accnet_rx_release(accnet, &rx, len);
+
+    *rtt_ns = (uint64_t)((after - before) * NS_PER_TICK);
+    return 0;
+}
+
+static void bypass_close(struct bench_backend *b)
+{
+    struct bypass_priv *p = b->priv;
+
+    if (!p)
+        return;
+    iocache_clear_connection(&p->iocache);
+    accnet_close(&p->accnet);
+    iocache_close(&p->iocache);
+    free(p);
+    b->priv = NULL;
+}
+
+const struct bench_backend_ops bench_backend_bypass = {
+    .name  = "bypass",
+    .clock = "ACCNET_CTRL_TIMESTAMP",
+    .open  = bypass_open,
+    .rtt   = bypass_rtt,
+    .close = bypass_close,
+};
+
+const struct bench_backend_ops *bench_backend_find(const char *name)
+{
+    if (strcmp(name, bench_backend_kernel.name) == 0)
+        return &bench_backend_kernel;
+    if (strcmp(name, bench_backend_bypass.name) == 0)
+        return &bench_backend_bypass;
+    return NULL;
+}
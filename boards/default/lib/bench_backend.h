@@ -0,0 +1,65 @@
+#ifndef __BENCH_BACKEND_H
+#define __BENCH_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * One request/response transport for net_bench.
+ *
+ * Each backend hides its own clock. rtt() always reports nanoseconds:
+ * kernel sockets time with CLOCK_MONOTONIC, the bypass path with
+ * ACCNET_CTRL_TIMESTAMP ticks * NS_PER_TICK. Histograms and reports from
+ * either side are directly comparable. Payload limits are the same on both
+ * (one unframed UDP datagram, BENCH_MAX_PAYLOAD), so a sweep means the
+ * same thing on each path.
+ */
+#define BENCH_MAX_PAYLOAD   1472    /* UDP payload in one 1500 B MTU frame */
+
+struct bench_opts {
+    /* kernel socket path: peer is udp_server_kernel */
+    const char *kernel_ip;
+    uint16_t    kernel_port;
+    uint32_t    timeout_ms;
+
+    /* bypass path: peer is udp_exp --mode server */
+    const char *accnet_filename;
+    const char *iocache_filename;
+    const char *src_mac, *src_ip, *dst_mac, *dst_ip;
+    uint16_t    src_port, dst_port;
+    int         ring;
+    bool        blocking;           /* sleep on the RX interrupt instead of polling */
+};
+
+struct bench_backend;
+
+struct bench_backend_ops {
+    const char *name;
+    const char *clock;              /* what rtt() is measured with, for the report */
+
+    int  (*open)(struct bench_backend *b, const struct bench_opts *o);
+    /* One round trip of @len bytes. Returns 0 and sets @rtt_ns, or -1 if no full reply came back */
+    int  (*rtt)(struct bench_backend *b, const uint8_t *payload, uint32_t len, uint64_t *rtt_ns);
+    void (*close)(struct bench_backend *b);
+};
+
+struct bench_backend {
+    const struct bench_backend_ops *ops;
+    void *priv;
+};
+
+extern const struct bench_backend_ops bench_backend_kernel;
+extern const struct bench_backend_ops bench_backend_bypass;
+
+/* Look up by name ("kernel" or "bypass"); NULL if unknown */
+const struct bench_backend_ops *bench_backend_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BENCH_BACKEND_H */
@@ -5,7 +5,13 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#ifdef __cplusplus
+#include <atomic>
+#include <cerrno>
+#else
 #include <stdatomic.h>
+#include <errno.h>
+#endif
 
 #ifndef CLOCK_MONOTONIC
 #define CLOCK_MONOTONIC 1
@@ -28,8 +34,42 @@
 #define reg_write8(base, reg, val) (((volatile uint8_t *)(base))[(reg)/1]) = val
 
 /* Optional: ordering helpers for userspace when pairing RAM writes with MMIO */
+#ifdef __cplusplus
+static inline void mmio_wmb(void) { std::atomic_thread_fence(std::memory_order_release); }
+static inline void mmio_rmb(void) { std::atomic_thread_fence(std::memory_order_acquire); }
+#else
 static inline void mmio_wmb(void) { atomic_thread_fence(memory_order_release); }
 static inline void mmio_rmb(void) { atomic_thread_fence(memory_order_acquire); }
+#endif
+
+/*
+ * Core cycle and retired-instruction counters, readable from userspace on
+ * the target. Other hosts get the TSC and no instruction count, so code
+ * using them still builds and runs off-target.
+ */
+static inline uint64_t rdcycle(void)
+{
+#if defined(__riscv)
+    uint64_t x;
+    __asm__ volatile ("rdcycle %0" : "=r"(x));
+    return x;
+#elif defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t rdinstret(void)
+{
+#if defined(__riscv)
+    uint64_t x;
+    __asm__ volatile ("rdinstret %0" : "=r"(x));
+    return x;
+#else
+    return 0;
+#endif
+}
 
 #define MAP_INDEX(idx) (((uint64_t) idx) << 40)
 
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "hdr_hist.h"
+
+#define HDR_HIST_MAGIC  "# hdr_hist v1"
+
+/*
+ * Bucket b >= 1 covers [2^(b+S-1), 2^(b+S)) in steps of 2^b; bucket 0 is
+ * [0, 2^S) in steps of 1. Only the upper half of each bucket's sub-range
+ * is used above bucket 0, which keeps the index contiguous.
+ */
+static inline uint32_t _hdr_index(uint64_t v)
+{
+    uint32_t b;
+
+    if (v < HDR_HIST_SUB_COUNT)
+        return (uint32_t)v;
+
+    b = (63 - __builtin_clzll(v)) - (HDR_HIST_SUB_BITS - 1);
+    return b * HDR_HIST_HALF_COUNT + (uint32_t)(v >> b);
+}
+
+/* Largest value that lands in bucket @idx */
+static inline uint64_t _hdr_highest(uint32_t idx)
+{
+    uint32_t b;
+    uint64_t sub;
+
+    if (idx < HDR_HIST_SUB_COUNT)
+        return idx;
+
+    b   = (idx >> (HDR_HIST_SUB_BITS - 1)) - 1;
+    sub = idx - b * HDR_HIST_HALF_COUNT;
+    return (sub << b) + ((1ULL << b) - 1);
+}
+
+void hdr_hist_init(struct hdr_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hdr_hist_record_n(struct hdr_hist *h, uint64_t value, uint64_t n)
+{
+    if (!n)
+        return;
+
+    h->counts[_hdr_index(value)] += n;
+
+    if (h->total == 0 || value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+    h->total += n;
+
+    if ((value && n > UINT64_MAX / value) || h->sum > UINT64_MAX - value * n)
+        h->sum = UINT64_MAX;
+    else
+        h->sum += value * n;
+}
+
+void hdr_hist_record_corrected(struct hdr_hist *h, uint64_t value, uint64_t interval)
+{
+    hdr_hist_record(h, value);
+
+    if (interval == 0 || value <= interval)
+        return;
+
+    for (uint64_t missing = value - interval; missing >= interval; missing -= interval)
+        hdr_hist_record(h, missing);
+}
+
+void hdr_hist_merge(struct hdr_hist *dst, const struct hdr_hist *src)
+{
+    if (src->total == 0)
+        return;
+
+    for (uint32_t i = 0; i < HDR_HIST_COUNTS; i++)
+        dst->counts[i] += src->counts[i];
+
+    if (dst->total == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    dst->total += src->total;
+    dst->sum = (dst->sum + src->sum < dst->sum) ? UINT64_MAX : dst->sum + src->sum;
+}
+
+uint64_t hdr_hist_percentile(const struct hdr_hist *h, double pct)
+{
+    uint64_t want, seen = 0;
+
+    if (h->total == 0)
+        return 0;
+    if (pct <= 0.0)
+        return h->min;
+    if (pct >= 100.0)
+        return h->max;
+
+    want = (uint64_t)((pct / 100.0) * (double)h->total + 0.5);
+    if (want == 0)
+        want = 1;
+
+    for (uint32_t i = 0; i < HDR_HIST_COUNTS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = _hdr_highest(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+double hdr_hist_mean(const struct hdr_hist *h)
+{
+    return h->total ? (double)h->sum / (double)h->total : 0.0;
+}
+
+void hdr_hist_print(FILE *out, const struct hdr_hist *h, const char *label, double scale, const char *unit)
+{
+    fprintf(out, "%s: n=%" PRIu64 " min=%.2f mean=%.2f p50=%.2f p90=%.2f p99=%.2f "
+            "p99.9=%.2f p99.99=%.2f max=%.2f %s\n",
+            label, h->total,
+            h->min * scale, hdr_hist_mean(h) * scale,
+            hdr_hist_percentile(h, 50.0) * scale,
+            hdr_hist_percentile(h, 90.0) * scale,
+            hdr_hist_percentile(h, 99.0) * scale,
+            hdr_hist_percentile(h, 99.9) * scale,
+            hdr_hist_percentile(h, 99.99) * scale,
+            h->max * scale, unit);
+}
+
+int hdr_hist_save(const struct hdr_hist *h, const char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if (!f)
+        return -1;
+
+    fprintf(f, HDR_HIST_MAGIC " sub_bits=%d\n", HDR_HIST_SUB_BITS);
+    fprintf(f, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", h->total, h->min, h->max, h->sum);
+    for (uint32_t i = 0; i < HDR_HIST_COUNTS; i++) {
+        if (h->counts[i])
+            fprintf(f, "%u %" PRIu64 "\n", i, h->counts[i]);
+    }
+
+    if (fclose(f) != 0)
+        return -1;
+    return 0;
+}
+
+int hdr_hist_load(struct hdr_hist *h, const char *path)
+{
+    char line[128];
+    int sub_bits = -1;
+    uint32_t idx;
+    uint64_t count;
+    FILE *f = fopen(path, "r");
+
+    if (!f)
+        return -1;
+
+    hdr_hist_init(h);
+
+    if (!fgets(line, sizeof(line), f) ||
+        sscanf(line, HDR_HIST_MAGIC " sub_bits=%d", &sub_bits) != 1 || sub_bits != HDR_HIST_SUB_BITS ||
+        fscanf(f, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, &h->total, &h->min, &h->max, &h->sum) != 4) {
+        fclose(f);
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (fscanf(f, "%u %" SCNu64, &idx, &count) == 2) {
+        if (idx >= HDR_HIST_COUNTS) {
+            fclose(f);
+            errno = EINVAL;
+            return -1;
+        }
+        h->counts[idx] += count;
+    }
+
+    fclose(f);
+    return 0;
+}
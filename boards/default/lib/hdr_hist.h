@@ -0,0 +1,66 @@
+#ifndef __HDR_HIST_H
+#define __HDR_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * HDR-style log-linear histogram for latency samples.
+ *
+ * Every power of two is split into HDR_HIST_SUB_COUNT / 2 linear
+ * sub-buckets, so any uint64_t value is kept with under 0.8% relative
+ * error. The histogram is a fixed ~58 KB no matter how many samples go in.
+ * Histograms merge by adding counts (across rows, threads or saved runs).
+ *
+ * Values are unitless. udp_exp records device ticks and scales on output.
+ */
+#define HDR_HIST_SUB_BITS       8
+#define HDR_HIST_SUB_COUNT      (1U << HDR_HIST_SUB_BITS)
+#define HDR_HIST_HALF_COUNT     (HDR_HIST_SUB_COUNT / 2)
+#define HDR_HIST_COUNTS         ((64 - HDR_HIST_SUB_BITS + 2) * HDR_HIST_HALF_COUNT)
+
+struct hdr_hist {
+    uint64_t total;
+    uint64_t min, max;
+    uint64_t sum;               /* saturating */
+    uint64_t counts[HDR_HIST_COUNTS];
+};
+
+void     hdr_hist_init(struct hdr_hist *h);
+void     hdr_hist_record_n(struct hdr_hist *h, uint64_t value, uint64_t n);
+
+static inline void hdr_hist_record(struct hdr_hist *h, uint64_t value)
+{
+    hdr_hist_record_n(h, value, 1);
+}
+
+/*
+ * Coordinated-omission correction: a sample that took longer than the
+ * @interval at which requests were supposed to go out also stands for the
+ * requests that should have been sent meanwhile. Those are back-filled at
+ * value - interval, value - 2*interval, ...
+ */
+void     hdr_hist_record_corrected(struct hdr_hist *h, uint64_t value, uint64_t interval);
+
+void     hdr_hist_merge(struct hdr_hist *dst, const struct hdr_hist *src);
+
+/* Smallest recorded value v such that @pct percent of samples are <= v (0 if empty) */
+uint64_t hdr_hist_percentile(const struct hdr_hist *h, double pct);
+double   hdr_hist_mean(const struct hdr_hist *h);
+
+/* One line: count, min, mean, p50/p90/p99/p99.9/p99.99, max, each value * @scale */
+void     hdr_hist_print(FILE *out, const struct hdr_hist *h, const char *label, double scale, const char *unit);
+
+/* Sparse text format; load() replaces @h, so load into a scratch histogram and merge */
+int      hdr_hist_save(const struct hdr_hist *h, const char *path);
+int      hdr_hist_load(struct hdr_hist *h, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HDR_HIST_H */
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "hdr_hist.h"
+
+/*
+ * Merge histograms saved by `udp_exp --hist-out` (one per run or per row)
+ * and print per-file and combined percentiles. Values are device ticks and
+ * are printed in microseconds unless --scale says otherwise.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--scale UNITS_PER_VALUE] [--unit NAME] [--out FILE] [--quiet] FILE...\n"
+                    "Defaults: --scale %.3f (device ticks -> us), --unit us\n", prog, US_PER_TICK);
+}
+
+int main(int argc, char **argv)
+{
+    const char *prog = argv[0];
+    double scale = US_PER_TICK;
+    const char *unit = "us";
+    const char *out = NULL;
+    int quiet = 0, nfiles = 0;
+    struct hdr_hist *merged = malloc(sizeof(*merged));
+    struct hdr_hist *one = malloc(sizeof(*one));
+
+    if (!merged || !one) {
+        perror("malloc");
+        return 1;
+    }
+    hdr_hist_init(merged);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--unit") == 0 && i + 1 < argc) {
+            unit = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        }
+        else if (argv[i][0] == '-') {
+            usage(prog);
+            return 1;
+        }
+        else {
+            argv[nfiles++] = argv[i];   /* files are read once all options are known */
+        }
+    }
+
+    for (int i = 0; i < nfiles; i++) {
+        if (hdr_hist_load(one, argv[i]) != 0) {
+            perror(argv[i]);
+            return 1;
+        }
+        if (!quiet)
+            hdr_hist_print(stdout, one, argv[i], scale, unit);
+        hdr_hist_merge(merged, one);
+    }
+
+    if (nfiles == 0) {
+        usage(prog);
+        return 1;
+    }
+
+    hdr_hist_print(stdout, merged, "merged", scale, unit);
+
+    if (out && hdr_hist_save(merged, out) != 0) {
+        perror(out);
+        return 1;
+    }
+
+    free(one);
+    free(merged);
+    return 0;
+}
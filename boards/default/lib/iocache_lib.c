@@ -69,12 +69,22 @@ static int _iocache_ioctl(int fd, int index, off_t *offset, size_t *size) {
     return 0;
 }
 
+/* The driver re-routes a row to its owner's CPU when the owner migrates,
+ * so the CPU recorded at open may be stale; PROC_CPU is where it fires now. */
+static inline int _iocache_row_cpu(struct iocache_info *iocache) {
+    return (int)reg_read32(iocache->regs, IOCACHE_REG_PROC_CPU(iocache->row));
+}
+
 static inline void _iocache_enable_interrupts_rx(struct iocache_info *iocache) {
-    reg_write8(iocache->regs, IOCACHE_REG_INTMASK_RX(iocache->cpu),     0x1);
+    reg_write8(iocache->regs, IOCACHE_REG_INTMASK_RX(_iocache_row_cpu(iocache)),     0x1);
 }
 
 static inline void _iocache_disable_interrupts_rx(struct iocache_info *iocache) {
-    reg_write8(iocache->regs, IOCACHE_REG_INTMASK_RX(iocache->cpu),     0x0);
+    reg_write8(iocache->regs, IOCACHE_REG_INTMASK_RX(_iocache_row_cpu(iocache)),     0x0);
+}
+
+static inline void _iocache_enable_interrupts_txcomp(struct iocache_info *iocache) {
+    reg_write8(iocache->regs, IOCACHE_REG_INTMASK_TXCOMP(_iocache_row_cpu(iocache)), 0x1);
 }
 
 static inline void iocache_set_rx_suspended(struct iocache_info *iocache) {
@@ -120,13 +130,55 @@ int iocache_wait_on_rx(struct iocache_info *iocache) {
     return (iocache_is_rx_available(iocache)) ? 0 : -1;
 }
 
-int iocache_wait_on_txcomp(struct iocache_info *iocache) {
-    struct epoll_event out;
-    uint64_t cnt;
+/* Wait on every row in *mask at once; they must all have been reserved by
+ * this thread, and `iocache` may be any of them. On return *mask holds the
+ * rows with RX data. A timeout returns -1 with errno = ETIMEDOUT.
+ * timeout_us = 0 uses the driver's 1s. */
+int iocache_wait_on_rx_mask(struct iocache_info *iocache, uint64_t *mask, uint32_t timeout_us) {
+    struct iocache_ioctl_wait_mask wm = {
+        .mask       = *mask,
+        .timeout_us = timeout_us,
+    };
+
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_WAIT_READY_MASK, &wm) == -1) {
+        if (errno != EINTR)
+            perror("IOCACHE_IOCTL_WAIT_READY_MASK ioctl failed");
+        *mask = 0;
+        return -1;
+    }
 
+    *mask = wm.mask;
+    if (!wm.mask) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
     return 0;
 }
 
+/* Unlike iocache_wait_on_rx this may be called from any thread; the kernel
+ * arms TXCOMP_SUSPENDED itself and tracks the waiter per row. Callers must
+ * still re-read the TX head afterwards to see how much space was freed. */
+int iocache_wait_on_txcomp(struct iocache_info *iocache) {
+    int row = iocache->row;
+
+    if (iocache_is_txcomp_available(iocache))
+        return 0;
+
+    _iocache_enable_interrupts_txcomp(iocache);
+
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_WAIT_TXCOMP, &row) == -1) {
+        /* EBUSY: another thread sharing the row is already parked on it */
+        if (errno == EBUSY)
+            sched_yield();
+        else if (errno != EINTR)
+            perror("IOCACHE_IOCTL_WAIT_TXCOMP ioctl failed");
+        return -1;
+    }
+
+    /* We have to return -1 if it was a timeout */
+    return (iocache_is_txcomp_available(iocache)) ? 0 : -1;
+}
+
 int iocache_get_last_irq_ns(struct iocache_info *iocache, __u64 *ns) {
     if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_LAST_IRQ_NS, ns) == -1) {
         perror("IOCACHE_IOCTL_GET_LAST_IRQ_NS ioctl failed");
@@ -135,7 +187,7 @@ int iocache_get_last_irq_ns(struct iocache_info *iocache, __u64 *ns) {
     return 0;
 }
 
-int iocache_get_last_ktimes(struct iocache_info *iocache, __u64 ktimes[3]) {
+int iocache_get_last_ktimes(struct iocache_info *iocache, __u64 ktimes[4]) {
     if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_KTIMES, ktimes) == -1) {
         perror("IOCACHE_IOCTL_GET_KTIMES ioctl failed");
         return -1;
@@ -143,18 +195,113 @@ int iocache_get_last_ktimes(struct iocache_info *iocache, __u64 ktimes[3]) {
     return 0;
 }
 
+int iocache_get_row_ktimes(struct iocache_info *iocache, struct iocache_ioctl_row_ktimes *kt) {
+    memset(kt, 0, sizeof(*kt));
+    kt->row = iocache->row;
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_ROW_KTIMES, kt) == -1) {
+        perror("IOCACHE_IOCTL_GET_ROW_KTIMES ioctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/* scope is IOCACHE_HIST_SCOPE_ROW or _CPU, index the row or cpu, stage IOCACHE_HIST_* */
+int iocache_get_hist(struct iocache_info *iocache, int scope, int index, int stage,
+                     bool reset, struct iocache_ioctl_hist *hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist->scope = scope;
+    hist->index = index;
+    hist->stage = stage;
+    hist->flags = reset ? IOCACHE_HIST_RESET : 0;
+
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_HIST, hist) == -1) {
+        perror("IOCACHE_IOCTL_GET_HIST ioctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/* target is IOCACHE_MMIO_*, flags IOCACHE_MMIO_RELAXED; row is only used by ROW_ENABLED */
+int iocache_mmio_bench(struct iocache_info *iocache, int target, uint32_t flags, uint32_t iters,
+                       int row, struct iocache_ioctl_mmio_bench *mb) {
+    memset(mb, 0, sizeof(*mb));
+    mb->target = target;
+    mb->flags  = flags;
+    mb->iters  = iters;
+    mb->row    = row;
+
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_MMIO_BENCH, mb) == -1) {
+        perror("IOCACHE_IOCTL_MMIO_BENCH ioctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/* Upper edge of the bucket holding the p-th fraction of samples */
+static uint64_t hist_percentile_ns(const struct iocache_ioctl_hist *hist, double p) {
+    uint64_t want = (uint64_t)(p * hist->count + 0.5), seen = 0;
+
+    if (want == 0) want = 1;
+    for (int i = 0; i < IOCACHE_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= want)
+            return (i == IOCACHE_HIST_BUCKETS - 1) ? hist->max_ns : (2ULL << i) - 1;
+    }
+    return hist->max_ns;
+}
+
+void iocache_print_hist(const struct iocache_ioctl_hist *hist, const char *label) {
+    if (hist->count == 0) {
+        printf("%s: no samples\n", label);
+        return;
+    }
+
+    printf("%s: n=%llu avg=%.2f us p50<=%.2f us p99<=%.2f us p99.9<=%.2f us max=%.2f us\n",
+           label, (unsigned long long)hist->count,
+           hist->sum_ns / (double)hist->count / 1e3,
+           hist_percentile_ns(hist, 0.50) / 1e3,
+           hist_percentile_ns(hist, 0.99) / 1e3,
+           hist_percentile_ns(hist, 0.999) / 1e3,
+           hist->max_ns / 1e3);
+
+    for (int i = 0; i < IOCACHE_HIST_BUCKETS; i++) {
+        if (hist->buckets[i])
+            printf("  [%10llu, %10llu) ns : %llu\n",
+                   i ? 1ULL << i : 0ULL, 2ULL << i, (unsigned long long)hist->buckets[i]);
+    }
+}
+
 int iocache_print_proc_util(struct iocache_info *iocache) {
-    __u64 *ns = malloc(sizeof(__u64) * 3);
+    __u64 ns[3];
 
     if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_PROC_UTIL, ns) == -1) {
         perror("IOCACHE_IOCTL_GET_PROC_UTIL ioctl failed");
         return -1;
     }
-    printf("start=%lu, end=%lu, usage=%lu\n");
+    printf("start=%llu, end=%llu, usage=%llu\n",
+           (unsigned long long)ns[0], (unsigned long long)ns[1], (unsigned long long)ns[2]);
     print_util(ns[0], ns[1], ns[2]);
     return 0;
 }
 
+/* Steer the row's interrupts at `cpu` (-1: follow this thread). With `pin` the
+ * thread is moved there as well. */
+int iocache_set_row_affinity(struct iocache_info *iocache, int cpu, bool pin) {
+    struct iocache_ioctl_row_affinity aff = {
+        .row   = iocache->row,
+        .cpu   = cpu,
+        .flags = pin ? IOCACHE_AFFINITY_PIN : 0,
+    };
+
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_SET_ROW_AFFINITY, &aff) == -1) {
+        perror("IOCACHE_IOCTL_SET_ROW_AFFINITY ioctl failed");
+        return -1;
+    }
+
+    iocache->cpu = (cpu >= 0) ? cpu : sched_getcpu();
+    return 0;
+}
+
 int iocache_start_scheduler(struct iocache_info *iocache) {
     if (ioctl(iocache->fd, IOCACHE_IOCTL_RUN_SCHEDULER) == -1) {
         perror("IOCACHE_IOCTL_RUN_SCHEDULER ioctl failed");
@@ -184,14 +331,14 @@ int _iocache_reserve_ring(struct iocache_info *iocache, int row) {
 }
 
 int _iocache_free_ring(struct iocache_info *iocache) {
-    if (ioctl(iocache->fd, IOCACHE_IOCTL_FREE_RING) == -1) {
+    if (ioctl(iocache->fd, IOCACHE_IOCTL_FREE_RING, &iocache->row) == -1) {
         perror("IOCACHE_IOCTL_FREE_RING ioctl failed");
         return -1;
     }
     return 0;
 }
 
-int iocache_open(char *file, struct iocache_info *iocache, int row) {
+int iocache_open(const char *file, struct iocache_info *iocache, int row) {
     uintptr_t p;
     iocache->udp_tx_size = 8 * 1024;
     iocache->udp_rx_size = 8 * 1024;
@@ -206,35 +353,30 @@ int iocache_open(char *file, struct iocache_info *iocache, int row) {
 
     iocache->cpu = sched_getcpu();
 
-    if (_iocache_ioctl(iocache->fd, 0, &iocache->regs_offset, &iocache->regs_size) != 0) {
-        close(iocache->fd);
-        return -1;
-    }
+    if (_iocache_ioctl(iocache->fd, 0, &iocache->regs_offset, &iocache->regs_size) != 0)
+        goto err_fd;
 
     iocache->efd = eventfd(0, EFD_NONBLOCK);
-
-    // if (ioctl(iocache->fd, IOCACHE_IOCTL_GET_AVAIL_RING, &iocache->row) == -1) {
-    //     perror("IOCACHE_IOCTL_GET_AVAIL_RING ioctl failed");
-    //     close(iocache->efd);
-    //     close(iocache->fd);
-    //     return -1;
-    // }
-    // else {
-    //     printf("IOCache got row %d\n", iocache->row);
-    // }
+    if (iocache->efd < 0) {
+        perror("eventfd");
+        goto err_fd;
+    }
 
     if (ioctl(iocache->fd, IOCACHE_IOCTL_SET_EVENTFD, &iocache->efd) == -1) {
         perror("IOCACHE_IOCTL_SET_EVENTFD ioctl failed");
-        close(iocache->efd);
-        close(iocache->fd);
-        return -1;
+        goto err_efd;
     }
 
-    // iocache->row = 20;
-    _iocache_reserve_ring(iocache, row);
-
+    /* A negative row asks the driver to pick a free one. The row is
+     * released with the fd, so later error paths need no FREE_RING. */
+    if (_iocache_reserve_ring(iocache, row < 0 ? IOCACHE_ROW_ANY : row) != 0)
+        goto err_efd;
 
     iocache->ep = epoll_create1(0);
+    if (iocache->ep < 0) {
+        perror("epoll_create1");
+        goto err_efd;
+    }
     struct epoll_event ev = {.events = EPOLLIN, .data.fd = iocache->efd};
     epoll_ctl(iocache->ep, EPOLL_CTL_ADD, iocache->efd, &ev);
 
@@ -242,17 +384,14 @@ int iocache_open(char *file, struct iocache_info *iocache, int row) {
     iocache->regs = (volatile uint8_t *)mmap(NULL, iocache->regs_size, PROT_READ | PROT_WRITE, MAP_SHARED, iocache->fd, MAP_INDEX(0));
     if (iocache->regs == MAP_FAILED) {
         perror("mmap regs failed");
-        close(iocache->efd);
-        close(iocache->fd);
-        return -1;
+        goto err_ep;
     }
 
     iocache->udp_tx_buffer = mmap(NULL, iocache->udp_tx_size + (ALIGN - 1), 
                                     PROT_READ | PROT_WRITE, MAP_SHARED, iocache->fd, MAP_INDEX(2*iocache->row + 1));
     if (iocache->udp_tx_buffer == MAP_FAILED) {
         perror("mmap udp tx");
-        close(iocache->fd);
-        return -1;
+        goto err_regs;
     }
     p = (uintptr_t)iocache->udp_tx_buffer;
     iocache->udp_tx_buffer_aligned = (void *)((p + (ALIGN - 1)) & ~(uintptr_t)(ALIGN - 1));
@@ -261,9 +400,7 @@ int iocache_open(char *file, struct iocache_info *iocache, int row) {
                                     PROT_READ | PROT_WRITE, MAP_SHARED, iocache->fd, MAP_INDEX(2*iocache->row + 2));
     if (iocache->udp_rx_buffer == MAP_FAILED) {
         perror("mmap udp rx");
-        munmap((void *)(uintptr_t) iocache->regs, iocache->regs_size);
-        close(iocache->fd);
-        return -1;
+        goto err_tx;
     }
     p = (uintptr_t)iocache->udp_rx_buffer;
     iocache->udp_rx_buffer_aligned = (void *)((p + (ALIGN - 1)) & ~(uintptr_t)(ALIGN - 1));
@@ -271,6 +408,18 @@ int iocache_open(char *file, struct iocache_info *iocache, int row) {
     _iocache_enable_interrupts_rx(iocache);
 
     return 0;
+
+err_tx:
+    munmap(iocache->udp_tx_buffer, iocache->udp_tx_size + (ALIGN - 1));
+err_regs:
+    munmap((void *)(uintptr_t) iocache->regs, iocache->regs_size);
+err_ep:
+    close(iocache->ep);
+err_efd:
+    close(iocache->efd);
+err_fd:
+    close(iocache->fd);
+    return -1;
 }
 
 int iocache_close(struct iocache_info *iocache) {
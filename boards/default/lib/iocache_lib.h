@@ -8,6 +8,11 @@
 #include <stddef.h>
 
 #include "common.h"
+#include "iocache_ioctl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define NUM_CPUS 	NR_CPUS
 
@@ -119,14 +124,23 @@ struct iocache_info {
     int ep;
 };
 
-int iocache_open(char *file, struct iocache_info *iocache, int row);
+int iocache_open(const char *file, struct iocache_info *iocache, int row);
 int iocache_close(struct iocache_info *iocache);
 int iocache_wait_on_rx(struct iocache_info *iocache);
 int iocache_wait_on_txcomp(struct iocache_info *iocache);
+int iocache_wait_on_rx_mask(struct iocache_info *iocache, uint64_t *mask, uint32_t timeout_us);
 int iocache_get_last_irq_ns(struct iocache_info *iocache, __u64 *ns);
-int iocache_get_last_ktimes(struct iocache_info *iocache, __u64 ktimes[3]);
+int iocache_get_last_ktimes(struct iocache_info *iocache, __u64 ktimes[4]);
+int iocache_get_row_ktimes(struct iocache_info *iocache, struct iocache_ioctl_row_ktimes *kt);
+int iocache_get_hist(struct iocache_info *iocache, int scope, int index, int stage,
+                     bool reset, struct iocache_ioctl_hist *hist);
+void iocache_print_hist(const struct iocache_ioctl_hist *hist, const char *label);
+int iocache_mmio_bench(struct iocache_info *iocache, int target, uint32_t flags, uint32_t iters,
+                       int row, struct iocache_ioctl_mmio_bench *mb);
 int iocache_print_proc_util(struct iocache_info *iocache);
 
+int iocache_set_row_affinity(struct iocache_info *iocache, int cpu, bool pin);
+
 int iocache_start_scheduler(struct iocache_info *iocache);
 int iocache_stop_scheduler(struct iocache_info *iocache);
 
@@ -146,6 +160,24 @@ static void iocache_setup_connection(struct iocache_info *iocache, struct connec
     _iocache_setup_connection(iocache, entry, iocache->row);
 }
 
+/*
+ * Wildcard row: match only the local side of @entry (protocol, src_ip,
+ * src_port), from any remote host and port. A zero remote field is the
+ * matcher's don't-care. Datagrams from many peers then share one row and
+ * are split in software (accnet_demux.h). The same zeros are the row's TX
+ * destination, so a wildcard row can receive but not reply.
+ */
+#define IOCACHE_MATCH_ANY_IP    0U
+#define IOCACHE_MATCH_ANY_PORT  0U
+
+static inline void iocache_setup_wildcard(struct iocache_info *iocache, struct connection_info *entry) {
+    struct connection_info wild = *entry;
+
+    wild.dst_ip   = IOCACHE_MATCH_ANY_IP;
+    wild.dst_port = IOCACHE_MATCH_ANY_PORT;
+    _iocache_setup_connection(iocache, &wild, iocache->row);
+}
+
 static void iocache_clear_connection(struct iocache_info *iocache) {
     int row = iocache->row;
     reg_write8 (iocache->regs, IOCACHE_REG_PROTOCOL(row),    0);
@@ -184,4 +216,8 @@ static inline void iocache_set_rx_ring_size(struct iocache_info *iocache, uint32
     reg_write32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row), val);
 }
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif      // __IOCACHE_LIB_H
\ No newline at end of file
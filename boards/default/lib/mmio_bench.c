@@ -0,0 +1,436 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "accnet_lib.h"
+#include "iocache_lib.h"
+#include "hdr_hist.h"
+
+/*
+ * Cost of each register class and fence on the bypass path, in core cycles.
+ *
+ * Every sample is one operation bracketed by rdcycle/rdinstret, and goes
+ * into one HDR histogram per case. "empty" runs the same bracket around a
+ * call that does nothing. Its p50 is the overhead subtracted in the net
+ * column. The instruction count shows what the case actually executed,
+ * for example that a fence was not merged away.
+ *
+ * Userspace cases read the registers the fast path polls: iocache row
+ * fields, the accnet control timestamp and the UDP ring head/tail. The
+ * only write is the RX head, written back with the value it already holds.
+ * Kernel cases come from IOCACHE_IOCTL_MMIO_BENCH. They cover the PLIC
+ * words next to the claim register, which userspace cannot map, and one
+ * row field for comparison with the userspace read.
+ *
+ * Output is a table, an optional per-case CSV (compare two bitstreams or
+ * kernels by diffing it) and optional saved histograms (cycles; read them
+ * with hdr_merge --scale 1 --unit cycles).
+ */
+
+#define DEFAULT_ITERS       10000
+#define DEFAULT_WARMUP      256
+
+static volatile sig_atomic_t g_got_sigint = 0;
+
+static void on_sigint(int signo)
+{
+    (void)signo;
+    g_got_sigint = 1;
+}
+
+struct mb_ctx {
+    struct accnet_info  *accnet;
+    struct iocache_info *iocache;
+    int row;
+    volatile uint64_t sink;         /* keeps reads live */
+};
+
+struct mb_case {
+    const char *name;
+    const char *group;
+    void (*op)(struct mb_ctx *c);
+};
+
+/* Kept out of line so every case pays the same call overhead as "empty" */
+#define MB_OP(fn) static __attribute__((noinline)) void fn(struct mb_ctx *c)
+
+MB_OP(op_empty)            { (void)c; }
+
+MB_OP(op_row_enabled)      { c->sink = reg_read8(c->iocache->regs, IOCACHE_REG_ENABLED(c->row)); }
+MB_OP(op_row_rx_avail)     { c->sink = reg_read8(c->iocache->regs, IOCACHE_REG_RX_AVAILABLE(c->row)); }
+MB_OP(op_row_ring_size)    { c->sink = reg_read32(c->iocache->regs, IOCACHE_REG_RX_RING_SIZE(c->row)); }
+MB_OP(op_row_proc_ptr)     { c->sink = reg_read64(c->iocache->regs, IOCACHE_REG_PROC_PTR(c->row)); }
+
+MB_OP(op_ctrl_timestamp)   { c->sink = accnet_get_time(c->accnet); }
+
+MB_OP(op_rx_head)          { c->sink = accnet_get_rx_head(c->accnet); }
+MB_OP(op_rx_tail)          { c->sink = accnet_get_rx_tail(c->accnet); }
+MB_OP(op_tx_head)          { c->sink = accnet_get_tx_head(c->accnet); }
+MB_OP(op_tx_tail)          { c->sink = accnet_get_tx_tail(c->accnet); }
+MB_OP(op_rx_last_ts)       { c->sink = reg_read64(c->accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(c->row)); }
+MB_OP(op_rx_head_write)    { accnet_set_rx_head(c->accnet, c->accnet->ring.rx_head); }
+
+MB_OP(op_wmb)              { (void)c; mmio_wmb(); }
+MB_OP(op_rmb)              { (void)c; mmio_rmb(); }
+MB_OP(op_mb)               { (void)c; atomic_thread_fence(memory_order_seq_cst); }
+#if defined(__riscv)
+/* What the kernel's mb(), and writel()/readl() put around the access */
+MB_OP(op_fence_iorw)       { (void)c; __asm__ volatile ("fence iorw,iorw" ::: "memory"); }
+MB_OP(op_fence_w_o)        { (void)c; __asm__ volatile ("fence w,o" ::: "memory"); }
+MB_OP(op_fence_i_r)        { (void)c; __asm__ volatile ("fence i,r" ::: "memory"); }
+#endif
+/* The TX commit pattern: order the payload, then publish the tail */
+MB_OP(op_wmb_tx_tail)      { mmio_wmb(); c->sink = accnet_get_tx_tail(c->accnet); }
+
+static const struct mb_case g_cases[] = {
+    { "empty",               "baseline", op_empty },
+    { "row.enabled (8b)",    "iocache",  op_row_enabled },
+    { "row.rx_available",    "iocache",  op_row_rx_avail },
+    { "row.rx_ring_size",    "iocache",  op_row_ring_size },
+    { "row.proc_ptr (64b)",  "iocache",  op_row_proc_ptr },
+    { "ctrl.timestamp",      "accnet",   op_ctrl_timestamp },
+    { "rx.head",             "ring",     op_rx_head },
+    { "rx.tail",             "ring",     op_rx_tail },
+    { "tx.head",             "ring",     op_tx_head },
+    { "tx.tail",             "ring",     op_tx_tail },
+    { "rx.last_timestamp",   "ring",     op_rx_last_ts },
+    { "rx.head write",       "ring",     op_rx_head_write },
+    { "mmio_wmb",            "fence",    op_wmb },
+    { "mmio_rmb",            "fence",    op_rmb },
+    { "seq_cst fence",       "fence",    op_mb },
+#if defined(__riscv)
+    { "fence iorw,iorw",     "fence",    op_fence_iorw },
+    { "fence w,o",           "fence",    op_fence_w_o },
+    { "fence i,r",           "fence",    op_fence_i_r },
+#endif
+    { "mmio_wmb + tx.tail",  "fence",    op_wmb_tx_tail },
+};
+#define NCASES  (sizeof(g_cases) / sizeof(g_cases[0]))
+
+static const struct {
+    const char *name;
+    int target;
+    uint32_t flags;
+} g_kcases[] = {
+    { "k.empty",                 IOCACHE_MMIO_NONE,          0 },
+    { "k.plic.priority",         IOCACHE_MMIO_PLIC_PRIORITY, 0 },
+    { "k.plic.priority relaxed", IOCACHE_MMIO_PLIC_PRIORITY, IOCACHE_MMIO_RELAXED },
+    { "k.plic.pending",          IOCACHE_MMIO_PLIC_PENDING,  0 },
+    { "k.plic.pending relaxed",  IOCACHE_MMIO_PLIC_PENDING,  IOCACHE_MMIO_RELAXED },
+    { "k.row.enabled",           IOCACHE_MMIO_ROW_ENABLED,   0 },
+    { "k.row.enabled relaxed",   IOCACHE_MMIO_ROW_ENABLED,   IOCACHE_MMIO_RELAXED },
+};
+#define NKCASES (sizeof(g_kcases) / sizeof(g_kcases[0]))
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [--iters N] [--warmup N] [--cpu C] [--ring R] [--only SUBSTR] [--no-kernel]\n"
+        "          [--out FILE | --skip-file] [--hist-dir DIR] [--verbose]\n"
+        "Defaults: --iters %d --warmup %d --cpu 0 --out out-mmio.csv\n",
+        prog, DEFAULT_ITERS, DEFAULT_WARMUP);
+}
+
+/* Core cycles per microsecond, against CLOCK_MONOTONIC over ~50 ms */
+static double calibrate_cycles_per_us(void)
+{
+    struct timespec t0, t1, nap = { 0, 50 * 1000 * 1000 };
+    uint64_t c0, c1;
+    double us;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = rdcycle();
+    nanosleep(&nap, NULL);
+    c1 = rdcycle();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    return us > 0 ? (c1 - c0) / us : 0.0;
+}
+
+static void run_case(const struct mb_case *mc, struct mb_ctx *c, int iters, int warmup,
+                     struct hdr_hist *h, double *instret)
+{
+    uint64_t insts = 0;
+
+    for (int i = 0; i < warmup; i++)
+        mc->op(c);
+
+    for (int i = 0; i < iters && !g_got_sigint; i++) {
+        uint64_t c0, c1, i0, i1;
+
+        c0 = rdcycle();
+        i0 = rdinstret();
+        mc->op(c);
+        i1 = rdinstret();
+        c1 = rdcycle();
+
+        hdr_hist_record(h, c1 - c0);
+        insts += i1 - i0;
+    }
+    *instret = h->total ? (double)insts / (double)h->total : 0.0;
+}
+
+/* Upper edge of the log2 bucket holding the p-th fraction, as iocache_print_hist does */
+static uint64_t kbucket_percentile(const struct iocache_ioctl_mmio_bench *mb, double p)
+{
+    uint64_t want = (uint64_t)(p * mb->count + 0.5), seen = 0;
+
+    if (want == 0)
+        want = 1;
+    for (int i = 0; i < IOCACHE_HIST_BUCKETS; i++) {
+        seen += mb->buckets[i];
+        if (seen >= want)
+            return (i == IOCACHE_HIST_BUCKETS - 1) ? mb->max_cycles : (2ULL << i) - 1;
+    }
+    return mb->max_cycles;
+}
+
+int main(int argc, char **argv)
+{
+    char *accnet_filename  = "/dev/accnet-misc";
+    char *iocache_filename = "/dev/iocache-misc";
+    int iters = DEFAULT_ITERS, warmup = DEFAULT_WARMUP, cpu = 0;
+    int ring = IOCACHE_ROW_ANY;
+    const char *only = NULL;
+    const char *out_path = "out-mmio.csv";
+    const char *hist_dir = NULL;
+    bool kernel = true, verbose = false;
+    struct accnet_info  *accnet  = calloc(1, sizeof(*accnet));
+    struct iocache_info *iocache = calloc(1, sizeof(*iocache));
+    struct hdr_hist *hists[NCASES];
+    double instret[NCASES];
+    struct iocache_ioctl_mmio_bench kres[NKCASES];
+    bool kran[NKCASES];
+    struct mb_ctx ctx;
+    struct sigaction sa;
+    double cyc_per_us, base;
+    FILE *csv = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            iters = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ring") == 0 && i + 1 < argc) {
+            ring = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-kernel") == 0) {
+            kernel = false;
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--skip-file") == 0) {
+            out_path = NULL;
+        }
+        else if (strcmp(argv[i], "--hist-dir") == 0 && i + 1 < argc) {
+            hist_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iters <= 0 || warmup < 0 || !accnet || !iocache) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        perror("sched_setaffinity");
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (iocache_open(iocache_filename, iocache, ring) < 0) {
+        fprintf(stderr, "iocache_open failed\n");
+        return 1;
+    }
+    if (accnet_open(accnet_filename, accnet, iocache, true) < 0) {
+        fprintf(stderr, "accnet_open failed\n");
+        iocache_close(iocache);
+        return 1;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.accnet  = accnet;
+    ctx.iocache = iocache;
+    ctx.row     = iocache->row;
+
+    cyc_per_us = calibrate_cycles_per_us();
+    printf("row %d, cpu %d, %d samples/case, %.1f cycles/us\n\n", ctx.row, cpu, iters, cyc_per_us);
+
+    for (size_t k = 0; k < NCASES; k++) {
+        hists[k] = malloc(sizeof(struct hdr_hist));
+        if (!hists[k]) {
+            perror("malloc");
+            return 1;
+        }
+        hdr_hist_init(hists[k]);
+        instret[k] = 0.0;
+    }
+
+    /* ---- userspace cases ---- */
+    for (size_t k = 0; k < NCASES && !g_got_sigint; k++) {
+        /* The baseline always runs: everything else is reported net of it */
+        if (k > 0 && only && !strstr(g_cases[k].name, only) && !strstr(g_cases[k].group, only))
+            continue;
+        run_case(&g_cases[k], &ctx, iters, warmup, hists[k], &instret[k]);
+        if (verbose)
+            hdr_hist_print(stdout, hists[k], g_cases[k].name, 1.0, "cycles");
+    }
+    base = hists[0]->total ? (double)hdr_hist_percentile(hists[0], 50.0) : 0.0;
+
+    /* ---- kernel cases ---- */
+    memset(kran, 0, sizeof(kran));
+    for (size_t k = 0; kernel && k < NKCASES && !g_got_sigint; k++) {
+        if (k > 0 && only && !strstr(g_kcases[k].name, only))
+            continue;
+        if (iocache_mmio_bench(iocache, g_kcases[k].target, g_kcases[k].flags, (uint32_t)iters,
+                               ctx.row, &kres[k]) != 0)
+            break;
+        kran[k] = true;
+    }
+
+    printf("%-24s %-9s %9s %9s %9s %9s %9s %9s %7s %9s\n",
+           "case", "group", "min", "p50", "p90", "p99", "p99.9", "max", "insts", "net_p50");
+    for (size_t k = 0; k < NCASES; k++) {
+        const struct hdr_hist *h = hists[k];
+        double p50;
+
+        if (!h->total)
+            continue;
+        p50 = (double)hdr_hist_percentile(h, 50.0);
+        printf("%-24s %-9s %9llu %9llu %9llu %9llu %9llu %9llu %7.1f %9.0f\n",
+               g_cases[k].name, g_cases[k].group,
+               (unsigned long long)h->min,
+               (unsigned long long)hdr_hist_percentile(h, 50.0),
+               (unsigned long long)hdr_hist_percentile(h, 90.0),
+               (unsigned long long)hdr_hist_percentile(h, 99.0),
+               (unsigned long long)hdr_hist_percentile(h, 99.9),
+               (unsigned long long)h->max,
+               instret[k], k ? (p50 > base ? p50 - base : 0.0) : p50);
+    }
+
+    /* Kernel percentiles are log2 bucket edges ("<="), from the driver */
+    if (kernel) {
+        double kbase = kran[0] && kres[0].count ? kres[0].sum_cycles / (double)kres[0].count : 0.0;
+
+        printf("\n%-24s %9s %9s %9s %9s %9s %9s\n",
+               "kernel case", "min", "mean", "p50<=", "p99<=", "max", "net_mean");
+        for (size_t k = 0; k < NKCASES; k++) {
+            const struct iocache_ioctl_mmio_bench *mb = &kres[k];
+            double mean;
+
+            if (!kran[k] || !mb->count)
+                continue;
+            mean = mb->sum_cycles / (double)mb->count;
+            printf("%-24s %9llu %9.1f %9llu %9llu %9llu %9.1f\n", g_kcases[k].name,
+                   (unsigned long long)mb->min_cycles, mean,
+                   (unsigned long long)kbucket_percentile(mb, 0.50),
+                   (unsigned long long)kbucket_percentile(mb, 0.99),
+                   (unsigned long long)mb->max_cycles,
+                   k ? (mean > kbase ? mean - kbase : 0.0) : mean);
+        }
+    }
+    if (cyc_per_us > 0)
+        printf("\nAll values in core cycles; %.1f cycles = 1 us\n", cyc_per_us);
+
+    if (out_path) {
+        csv = fopen(out_path, "w");
+        if (!csv)
+            perror(out_path);
+    }
+    if (csv) {
+        fprintf(csv, "case,group,samples,min,p50,p90,p99,p99.9,max,mean,insts,net_p50,cycles_per_us\n");
+        for (size_t k = 0; k < NCASES; k++) {
+            const struct hdr_hist *h = hists[k];
+            double p50;
+
+            if (!h->total)
+                continue;
+            p50 = (double)hdr_hist_percentile(h, 50.0);
+            fprintf(csv, "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.1f,%.1f,%.0f,%.1f\n",
+                    g_cases[k].name, g_cases[k].group, (unsigned long long)h->total,
+                    (unsigned long long)h->min,
+                    (unsigned long long)hdr_hist_percentile(h, 50.0),
+                    (unsigned long long)hdr_hist_percentile(h, 90.0),
+                    (unsigned long long)hdr_hist_percentile(h, 99.0),
+                    (unsigned long long)hdr_hist_percentile(h, 99.9),
+                    (unsigned long long)h->max, hdr_hist_mean(h),
+                    instret[k], k ? (p50 > base ? p50 - base : 0.0) : p50, cyc_per_us);
+        }
+        /* Kernel rows: p90 and p99.9 are not resolvable from log2 buckets */
+        for (size_t k = 0; kernel && k < NKCASES; k++) {
+            const struct iocache_ioctl_mmio_bench *mb = &kres[k];
+
+            if (!kran[k] || !mb->count)
+                continue;
+            fprintf(csv, "%s,kernel,%llu,%llu,%llu,,%llu,,%llu,%.1f,,,%.1f\n",
+                    g_kcases[k].name, (unsigned long long)mb->count,
+                    (unsigned long long)mb->min_cycles,
+                    (unsigned long long)kbucket_percentile(mb, 0.50),
+                    (unsigned long long)kbucket_percentile(mb, 0.99),
+                    (unsigned long long)mb->max_cycles,
+                    mb->sum_cycles / (double)mb->count, cyc_per_us);
+        }
+        fclose(csv);
+        printf("Wrote results to %s\n", out_path);
+    }
+
+    if (hist_dir) {
+        char path[512];
+
+        mkdir(hist_dir, 0755);
+        for (size_t k = 0; k < NCASES; k++) {
+            char name[64];
+
+            if (!hists[k]->total)
+                continue;
+            /* Case names have spaces and parentheses; keep file names plain */
+            snprintf(name, sizeof(name), "%s", g_cases[k].name);
+            for (char *p = name; *p; p++) {
+                if (*p == ' ' || *p == '(' || *p == ')' || *p == ',' || *p == '+')
+                    *p = '_';
+            }
+            snprintf(path, sizeof(path), "%s/%s.hist", hist_dir, name);
+            if (hdr_hist_save(hists[k], path) != 0)
+                perror(path);
+        }
+        printf("Wrote histograms (cycles) to %s/\n", hist_dir);
+    }
+
+    for (size_t k = 0; k < NCASES; k++)
+        free(hists[k]);
+    accnet_close(accnet);
+    iocache_close(iocache);
+    free(accnet);
+    free(iocache);
+    return 0;
+}
@@ -0,0 +1,445 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "accnet_lib.h"
+#include "iocache_lib.h"
+
+/*
+ * Multi-row, multi-core throughput benchmark.
+ *
+ * Opens --rows iocache rows and spreads them round-robin over --cores
+ * threads, pinned to CPUs --first-cpu, --first-cpu + 1, ... Each thread
+ * reserves its own rows, because a row's interrupts wake the task that
+ * reserved it. It then runs one run-to-completion loop over them: fill TX,
+ * drain RX. Row i talks from --src-port + i to --dst-port + i.
+ *
+ * The report has per-row TX/RX Gb/s and hardware RX drops
+ * (ACCNET_UDP_RX_RING_DROP), and per-core Gb/s, CPU and busy share. CPU is
+ * thread CPU time / wall time. Busy is the share of passes over the
+ * core's rows that moved any bytes. An aggregate line follows.
+ * --sweep repeats the run for 1, 2, 4 ... --rows rows on min(rows,
+ * --cores) cores and prints only the aggregate lines, as a scaling curve.
+ */
+
+#define DEFAULT_SECONDS     5
+#define TX_BATCH            16      /* datagrams queued per row per pass */
+
+enum traffic {
+    TRAFFIC_TX   = 1 << 0,
+    TRAFFIC_RX   = 1 << 1,
+    TRAFFIC_BOTH = TRAFFIC_TX | TRAFFIC_RX,
+};
+
+struct bench_cfg {
+    char *iocache_filename;
+    char *accnet_filename;
+    char *src_mac, *src_ip, *dst_mac, *dst_ip;
+    uint16_t src_port, dst_port;
+    uint32_t payload_size;
+    int traffic;
+    int first_cpu;
+    bool block;             /* rx only: sleep in the driver when every row is idle */
+};
+
+struct row_ctx {
+    int index;              /* 0 .. rows-1, picks the ports */
+    int row;                /* iocache row the driver gave us */
+    bool opened;
+    struct iocache_info iocache;
+    struct accnet_info accnet;
+
+    uint64_t tx_bytes, rx_bytes;
+    uint32_t drops_start, drops_end;
+};
+
+struct core_ctx {
+    int cpu;
+    int nrows;
+    struct row_ctx **rows;
+    const struct bench_cfg *cfg;
+    pthread_t thr;
+    int err;
+
+    uint64_t passes, busy_passes;
+    uint64_t wall_ns, cpu_ns;
+};
+
+static volatile sig_atomic_t g_got_sigint = 0;
+static atomic_bool g_stop;
+static atomic_bool g_go;
+static atomic_int  g_ready;
+
+static void on_sigint(int signo)
+{
+    (void)signo;
+    g_got_sigint = 1;
+    atomic_store(&g_stop, true);
+}
+
+static inline uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t read_drops(struct row_ctx *r)
+{
+    return reg_read32(r->accnet.udp_rx_regs, ACCNET_UDP_RX_RING_DROP(r->row));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [--rows N] [--cores M] [--first-cpu C] [--seconds S] [--payload-size BYTES]\n"
+        "          [--traffic {tx|rx|both}] [--block] [--sweep]\n"
+        "          [--src-mac MAC] [--src-ip ADDR] [--src-port PORT] [--dst-mac MAC] [--dst-ip ADDR] [--dst-port PORT]\n"
+        "Defaults: --rows 1 --cores 1 --first-cpu 0 --seconds %d --payload-size 1024 --traffic both\n",
+        prog, DEFAULT_SECONDS);
+}
+
+static int open_row(const struct bench_cfg *cfg, struct row_ctx *r)
+{
+    struct connection_info conn;
+
+    if (iocache_open(cfg->iocache_filename, &r->iocache, IOCACHE_ROW_ANY) < 0) {
+        fprintf(stderr, "row %d: iocache_open failed\n", r->index);
+        return -1;
+    }
+    if (accnet_open(cfg->accnet_filename, &r->accnet, &r->iocache, true) < 0) {
+        fprintf(stderr, "row %d: accnet_open failed\n", r->index);
+        iocache_close(&r->iocache);
+        return -1;
+    }
+    if (conn_from_strings_mac(&conn, 0x11, cfg->src_mac, cfg->src_ip, cfg->src_port + r->index,
+                              cfg->dst_mac, cfg->dst_ip, cfg->dst_port + r->index) != 0) {
+        fprintf(stderr, "row %d: bad connection arguments\n", r->index);
+        accnet_close(&r->accnet);
+        iocache_close(&r->iocache);
+        return -1;
+    }
+
+    accnet_setup_connection(&r->accnet, &conn);
+    iocache_setup_connection(&r->iocache, &conn);
+    r->row = r->iocache.row;
+    r->opened = true;
+    return 0;
+}
+
+static void close_row(struct row_ctx *r)
+{
+    if (!r->opened)
+        return;
+    iocache_clear_connection(&r->iocache);
+    accnet_close(&r->accnet);
+    iocache_close(&r->iocache);
+    r->opened = false;
+}
+
+/* One pass over a row; returns bytes moved */
+static uint64_t service_row(const struct bench_cfg *cfg, struct row_ctx *r)
+{
+    struct accnet_span span;
+    uint64_t moved = 0;
+
+    if (cfg->traffic & TRAFFIC_TX) {
+        /* Payload bytes are whatever is in the ring; this measures the path, not memcpy */
+        for (int n = 0; n < TX_BATCH; n++) {
+            if (accnet_tx_reserve(&r->accnet, cfg->payload_size, &span) != 0)
+                break;
+            accnet_tx_commit(&r->accnet, &span, cfg->payload_size);
+            r->tx_bytes += cfg->payload_size;
+            moved += cfg->payload_size;
+        }
+    }
+
+    if (cfg->traffic & TRAFFIC_RX) {
+        uint32_t got = accnet_rx_peek(&r->accnet, &span);
+        if (got) {
+            accnet_rx_release(&r->accnet, &span, got);
+            r->rx_bytes += got;
+            moved += got;
+        }
+    }
+    return moved;
+}
+
+static void *core_fn(void *arg)
+{
+    struct core_ctx *c = arg;
+    const struct bench_cfg *cfg = c->cfg;
+    uint64_t mask = 0, wall0, cpu0;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(c->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        perror("sched_setaffinity");
+
+    for (int i = 0; i < c->nrows; i++) {
+        if (open_row(cfg, c->rows[i]) != 0) {
+            c->err = -1;
+            break;
+        }
+        mask |= 1ULL << c->rows[i]->row;
+    }
+
+    /* Everyone starts together, including cores whose rows failed to open */
+    atomic_fetch_add(&g_ready, 1);
+    while (!atomic_load(&g_go) && !atomic_load(&g_stop))
+        usleep(100);
+    if (c->err || atomic_load(&g_stop)) {
+        for (int i = 0; i < c->nrows; i++)
+            close_row(c->rows[i]);
+        return NULL;
+    }
+
+    for (int i = 0; i < c->nrows; i++)
+        c->rows[i]->drops_start = read_drops(c->rows[i]);
+    wall0 = clock_ns(CLOCK_MONOTONIC);
+    cpu0  = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        uint64_t moved = 0;
+
+        for (int i = 0; i < c->nrows; i++)
+            moved += service_row(cfg, c->rows[i]);
+
+        c->passes++;
+        if (moved) {
+            c->busy_passes++;
+        } else if (cfg->block && cfg->traffic == TRAFFIC_RX) {
+            uint64_t ready = mask;
+            iocache_wait_on_rx_mask(&c->rows[0]->iocache, &ready, 100000);
+        }
+    }
+
+    c->wall_ns = clock_ns(CLOCK_MONOTONIC) - wall0;
+    c->cpu_ns  = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+    for (int i = 0; i < c->nrows; i++) {
+        c->rows[i]->drops_end = read_drops(c->rows[i]);
+        close_row(c->rows[i]);
+    }
+    return NULL;
+}
+
+static inline double gbps(uint64_t bytes, uint64_t ns)
+{
+    return ns ? (bytes * 8.0) / (double)ns : 0.0;
+}
+
+/* Run one configuration; returns 0 when every row opened */
+static int run_step(const struct bench_cfg *cfg, int nrows, int ncores, unsigned seconds, bool detail)
+{
+    struct row_ctx *rows = calloc(nrows, sizeof(*rows));
+    struct row_ctx **slots = calloc(nrows, sizeof(*slots));
+    struct core_ctx *cores = calloc(ncores, sizeof(*cores));
+    uint64_t tx_total = 0, rx_total = 0, drops_total = 0, wall_max = 0;
+    double cpu_sum = 0.0;
+    int started = 0, err = 0, k = 0;
+
+    if (!rows || !slots || !cores) {
+        perror("calloc");
+        free(rows); free(slots); free(cores);
+        return -1;
+    }
+
+    /* Row i goes to core i % ncores; each core gets a contiguous slice of slots */
+    for (int c = 0; c < ncores; c++) {
+        cores[c].cpu  = cfg->first_cpu + c;
+        cores[c].cfg  = cfg;
+        cores[c].rows = &slots[k];
+        for (int i = c; i < nrows; i += ncores) {
+            rows[i].index = i;
+            slots[k++] = &rows[i];
+            cores[c].nrows++;
+        }
+    }
+
+    atomic_store(&g_stop, false);
+    atomic_store(&g_go, false);
+    atomic_store(&g_ready, 0);
+    for (; started < ncores; started++) {
+        if (pthread_create(&cores[started].thr, NULL, core_fn, &cores[started]) != 0) {
+            perror("pthread_create");
+            err = -1;
+            atomic_store(&g_stop, true);
+            break;
+        }
+    }
+    while (!err && atomic_load(&g_ready) < started)
+        usleep(1000);
+    atomic_store(&g_go, true);
+
+    for (unsigned s = 0; s < seconds && !g_got_sigint && !err; s++)
+        sleep(1);
+    atomic_store(&g_stop, true);
+
+    for (int c = 0; c < started; c++) {
+        pthread_join(cores[c].thr, NULL);
+        if (cores[c].err)
+            err = -1;
+    }
+
+    if (detail)
+        printf("\n%5s %5s %5s %10s %10s %12s\n", "index", "row", "cpu", "tx_Gb/s", "rx_Gb/s", "rx_drops");
+
+    for (int c = 0; c < started; c++) {
+        struct core_ctx *cc = &cores[c];
+        uint64_t tx = 0, rx = 0;
+
+        for (int i = 0; i < cc->nrows; i++) {
+            struct row_ctx *r = cc->rows[i];
+            uint32_t drops = r->drops_end - r->drops_start;     /* 32-bit counter, wraps */
+
+            tx += r->tx_bytes;
+            rx += r->rx_bytes;
+            drops_total += drops;
+            if (detail)
+                printf("%5d %5d %5d %10.3f %10.3f %12u\n", r->index, r->row, cc->cpu,
+                       gbps(r->tx_bytes, cc->wall_ns), gbps(r->rx_bytes, cc->wall_ns), drops);
+        }
+        cc->wall_ns = cc->wall_ns ? cc->wall_ns : 1;
+        tx_total += tx;
+        rx_total += rx;
+        cpu_sum  += 100.0 * cc->cpu_ns / (double)cc->wall_ns;
+        if (cc->wall_ns > wall_max)
+            wall_max = cc->wall_ns;
+
+        if (detail)
+            printf("  core cpu=%d rows=%d tx=%.3f Gb/s rx=%.3f Gb/s cpu=%.1f%% busy=%.1f%%\n",
+                   cc->cpu, cc->nrows, gbps(tx, cc->wall_ns), gbps(rx, cc->wall_ns),
+                   100.0 * cc->cpu_ns / (double)cc->wall_ns,
+                   cc->passes ? 100.0 * cc->busy_passes / (double)cc->passes : 0.0);
+    }
+
+    printf("rows=%-3d cores=%-3d payload=%u tx=%.3f Gb/s rx=%.3f Gb/s per-row=%.3f Gb/s "
+           "cpu=%.1f%%/core rx_drops=%" PRIu64 "%s\n",
+           nrows, ncores, cfg->payload_size, gbps(tx_total, wall_max), gbps(rx_total, wall_max),
+           gbps(tx_total + rx_total, wall_max) / nrows, started ? cpu_sum / started : 0.0,
+           drops_total, err ? " (incomplete: rows failed to open)" : "");
+
+    free(cores);
+    free(slots);
+    free(rows);
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_cfg cfg = {
+        .iocache_filename = "/dev/iocache-misc",
+        .accnet_filename  = "/dev/accnet-misc",
+        .src_mac      = "0c:42:a1:a8:2d:e6",
+        .src_ip       = "10.0.0.2",
+        .src_port     = 1111,
+        .dst_mac      = "00:0a:35:06:4d:e2",
+        .dst_ip       = "10.0.0.1",
+        .dst_port     = 1234,
+        .payload_size = 1024,
+        .traffic      = TRAFFIC_BOTH,
+        .first_cpu    = 0,
+    };
+    int nrows = 1, ncores = 1;
+    unsigned seconds = DEFAULT_SECONDS;
+    bool sweep = false;
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    struct sigaction sa;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            nrows = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc) {
+            ncores = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--first-cpu") == 0 && i + 1 < argc) {
+            cfg.first_cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--payload-size") == 0 && i + 1 < argc) {
+            cfg.payload_size = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--traffic") == 0 && i + 1 < argc) {
+            const char *t = argv[++i];
+            if (strcmp(t, "tx") == 0)
+                cfg.traffic = TRAFFIC_TX;
+            else if (strcmp(t, "rx") == 0)
+                cfg.traffic = TRAFFIC_RX;
+            else if (strcmp(t, "both") == 0)
+                cfg.traffic = TRAFFIC_BOTH;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--block") == 0) {
+            cfg.block = true;
+        }
+        else if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        }
+        else if (strcmp(argv[i], "--src-mac") == 0 && i + 1 < argc) {
+            cfg.src_mac = argv[++i];
+        }
+        else if (strcmp(argv[i], "--src-ip") == 0 && i + 1 < argc) {
+            cfg.src_ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--src-port") == 0 && i + 1 < argc) {
+            cfg.src_port = (uint16_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dst-mac") == 0 && i + 1 < argc) {
+            cfg.dst_mac = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dst-ip") == 0 && i + 1 < argc) {
+            cfg.dst_ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dst-port") == 0 && i + 1 < argc) {
+            cfg.dst_port = (uint16_t)atoi(argv[++i]);
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (nrows < 1 || nrows > IOCACHE_CACHE_ENTRY_COUNT || ncores < 1 || cfg.payload_size == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (ncores > nrows)
+        ncores = nrows;
+    if (cfg.first_cpu < 0 || cfg.first_cpu + ncores > ncpu) {
+        fprintf(stderr, "cores %d..%d out of range [0..%ld)\n", cfg.first_cpu, cfg.first_cpu + ncores - 1, ncpu);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (!sweep)
+        return run_step(&cfg, nrows, ncores, seconds, true) == 0 ? 0 : 1;
+
+    for (int n = 1; n <= nrows && !g_got_sigint; n = (n == nrows || 2 * n <= nrows) ? 2 * n : nrows) {
+        if (run_step(&cfg, n, n < ncores ? n : ncores, seconds, false) != 0)
+            return 1;
+    }
+    return 0;
+}
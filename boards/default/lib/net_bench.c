@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "iocache_lib.h"
+#include "hdr_hist.h"
+#include "bench_backend.h"
+
+/*
+ * Side-by-side latency benchmark: kernel UDP sockets vs the iocache
+ * bypass path.
+ *
+ * Every backend runs the same payload sweep with the same request count and
+ * warm-up. RTTs land in one HDR histogram per (backend, payload), in
+ * nanoseconds whatever clock the backend uses. The output is one summary
+ * CSV with the same columns for every backend, optional saved histograms
+ * (hdr_merge --scale 0.001 reads them in us), and a comparison table
+ * when both backends ran.
+ *
+ * Peers: udp_server_kernel for "kernel", udp_exp --mode server for "bypass".
+ */
+
+#define DEFAULT_NTEST       1000
+#define DEFAULT_WARMUP      16
+#define DEFAULT_PAYLOADS    "64,128,256,512,1024,1472"
+#define MAX_STEPS           32
+#define MAX_BACKENDS        2
+
+static volatile sig_atomic_t g_got_sigint = 0;
+
+static void on_sigint(int signo)
+{
+    (void)signo;
+    g_got_sigint = 1;
+}
+
+struct step_result {
+    uint32_t payload;
+    int sent, received;
+    struct hdr_hist *hist;      /* ns */
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [--backend {kernel|bypass|both}] [--payload-sizes B[,B...]] [--ntest N] [--warmup N]\n"
+        "          [--cpu C] [--timeout-ms MS] [--out FILE | --skip-file] [--hist-dir DIR]\n"
+        "          kernel: [--kernel-ip ADDR] [--kernel-port PORT]\n"
+        "          bypass: [--block] [--ring R] [--src-mac MAC] [--src-ip ADDR] [--src-port PORT]\n"
+        "                  [--dst-mac MAC] [--dst-ip ADDR] [--dst-port PORT]\n"
+        "Defaults: --backend both --payload-sizes %s --ntest %d --warmup %d --out out-bench.csv\n",
+        prog, DEFAULT_PAYLOADS, DEFAULT_NTEST, DEFAULT_WARMUP);
+}
+
+static int parse_payloads(const char *list, uint32_t *out, int max)
+{
+    char *copy = strdup(list), *save = NULL;
+    int n = 0;
+
+    if (!copy)
+        return -1;
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        long v = strtol(tok, NULL, 0);
+        if (v <= 0 || v > BENCH_MAX_PAYLOAD || n == max) {
+            fprintf(stderr, "payload sizes must be 1..%d, at most %d of them\n", BENCH_MAX_PAYLOAD, max);
+            free(copy);
+            return -1;
+        }
+        out[n++] = (uint32_t)v;
+    }
+    free(copy);
+    return n;
+}
+
+/* Run the whole sweep on one backend; results[] is filled in sweep order */
+static int run_backend(const struct bench_backend_ops *ops, const struct bench_opts *o,
+                       const uint32_t *payloads, int nsteps, int ntest, int warmup,
+                       struct step_result *results)
+{
+    struct bench_backend b = { .ops = ops };
+    uint8_t payload[BENCH_MAX_PAYLOAD];
+    uint64_t rtt;
+
+    for (uint32_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i & 0xff;
+
+    if (ops->open(&b, o) != 0) {
+        fprintf(stderr, "%s: open failed\n", ops->name);
+        return -1;
+    }
+
+    for (int s = 0; s < nsteps && !g_got_sigint; s++) {
+        struct step_result *r = &results[s];
+
+        r->payload = payloads[s];
+        for (int i = 0; i < warmup && !g_got_sigint; i++)
+            ops->rtt(&b, payload, r->payload, &rtt);
+
+        for (int i = 0; i < ntest && !g_got_sigint; i++) {
+            payload[0] = (uint8_t)i;
+            r->sent++;
+            if (ops->rtt(&b, payload, r->payload, &rtt) != 0)
+                continue;
+            hdr_hist_record(r->hist, rtt);
+            r->received++;
+        }
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s %4u B recv=%d/%d", ops->name, r->payload, r->received, r->sent);
+        hdr_hist_print(stdout, r->hist, label, 1e-3, "us");
+    }
+
+    ops->close(&b);
+    return 0;
+}
+
+static void write_csv(FILE *f, const char *backend, const struct step_result *r)
+{
+    const struct hdr_hist *h = r->hist;
+
+    fprintf(f, "%s,%u,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            backend, r->payload, r->sent, r->received,
+            h->min / 1e3, hdr_hist_mean(h) / 1e3,
+            hdr_hist_percentile(h, 50.0) / 1e3,
+            hdr_hist_percentile(h, 90.0) / 1e3,
+            hdr_hist_percentile(h, 99.0) / 1e3,
+            hdr_hist_percentile(h, 99.9) / 1e3,
+            hdr_hist_percentile(h, 99.99) / 1e3,
+            h->max / 1e3);
+}
+
+static inline double ratio(uint64_t a, uint64_t b)
+{
+    return b ? (double)a / (double)b : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_opts o = {
+        .kernel_ip        = "10.0.0.2",
+        .kernel_port      = 1111,
+        .timeout_ms       = 1000,
+        .accnet_filename  = "/dev/accnet-misc",
+        .iocache_filename = "/dev/iocache-misc",
+        .src_mac  = "0c:42:a1:a8:2d:e6",
+        .src_ip   = "10.0.0.2",
+        .src_port = 1111,
+        .dst_mac  = "00:0a:35:06:4d:e2",
+        .dst_ip   = "10.0.0.1",
+        .dst_port = 1234,
+        .ring     = IOCACHE_ROW_ANY,
+    };
+    const struct bench_backend_ops *backends[MAX_BACKENDS];
+    struct step_result results[MAX_BACKENDS][MAX_STEPS];
+    uint32_t payloads[MAX_STEPS];
+    const char *payload_list = DEFAULT_PAYLOADS;
+    const char *which = "both";
+    const char *out_path = "out-bench.csv";
+    const char *hist_dir = NULL;
+    int ntest = DEFAULT_NTEST, warmup = DEFAULT_WARMUP, cpu = 0;
+    int nbackends = 0, nsteps;
+    struct sigaction sa;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            which = argv[++i];
+        }
+        else if (strcmp(argv[i], "--payload-sizes") == 0 && i + 1 < argc) {
+            payload_list = argv[++i];
+        }
+        else if (strcmp(argv[i], "--ntest") == 0 && i + 1 < argc) {
+            ntest = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) {
+            o.timeout_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--skip-file") == 0) {
+            out_path = NULL;
+        }
+        else if (strcmp(argv[i], "--hist-dir") == 0 && i + 1 < argc) {
+            hist_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--kernel-ip") == 0 && i + 1 < argc) {
+            o.kernel_ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--kernel-port") == 0 && i + 1 < argc) {
+            o.kernel_port = (uint16_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--block") == 0) {
+            o.blocking = true;
+        }
+        else if (strcmp(argv[i], "--ring") == 0 && i + 1 < argc) {
+            o.ring = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--src-mac") == 0 && i + 1 < argc) {
+            o.src_mac = argv[++i];
+        }
+        else if (strcmp(argv[i], "--src-ip") == 0 && i + 1 < argc) {
+            o.src_ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--src-port") == 0 && i + 1 < argc) {
+            o.src_port = (uint16_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dst-mac") == 0 && i + 1 < argc) {
+            o.dst_mac = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dst-ip") == 0 && i + 1 < argc) {
+            o.dst_ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dst-port") == 0 && i + 1 < argc) {
+            o.dst_port = (uint16_t)atoi(argv[++i]);
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (strcmp(which, "both") == 0) {
+        backends[nbackends++] = &bench_backend_kernel;
+        backends[nbackends++] = &bench_backend_bypass;
+    } else if ((backends[0] = bench_backend_find(which)) != NULL) {
+        nbackends = 1;
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    nsteps = parse_payloads(payload_list, payloads, MAX_STEPS);
+    if (nsteps <= 0 || ntest <= 0 || warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        perror("sched_setaffinity");
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    memset(results, 0, sizeof(results));
+    for (int b = 0; b < nbackends; b++) {
+        for (int s = 0; s < nsteps; s++) {
+            results[b][s].hist = malloc(sizeof(struct hdr_hist));
+            if (!results[b][s].hist) {
+                perror("malloc");
+                return 1;
+            }
+            hdr_hist_init(results[b][s].hist);
+        }
+    }
+
+    for (int b = 0; b < nbackends && !g_got_sigint; b++) {
+        printf("\n== %s (clock %s, %d requests/step, %d warm-up) ==\n",
+               backends[b]->name, backends[b]->clock, ntest, warmup);
+        if (run_backend(backends[b], &o, payloads, nsteps, ntest, warmup, results[b]) != 0)
+            return 1;
+    }
+
+    if (out_path) {
+        FILE *f = fopen(out_path, "w");
+        if (!f) {
+            perror(out_path);
+        } else {
+            fprintf(f, "backend,size(B),sent,recv,min(us),mean(us),p50(us),p90(us),p99(us),p99.9(us),p99.99(us),max(us)\n");
+            for (int b = 0; b < nbackends; b++) {
+                for (int s = 0; s < nsteps; s++) {
+                    if (results[b][s].sent)
+                        write_csv(f, backends[b]->name, &results[b][s]);
+                }
+            }
+            fclose(f);
+            printf("\nWrote results to %s\n", out_path);
+        }
+    }
+
+    if (hist_dir) {
+        char path[512];
+
+        mkdir(hist_dir, 0755);
+        for (int b = 0; b < nbackends; b++) {
+            for (int s = 0; s < nsteps; s++) {
+                if (!results[b][s].sent)
+                    continue;
+                snprintf(path, sizeof(path), "%s/%s-%u.hist", hist_dir, backends[b]->name, payloads[s]);
+                if (hdr_hist_save(results[b][s].hist, path) != 0)
+                    perror(path);
+            }
+        }
+        printf("Wrote histograms (ns) to %s/\n", hist_dir);
+    }
+
+    /* Ratios are kernel / bypass: above 1 means the bypass path is faster */
+    if (nbackends == MAX_BACKENDS) {
+        printf("\n%8s | %10s %10s %10s | %10s %10s %10s | %8s %8s %8s\n",
+               "size(B)", "kern_p50", "kern_p99", "kern_p99.9", "byp_p50", "byp_p99", "byp_p99.9",
+               "x_p50", "x_p99", "x_p99.9");
+        for (int s = 0; s < nsteps; s++) {
+            const struct hdr_hist *k = results[0][s].hist, *y = results[1][s].hist;
+            uint64_t k50 = hdr_hist_percentile(k, 50.0), k99 = hdr_hist_percentile(k, 99.0);
+            uint64_t k999 = hdr_hist_percentile(k, 99.9);
+            uint64_t y50 = hdr_hist_percentile(y, 50.0), y99 = hdr_hist_percentile(y, 99.0);
+            uint64_t y999 = hdr_hist_percentile(y, 99.9);
+
+            if (!k->total || !y->total)
+                continue;
+            printf("%8u | %10.2f %10.2f %10.2f | %10.2f %10.2f %10.2f | %8.2f %8.2f %8.2f\n",
+                   payloads[s], k50 / 1e3, k99 / 1e3, k999 / 1e3, y50 / 1e3, y99 / 1e3, y999 / 1e3,
+                   ratio(k50, y50), ratio(k99, y99), ratio(k999, y999));
+        }
+        printf("(latencies in us; x = kernel / bypass)\n");
+    }
+
+    for (int b = 0; b < nbackends; b++)
+        for (int s = 0; s < nsteps; s++)
+            free(results[b][s].hist);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "results_sink.h"
+
+/*
+ * Convert a results_sink file (udp_exp --results, udp_mt_client --results,
+ * server_ts -r) to CSV. Values are scaled to the unit recorded in the file
+ * header unless --raw is given. Reads in fixed blocks, so a file from a
+ * multi-hour run converts in constant memory.
+ */
+#define DUMP_BLOCK  4096    /* records per read */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--out FILE] [--stream N] [--raw] [--info] FILE\n"
+                    "  --out     write CSV here instead of stdout\n"
+                    "  --stream  only records from stream N\n"
+                    "  --raw     print stored integers instead of scaled values\n"
+                    "  --info    print the file header and exit\n", prog);
+}
+
+static void print_value(FILE *f, const struct results_file_hdr *hdr, uint64_t v, bool raw)
+{
+    if (raw || hdr->scale == 1.0)
+        fprintf(f, "%llu", (unsigned long long)v);
+    else
+        fprintf(f, "%.3f", (double)v * hdr->scale);
+}
+
+int main(int argc, char **argv)
+{
+    const char *prog = argv[0];
+    const char *path = NULL, *out = NULL;
+    bool raw = false, info = false;
+    long stream = -1;
+    struct results_file_hdr hdr;
+    struct results_rec *block;
+    uint64_t left, written = 0, lost = 0;
+    FILE *in, *fout = stdout;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            stream = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--raw") == 0) {
+            raw = true;
+        }
+        else if (strcmp(argv[i], "--info") == 0) {
+            info = true;
+        }
+        else if (argv[i][0] == '-' || path) {
+            usage(prog);
+            return 1;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        usage(prog);
+        return 1;
+    }
+
+    in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != RESULTS_MAGIC) {
+        fprintf(stderr, "%s: not a results file\n", path);
+        return 1;
+    }
+    if (hdr.version != RESULTS_VERSION || hdr.rec_size != sizeof(struct results_rec)) {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n",
+                path, hdr.version, hdr.rec_size);
+        return 1;
+    }
+
+    /* The strings are fixed width and may fill their field */
+    hdr.unit[sizeof(hdr.unit) - 1] = '\0';
+    hdr.clock[RESULTS_NAME_LEN - 1] = '\0';
+    hdr.col_t[RESULTS_NAME_LEN - 1] = '\0';
+    hdr.col_value[RESULTS_NAME_LEN - 1] = '\0';
+    hdr.col_aux[RESULTS_NAME_LEN - 1] = '\0';
+
+    fprintf(stderr, "%s: %llu records, %llu dropped, clock %s, scale %g -> %s\n",
+            path, (unsigned long long)hdr.records, (unsigned long long)hdr.dropped,
+            hdr.clock[0] ? hdr.clock : "?", hdr.scale, hdr.unit[0] ? hdr.unit : "?");
+    if (info)
+        return 0;
+
+    block = malloc(DUMP_BLOCK * sizeof(*block));
+    if (!block) {
+        perror("malloc");
+        return 1;
+    }
+    if (out) {
+        fout = fopen(out, "w");
+        if (!fout) {
+            perror(out);
+            return 1;
+        }
+    }
+
+    /* Same shape as the other CSVs: name(unit) headers, -1 for a lost sample */
+    {
+        const char *u = raw ? "raw" : hdr.unit;
+
+        fprintf(fout, "stream,pkt_index,size(B),%s(%s),%s(%s)",
+                hdr.col_t, u, hdr.col_value, u);
+        if (hdr.col_aux[0])
+            fprintf(fout, ",%s(%s)", hdr.col_aux, u);
+        fprintf(fout, "\n");
+    }
+
+    left = hdr.records;
+    while (left) {
+        size_t want = left < DUMP_BLOCK ? (size_t)left : DUMP_BLOCK;
+        size_t got = fread(block, sizeof(*block), want, in);
+
+        for (size_t k = 0; k < got; k++) {
+            const struct results_rec *r = &block[k];
+
+            if (stream >= 0 && r->stream != stream)
+                continue;
+
+            fprintf(fout, "%u,%u,%u,", r->stream, r->seq, r->size);
+            print_value(fout, &hdr, r->t, raw);
+            if (r->flags & RESULTS_F_LOST) {
+                fprintf(fout, ",-1");
+                lost++;
+            } else {
+                fprintf(fout, ",");
+                print_value(fout, &hdr, r->value, raw);
+            }
+            if (hdr.col_aux[0]) {
+                fprintf(fout, ",");
+                print_value(fout, &hdr, r->aux, raw);
+            }
+            fprintf(fout, "\n");
+            written++;
+        }
+
+        if (got < want) {
+            fprintf(stderr, "%s: truncated after %llu records\n", path,
+                    (unsigned long long)(hdr.records - left + got));
+            break;
+        }
+        left -= got;
+    }
+
+    fclose(in);
+    free(block);
+    if (out) {
+        if (fclose(fout) != 0) {
+            perror(out);
+            return 1;
+        }
+        fprintf(stderr, "Wrote %llu rows (%llu lost) to %s\n",
+                (unsigned long long)written, (unsigned long long)lost, out);
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "results_sink.h"
+
+/* Records never straddle a chunk: the header and every chunk are whole records */
+_Static_assert(sizeof(struct results_rec) == 32, "results_rec is part of the file format");
+_Static_assert(sizeof(struct results_file_hdr) % sizeof(struct results_rec) == 0,
+               "header must be a whole number of records");
+_Static_assert(RESULTS_MAP_CHUNK % sizeof(struct results_rec) == 0,
+               "chunk must be a whole number of records");
+
+#define RESULTS_IDLE_NS     200000      /* writer nap when every ring is empty */
+
+struct results_sink {
+    int fd;
+    struct results_file_hdr hdr;
+    uint32_t ring_records;
+    int writer_cpu;
+
+    pthread_mutex_t lock;               /* stream registration */
+    struct results_stream *streams[RESULTS_MAX_STREAMS];
+    _Atomic uint32_t nstreams;
+
+    pthread_t writer;
+    _Atomic bool stop;
+
+    /* Writer state */
+    uint8_t *map;                       /* current chunk, or NULL */
+    uint64_t map_off;                   /* file offset of the chunk */
+    uint64_t pos;                       /* file offset of the next record */
+    uint64_t records;
+    bool io_error;
+};
+
+static void results_copy_name(char *dst, size_t len, const char *src)
+{
+    memset(dst, 0, len);
+    if (src)
+        strncpy(dst, src, len - 1);
+}
+
+static int results_write_hdr(struct results_sink *sink)
+{
+    sink->hdr.records = sink->records;
+    if (pwrite(sink->fd, &sink->hdr, sizeof(sink->hdr), 0) != (ssize_t)sizeof(sink->hdr))
+        return -1;
+    return 0;
+}
+
+/* Map the chunk holding sink->pos, growing the file to cover it */
+static int results_map_chunk(struct results_sink *sink)
+{
+    uint64_t off = sink->pos - sink->pos % RESULTS_MAP_CHUNK;
+    void *p;
+
+    if (sink->map) {
+        munmap(sink->map, RESULTS_MAP_CHUNK);
+        sink->map = NULL;
+    }
+    if (ftruncate(sink->fd, (off_t)(off + RESULTS_MAP_CHUNK)) != 0)
+        return -1;
+
+    p = mmap(NULL, RESULTS_MAP_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, sink->fd, (off_t)off);
+    if (p == MAP_FAILED)
+        return -1;
+
+    sink->map     = p;
+    sink->map_off = off;
+    return 0;
+}
+
+static void results_emit(struct results_sink *sink, const struct results_rec *recs, uint32_t n)
+{
+    while (n && !sink->io_error) {
+        uint64_t room;
+        uint32_t k;
+
+        if (!sink->map || sink->pos >= sink->map_off + RESULTS_MAP_CHUNK) {
+            if (results_map_chunk(sink) != 0) {
+                perror("results_sink");
+                sink->io_error = true;
+                return;
+            }
+        }
+
+        room = (sink->map_off + RESULTS_MAP_CHUNK - sink->pos) / sizeof(*recs);
+        k = n < room ? n : (uint32_t)room;
+        memcpy(sink->map + (sink->pos - sink->map_off), recs, (size_t)k * sizeof(*recs));
+        sink->pos     += (uint64_t)k * sizeof(*recs);
+        sink->records += k;
+        recs += k;
+        n    -= k;
+    }
+}
+
+/* Move everything currently in one ring to the file; returns records moved */
+static uint32_t results_drain(struct results_sink *sink, struct results_stream *st)
+{
+    uint32_t tail = atomic_load_explicit(&st->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&st->head, memory_order_acquire);
+    uint32_t n = head - tail;
+    uint32_t first, run;
+
+    if (!n)
+        return 0;
+
+    /* At most two runs: up to the end of the ring, then from its start */
+    first = tail & st->mask;
+    run   = st->mask + 1 - first;
+    if (run > n)
+        run = n;
+    results_emit(sink, &st->recs[first], run);
+    if (n > run)
+        results_emit(sink, &st->recs[0], n - run);
+
+    atomic_store_explicit(&st->tail, head, memory_order_release);
+    return n;
+}
+
+static void *results_writer_fn(void *arg)
+{
+    struct results_sink *sink = arg;
+    const struct timespec nap = { 0, RESULTS_IDLE_NS };
+    bool dirty = false;
+
+    if (sink->writer_cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(sink->writer_cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "results_sink: cannot pin writer to cpu %d\n", sink->writer_cpu);
+    }
+
+    for (;;) {
+        /* Read stop first: a pass that starts after it sees every final push */
+        bool stopping = atomic_load(&sink->stop);
+        uint32_t nstreams = atomic_load(&sink->nstreams);
+        uint64_t moved = 0;
+
+        for (uint32_t i = 0; i < nstreams; i++)
+            moved += results_drain(sink, sink->streams[i]);
+
+        if (moved) {
+            dirty = true;
+            continue;
+        }
+        if (stopping)
+            break;
+
+        /* Idle: make what is on disk so far readable after a crash */
+        if (dirty && !sink->io_error) {
+            results_write_hdr(sink);
+            dirty = false;
+        }
+        nanosleep(&nap, NULL);
+    }
+    return NULL;
+}
+
+struct results_sink *results_sink_open(const char *path, const struct results_sink_cfg *cfg)
+{
+    struct results_sink *sink = calloc(1, sizeof(*sink));
+    uint32_t ring = cfg->ring_records ? cfg->ring_records : RESULTS_RING_DEFAULT;
+    int err;
+
+    if (!sink) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    sink->ring_records = 1;
+    while (sink->ring_records < ring)
+        sink->ring_records <<= 1;
+    sink->writer_cpu = cfg->writer_cpu;
+
+    sink->hdr.magic    = RESULTS_MAGIC;
+    sink->hdr.version  = RESULTS_VERSION;
+    sink->hdr.rec_size = sizeof(struct results_rec);
+    sink->hdr.scale    = cfg->scale > 0.0 ? cfg->scale : 1.0;
+    results_copy_name(sink->hdr.unit,      sizeof(sink->hdr.unit),      cfg->unit);
+    results_copy_name(sink->hdr.clock,     sizeof(sink->hdr.clock),     cfg->clock);
+    results_copy_name(sink->hdr.col_t,     sizeof(sink->hdr.col_t),     cfg->col_t ? cfg->col_t : "t");
+    results_copy_name(sink->hdr.col_value, sizeof(sink->hdr.col_value), cfg->col_value ? cfg->col_value : "value");
+    results_copy_name(sink->hdr.col_aux,   sizeof(sink->hdr.col_aux),   cfg->col_aux);
+    sink->pos = sizeof(sink->hdr);
+
+    sink->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (sink->fd < 0) {
+        err = errno;
+        goto fail;
+    }
+    if (results_write_hdr(sink) != 0) {
+        err = errno;
+        goto fail_fd;
+    }
+
+    pthread_mutex_init(&sink->lock, NULL);
+    err = pthread_create(&sink->writer, NULL, results_writer_fn, sink);
+    if (err) {
+        pthread_mutex_destroy(&sink->lock);
+        goto fail_fd;
+    }
+    return sink;
+
+fail_fd:
+    close(sink->fd);
+    unlink(path);
+fail:
+    free(sink);
+    errno = err;
+    return NULL;
+}
+
+struct results_stream *results_sink_stream(struct results_sink *sink)
+{
+    struct results_stream *st;
+    uint32_t n;
+
+    pthread_mutex_lock(&sink->lock);
+    n = atomic_load(&sink->nstreams);
+    if (n == RESULTS_MAX_STREAMS) {
+        pthread_mutex_unlock(&sink->lock);
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    if (posix_memalign((void **)&st, 64, sizeof(*st)) != 0) {
+        pthread_mutex_unlock(&sink->lock);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(st, 0, sizeof(*st));
+    st->mask = sink->ring_records - 1;
+    if (posix_memalign((void **)&st->recs, 64, (size_t)sink->ring_records * sizeof(*st->recs)) != 0) {
+        free(st);
+        pthread_mutex_unlock(&sink->lock);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* Publish after the stream is fully built; the writer picks it up next pass */
+    sink->streams[n] = st;
+    atomic_store(&sink->nstreams, n + 1);
+    pthread_mutex_unlock(&sink->lock);
+    return st;
+}
+
+int64_t results_sink_close(struct results_sink *sink)
+{
+    uint32_t nstreams;
+    int64_t ret;
+
+    atomic_store(&sink->stop, true);
+    pthread_join(sink->writer, NULL);
+
+    if (sink->map)
+        munmap(sink->map, RESULTS_MAP_CHUNK);
+
+    nstreams = atomic_load(&sink->nstreams);
+    for (uint32_t i = 0; i < nstreams; i++) {
+        sink->hdr.dropped += sink->streams[i]->dropped;
+        free(sink->streams[i]->recs);
+        free(sink->streams[i]);
+    }
+
+    if (sink->io_error ||
+        results_write_hdr(sink) != 0 ||
+        ftruncate(sink->fd, (off_t)sink->pos) != 0) {
+        ret = -1;
+    } else {
+        ret = (int64_t)sink->records;
+    }
+    if (sink->hdr.dropped)
+        fprintf(stderr, "results_sink: dropped %llu records (rings full)\n",
+                (unsigned long long)sink->hdr.dropped);
+
+    close(sink->fd);
+    pthread_mutex_destroy(&sink->lock);
+    free(sink);
+    return ret;
+}
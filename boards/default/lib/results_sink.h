@@ -0,0 +1,118 @@
+#ifndef __RESULTS_SINK_H
+#define __RESULTS_SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Streaming binary results file for long runs.
+ *
+ * Each measuring thread owns a results_stream: a single-producer ring of
+ * fixed-size records. results_push() is a copy and a release store. It does
+ * no formatting, locking or syscalls, and it never blocks. If the ring is
+ * full, the record is dropped and counted. One writer thread drains every
+ * stream into the file. It maps the file one RESULTS_MAP_CHUNK at a time,
+ * growing it with ftruncate as it goes. Memory stays bounded by the rings
+ * plus one mapped chunk, however long the run.
+ *
+ * Records from different streams interleave in drain order; sort on
+ * (stream, seq) if order matters. results_dump turns a file into CSV.
+ *
+ * File layout: struct results_file_hdr, then records back to back. The
+ * writer refreshes the header's record count whenever it goes idle and
+ * again on close. A crashed run keeps everything up to the last refresh;
+ * readers ignore bytes past the count.
+ */
+#define RESULTS_MAGIC           0x31534552u     /* "RES1" little-endian */
+#define RESULTS_VERSION         1
+#define RESULTS_MAP_CHUNK       (4u << 20)      /* bytes mapped at a time */
+#define RESULTS_RING_DEFAULT    8192            /* records per stream */
+#define RESULTS_MAX_STREAMS     256
+#define RESULTS_NAME_LEN        16
+
+/* Record flags */
+#define RESULTS_F_LOST          0x0001          /* no reply: value is meaningless */
+
+struct results_rec {
+    uint32_t seq;           /* sample index within the stream */
+    uint16_t stream;        /* thread, port or row; caller's choice */
+    uint16_t flags;
+    uint32_t size;          /* payload bytes */
+    uint32_t aux;           /* secondary value, e.g. network time */
+    uint64_t t;             /* when, in the file's units */
+    uint64_t value;         /* primary value, e.g. RTT */
+};
+
+struct results_file_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;
+    uint64_t records;       /* valid records after the header */
+    uint64_t dropped;       /* records lost to full rings */
+    double   scale;         /* stored value * scale = value in @unit */
+    char     unit[8];       /* "us", "ns", ... */
+    char     clock[RESULTS_NAME_LEN];
+    char     col_t[RESULTS_NAME_LEN];
+    char     col_value[RESULTS_NAME_LEN];
+    char     col_aux[RESULTS_NAME_LEN];     /* empty: no aux column */
+    uint8_t  rsvd[24];
+};
+
+struct results_sink_cfg {
+    double      scale;
+    const char *unit;
+    const char *clock;
+    const char *col_t, *col_value, *col_aux;
+    uint32_t    ring_records;   /* per stream, rounded up to a power of two; 0 = default */
+    int         writer_cpu;     /* pin the writer; -1 leaves it alone */
+};
+
+struct results_stream {
+    _Atomic uint32_t head;                          /* producer */
+    uint8_t          pad0[60];
+    _Atomic uint32_t tail;                          /* writer */
+    uint8_t          pad1[60];
+    uint32_t         mask;
+    uint64_t         dropped;                       /* producer only */
+    struct results_rec *recs;
+};
+
+struct results_sink;
+
+/* Create @path and start the writer thread. NULL (and errno) on failure */
+struct results_sink *results_sink_open(const char *path, const struct results_sink_cfg *cfg);
+
+/* Add a producer stream. Call from any thread, before or while the writer runs */
+struct results_stream *results_sink_stream(struct results_sink *sink);
+
+/*
+ * Stop the writer after it drains every stream, write the final header and
+ * truncate the file to its records. Producers must be done. Returns the
+ * number of records written, or -1 on an I/O error.
+ */
+int64_t results_sink_close(struct results_sink *sink);
+
+static inline bool results_push(struct results_stream *st, const struct results_rec *r)
+{
+    uint32_t head = atomic_load_explicit(&st->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&st->tail, memory_order_acquire);
+
+    if (head - tail > st->mask) {
+        st->dropped++;
+        return false;
+    }
+    st->recs[head & st->mask] = *r;
+    atomic_store_explicit(&st->head, head + 1, memory_order_release);
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RESULTS_SINK_H */
@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#include "ring_copy.h"
+
+#if defined(__riscv) && (__riscv_xlen == 64)
+#define RING_COPY_HAVE_RVV_ASM 1
+#endif
+
+/* Below this the vsetvli round trip costs more than it saves */
+#define RING_COPY_VEC_MIN   32
+
+/* Biggest chunk one e32 accumulator lane can sum without overflowing */
+#define RING_CSUM_CHUNK     (64 * 1024)
+
+typedef uint64_t __attribute__((may_alias)) ring_word_t;
+
+/* ===================================================================== */
+/* ===========================  Scalar kernels  ======================== */
+/* ===================================================================== */
+
+static inline uint64_t _csum_add(uint64_t sum, uint64_t w)
+{
+    sum += w;
+    return sum + (sum < w);     /* end-around carry */
+}
+
+static inline uint16_t _csum_fold(uint64_t sum)
+{
+    sum = (sum & 0xffffffffULL) + (sum >> 32);
+    sum = (sum & 0xffffffffULL) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static void *_ring_copy_scalar(void *dst, const void *src, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+    /* Align the destination; ring offsets are normally 64B aligned already */
+    while (len && ((uintptr_t)d & 7)) {
+        *d++ = *s++;
+        len--;
+    }
+
+    if (((uintptr_t)s & 7) == 0) {
+        ring_word_t *dw = (ring_word_t *)d;
+        const ring_word_t *sw = (const ring_word_t *)s;
+
+        for (; len >= 32; len -= 32, dw += 4, sw += 4) {
+            uint64_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+            dw[0] = a; dw[1] = b; dw[2] = c; dw[3] = e;
+        }
+        for (; len >= 8; len -= 8)
+            *dw++ = *sw++;
+        d = (uint8_t *)dw;
+        s = (const uint8_t *)sw;
+    } else {
+        for (; len >= 8; len -= 8, d += 8, s += 8) {
+            uint64_t w;
+            memcpy(&w, s, 8);
+            *(ring_word_t *)d = w;
+        }
+    }
+
+    while (len--)
+        *d++ = *s++;
+    return dst;
+}
+
+/*
+ * Words are taken at 8-byte offsets from the start of the buffer, so the
+ * byte pairing of the 16-bit sum does not depend on alignment.
+ */
+static uint16_t _ring_copy_csum_scalar(void *dst, const void *src, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint64_t sum = 0, w;
+
+    if ((((uintptr_t)d | (uintptr_t)s) & 7) == 0) {
+        ring_word_t *dw = (ring_word_t *)d;
+        const ring_word_t *sw = (const ring_word_t *)s;
+
+        for (; len >= 8; len -= 8) {
+            w = *sw++;
+            *dw++ = w;
+            sum = _csum_add(sum, w);
+        }
+        d = (uint8_t *)dw;
+        s = (const uint8_t *)sw;
+    } else {
+        for (; len >= 8; len -= 8, d += 8, s += 8) {
+            memcpy(&w, s, 8);
+            memcpy(d, &w, 8);
+            sum = _csum_add(sum, w);
+        }
+    }
+
+    if (len) {
+        w = 0;
+        memcpy(&w, s, len);     /* zero padded, as RFC 1071 asks */
+        memcpy(d, s, len);
+        sum = _csum_add(sum, w);
+    }
+    return _csum_fold(sum);
+}
+
+uint16_t ring_csum(const void *src, size_t len)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    uint64_t sum = 0, w;
+
+    for (; len >= 8; len -= 8, s += 8) {
+        memcpy(&w, s, 8);
+        sum = _csum_add(sum, w);
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, s, len);
+        sum = _csum_add(sum, w);
+    }
+    return _csum_fold(sum);
+}
+
+/* ===================================================================== */
+/* ========================  RISC-V Vector kernels  ==================== */
+/* ===================================================================== */
+/*
+ * The apps are built for rv64gc, so the V instructions are enabled for
+ * these blocks only and the kernels are never entered unless AT_HWCAP
+ * reports V. A build with V in -march lets the compiler keep values in
+ * vector registers, so there the blocks declare what they overwrite; the
+ * names are unknown to a compiler without V, hence the macros.
+ */
+#ifdef RING_COPY_HAVE_RVV_ASM
+
+#ifdef __riscv_vector
+#define RVV_COPY_CLOBBERS   , "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "vl", "vtype"
+#define RVV_CSUM_CLOBBERS   , "v0", "v1", "v2", "v3", "v8", "v9", "v10", "v11", \
+                              "v12", "v13", "v14", "v15", "v16", "vl", "vtype"
+#else
+#define RVV_COPY_CLOBBERS
+#define RVV_CSUM_CLOBBERS
+#endif
+
+static void *_ring_copy_rvv(void *dst, const void *src, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    size_t vl;
+
+    if (len < RING_COPY_VEC_MIN)
+        return _ring_copy_scalar(dst, src, len);
+
+    __asm__ volatile(
+        ".option push\n\t"
+        ".option arch, +v\n"
+        "1:\n\t"
+        "vsetvli  %[vl], %[n], e8, m8, ta, ma\n\t"
+        "vle8.v   v0, (%[s])\n\t"
+        "vse8.v   v0, (%[d])\n\t"
+        "sub      %[n], %[n], %[vl]\n\t"
+        "add      %[s], %[s], %[vl]\n\t"
+        "add      %[d], %[d], %[vl]\n\t"
+        "bnez     %[n], 1b\n\t"
+        ".option pop"
+        : [vl] "=&r"(vl), [n] "+r"(len), [s] "+r"(src), [d] "+r"(d)
+        :
+        : "memory" RVV_COPY_CLOBBERS);
+    return dst;
+}
+
+/*
+ * Copy @len (even, <= RING_CSUM_CHUNK) bytes as 16-bit elements, widening
+ * each element into a per-lane e32 accumulator, then reduce the lanes into
+ * one 64-bit sum. The loop runs tail-undisturbed so the short final pass
+ * leaves the upper lanes' partial sums alone.
+ */
+static uint64_t _ring_copy_csum_rvv_chunk(uint8_t *d, const uint8_t *s, size_t len)
+{
+    size_t n = len >> 1, vl;
+    uint64_t sum;
+
+    __asm__ volatile(
+        ".option push\n\t"
+        ".option arch, +v\n\t"
+        "vsetvli  t0, zero, e32, m8, ta, ma\n\t"
+        "vmv.v.i  v8, 0\n"
+        "1:\n\t"
+        "vsetvli  %[vl], %[n], e16, m4, tu, ma\n\t"
+        "vle16.v  v0, (%[s])\n\t"
+        "vse16.v  v0, (%[d])\n\t"
+        "vwaddu.wv v8, v8, v0\n\t"
+        "sub      %[n], %[n], %[vl]\n\t"
+        "slli     %[vl], %[vl], 1\n\t"
+        "add      %[s], %[s], %[vl]\n\t"
+        "add      %[d], %[d], %[vl]\n\t"
+        "bnez     %[n], 1b\n\t"
+        "vsetivli zero, 1, e64, m1, ta, ma\n\t"
+        "vmv.s.x  v16, zero\n\t"
+        "vsetvli  t0, zero, e32, m8, ta, ma\n\t"
+        "vwredsumu.vs v16, v8, v16\n\t"
+        "vsetivli zero, 1, e64, m1, ta, ma\n\t"
+        "vmv.x.s  %[sum], v16\n\t"
+        ".option pop"
+        : [vl] "=&r"(vl), [n] "+r"(n), [s] "+r"(s), [d] "+r"(d), [sum] "=r"(sum)
+        :
+        : "t0", "memory" RVV_CSUM_CLOBBERS);
+    return sum;
+}
+
+static uint16_t _ring_copy_csum_rvv(void *dst, const void *src, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint64_t sum = 0;
+
+    if (len < RING_COPY_VEC_MIN)
+        return _ring_copy_csum_scalar(dst, src, len);
+
+    while (len >= 2) {
+        size_t n = len & ~(size_t)1;
+
+        if (n > RING_CSUM_CHUNK)
+            n = RING_CSUM_CHUNK;
+        sum = _csum_add(sum, _ring_copy_csum_rvv_chunk(d, s, n));
+        d += n; s += n; len -= n;
+    }
+    if (len) {
+        uint16_t w = 0;
+
+        memcpy(&w, s, 1);
+        *d = *s;
+        sum = _csum_add(sum, w);
+    }
+    return _csum_fold(sum);
+}
+
+#endif /* RING_COPY_HAVE_RVV_ASM */
+
+/* ===================================================================== */
+/* =============================  Dispatch  ============================ */
+/* ===================================================================== */
+
+static void    *(*ring_copy_fn)(void *, const void *, size_t)      = _ring_copy_scalar;
+static uint16_t (*ring_copy_csum_fn)(void *, const void *, size_t) = _ring_copy_csum_scalar;
+static enum ring_copy_impl ring_copy_impl = RING_COPY_SCALAR;
+
+int ring_copy_have_rvv(void)
+{
+#if defined(RING_COPY_HAVE_RVV_ASM) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & (1UL << ('V' - 'A'))) != 0;
+#else
+    return 0;
+#endif
+}
+
+int ring_copy_select(enum ring_copy_impl impl)
+{
+    if (impl == RING_COPY_AUTO)
+        impl = ring_copy_have_rvv() ? RING_COPY_RVV : RING_COPY_SCALAR;
+
+    switch (impl) {
+    case RING_COPY_SCALAR:
+        ring_copy_fn      = _ring_copy_scalar;
+        ring_copy_csum_fn = _ring_copy_csum_scalar;
+        break;
+#ifdef RING_COPY_HAVE_RVV_ASM
+    case RING_COPY_RVV:
+        if (!ring_copy_have_rvv())
+            return -1;
+        ring_copy_fn      = _ring_copy_rvv;
+        ring_copy_csum_fn = _ring_copy_csum_rvv;
+        break;
+#endif
+    default:
+        return -1;
+    }
+    ring_copy_impl = impl;
+    return 0;
+}
+
+enum ring_copy_impl ring_copy_current(void)
+{
+    return ring_copy_impl;
+}
+
+const char *ring_copy_name(enum ring_copy_impl impl)
+{
+    switch (impl) {
+    case RING_COPY_AUTO:   return "auto";
+    case RING_COPY_SCALAR: return "scalar";
+    case RING_COPY_RVV:    return "rvv";
+    }
+    return "?";
+}
+
+/* Pick the kernel once, before main() and any ring traffic */
+__attribute__((constructor))
+static void _ring_copy_init(void)
+{
+    ring_copy_select(RING_COPY_AUTO);
+}
+
+void *ring_copy(void *dst, const void *src, size_t len)
+{
+    return ring_copy_fn(dst, src, len);
+}
+
+uint16_t ring_copy_csum(void *dst, const void *src, size_t len)
+{
+    return ring_copy_csum_fn(dst, src, len);
+}
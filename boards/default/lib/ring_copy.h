@@ -0,0 +1,44 @@
+#ifndef __RING_COPY_H
+#define __RING_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Copy kernels for UDP ring payloads.
+ *
+ * Ring buffers are DMA memory mapped from the driver, so byte-at-a-time
+ * access is expensive. A RISC-V Vector (RVV 1.0) kernel is chosen at first
+ * use when the kernel reports the V extension in AT_HWCAP. Otherwise a
+ * scalar kernel that moves 64-bit words is used.
+ *
+ * ring_copy_csum() copies and computes the 16-bit one's complement sum of
+ * the bytes in the same pass. The sum is in host byte order; fold it and
+ * byte-swap it as RFC 1071 describes to compare it with an on-wire
+ * checksum.
+ */
+enum ring_copy_impl {
+    RING_COPY_AUTO = 0,
+    RING_COPY_SCALAR,
+    RING_COPY_RVV,
+};
+
+void    *ring_copy(void *dst, const void *src, size_t len);
+uint16_t ring_copy_csum(void *dst, const void *src, size_t len);
+uint16_t ring_csum(const void *src, size_t len);
+
+/* Pin a kernel (benchmarks). Returns -1 if the CPU cannot run it. */
+int ring_copy_select(enum ring_copy_impl impl);
+enum ring_copy_impl ring_copy_current(void);
+const char *ring_copy_name(enum ring_copy_impl impl);
+int ring_copy_have_rvv(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RING_COPY_H */
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sched.h>
+
+#include "iocache_lib.h"
+#include "ring_copy.h"
+
+/*
+ * Micro-benchmark for the ring copy kernels.
+ *
+ * Times memcpy, the scalar and RVV ring_copy kernels, and the fused
+ * copy+checksum variants, for every power-of-two size between --min and
+ * --max (64 B .. 64 KB by default, the range udp_exp --payload-size
+ * accepts). With --ring the copies run RX ring -> TX ring of a reserved
+ * iocache row, as on the echo path. Sizes above the ring size are skipped.
+ */
+
+#define DEFAULT_MIN     64
+#define DEFAULT_MAX     (64 * 1024)
+#define DEFAULT_ITERS   2000
+
+enum bench_kind {
+    BENCH_MEMCPY,
+    BENCH_COPY_SCALAR,
+    BENCH_COPY_RVV,
+    BENCH_CSUM_SCALAR,
+    BENCH_CSUM_RVV,
+    BENCH_COUNT,
+};
+
+static const char *bench_names[BENCH_COUNT] = {
+    "memcpy", "scalar", "rvv", "csum-scalar", "csum-rvv",
+};
+
+static volatile uint16_t g_csum_sink;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [--min BYTES] [--max BYTES] [--iters N] [--cpu N] [--ring [ROW]]\n"
+        "Defaults: --min %d, --max %d, --iters %d\n",
+        prog, DEFAULT_MIN, DEFAULT_MAX, DEFAULT_ITERS);
+}
+
+/* Average ns per call, or -1 when the kernel is not available here */
+static double run_one(enum bench_kind kind, uint8_t *dst, const uint8_t *src, size_t len, uint32_t iters)
+{
+    enum ring_copy_impl impl = RING_COPY_SCALAR;
+    uint64_t t0, t1;
+
+    if (kind == BENCH_COPY_RVV || kind == BENCH_CSUM_RVV)
+        impl = RING_COPY_RVV;
+    if (kind != BENCH_MEMCPY && ring_copy_select(impl) != 0)
+        return -1;
+
+    /* Warm up caches/TLB outside the timed loop */
+    memcpy(dst, src, len);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < iters; i++) {
+        switch (kind) {
+        case BENCH_MEMCPY:
+            memcpy(dst, src, len);
+            break;
+        case BENCH_COPY_SCALAR:
+        case BENCH_COPY_RVV:
+            ring_copy(dst, src, len);
+            break;
+        default:
+            g_csum_sink = ring_copy_csum(dst, src, len);
+            break;
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+    t1 = now_ns();
+
+    return (double)(t1 - t0) / iters;
+}
+
+/* Every kernel must produce the same bytes and the same sum */
+static bool verify(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    static const enum ring_copy_impl impls[] = { RING_COPY_SCALAR, RING_COPY_RVV };
+    uint16_t ref = ring_csum(src, len);
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (ring_copy_select(impls[i]) != 0)
+            continue;
+
+        memset(dst, 0, len);
+        ring_copy(dst, src, len);
+        if (memcmp(dst, src, len) != 0) {
+            fprintf(stderr, "%s copy mismatch at %zu B\n", ring_copy_name(impls[i]), len);
+            return false;
+        }
+
+        memset(dst, 0, len);
+        if (ring_copy_csum(dst, src, len) != ref || memcmp(dst, src, len) != 0) {
+            fprintf(stderr, "%s copy+csum mismatch at %zu B\n", ring_copy_name(impls[i]), len);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t min = DEFAULT_MIN, max = DEFAULT_MAX;
+    uint32_t iters = DEFAULT_ITERS;
+    int cpu = -1;
+    bool use_ring = false;
+    int ring = IOCACHE_ROW_ANY;
+    char *iocache_filename = "/dev/iocache-misc";
+
+    struct iocache_info iocache;
+    uint8_t *src, *dst;
+    size_t limit;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            min = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            max = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            iters = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ring") == 0) {
+            use_ring = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                ring = atoi(argv[++i]);
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (min == 0 || max < min || iters == 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            perror("sched_setaffinity");
+    }
+
+    if (use_ring) {
+        if (iocache_open(iocache_filename, &iocache, ring) != 0)
+            return -1;
+        src   = (uint8_t *)iocache.udp_rx_buffer;
+        dst   = (uint8_t *)iocache.udp_tx_buffer;
+        limit = iocache.udp_rx_size < iocache.udp_tx_size ? iocache.udp_rx_size : iocache.udp_tx_size;
+    } else {
+        if (posix_memalign((void **)&src, 64, max) != 0 || posix_memalign((void **)&dst, 64, max) != 0) {
+            perror("posix_memalign");
+            return -1;
+        }
+        limit = max;
+    }
+
+    srand(1);
+    for (size_t i = 0; i < (max < limit ? max : limit); i++)
+        src[i] = (uint8_t)rand();
+
+    printf("memory=%s  rvv=%s  iters=%u\n", use_ring ? "dma-ring" : "heap",
+           ring_copy_have_rvv() ? "yes" : "no", iters);
+    printf("%8s", "bytes");
+    for (int k = 0; k < BENCH_COUNT; k++)
+        printf("  %12s", bench_names[k]);
+    printf("   (ns/call; MB/s for the fastest copy)\n");
+
+    for (size_t len = min; len <= max; len <<= 1) {
+        double best = -1;
+
+        if (len > limit) {
+            printf("%8zu  skipped (ring is %zu B)\n", len, limit);
+            continue;
+        }
+        if (!verify(dst, src, len))
+            return 1;
+
+        printf("%8zu", len);
+        for (int k = 0; k < BENCH_COUNT; k++) {
+            double ns = run_one((enum bench_kind)k, dst, src, len, iters);
+
+            if (ns < 0) {
+                printf("  %12s", "n/a");
+                continue;
+            }
+            printf("  %12.1f", ns);
+            if (k <= BENCH_COPY_RVV && (best < 0 || ns < best))
+                best = ns;
+        }
+        printf("   %.1f MB/s\n", best > 0 ? len / best * 1e3 : 0.0);
+    }
+
+    ring_copy_select(RING_COPY_AUTO);
+
+    if (use_ring) {
+        iocache_close(&iocache);
+    } else {
+        free(src);
+        free(dst);
+    }
+    return 0;
+}
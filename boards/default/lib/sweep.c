@@ -0,0 +1,734 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "hdr_hist.h"
+#include "results_sink.h"
+
+/*
+ * Config-driven parameter sweep with repeat-until-converged points.
+ *
+ * The config names a command template and the axes to sweep. Every
+ * combination of axis values is one point. Each point runs at least
+ * min_reps times and at most max_reps times. It stops early once the 95%
+ * confidence interval of every converge metric is within ci of its mean.
+ * Each rep gets its own directory. The command leaves its samples there,
+ * in one of two forms:
+ *
+ *   {results}  a results_sink file (udp_exp --results, udp_mt_client
+ *              --results). Latency comes from the records. Throughput is
+ *              the good records over the span of their timestamps.
+ *   {histdir}  one or more hdr_hist files (*.hist; udp_exp --hist-out,
+ *              net_bench --hist-dir). They are merged. Throughput is
+ *              samples over the command's wall time, so keep runs long
+ *              enough that process start-up does not count.
+ *
+ * Config file, one "key = value" per line, # starts a comment:
+ *
+ *   command     = ./net_bench --backend {backend} --payload-sizes {payload} --skip-file --hist-dir {histdir}
+ *   axis backend = kernel,bypass
+ *   axis payload = 64,256,1024,1472
+ *   min_reps    = 3            (default 3)
+ *   max_reps    = 10           (default 10)
+ *   ci          = 0.05         relative CI half-width to stop at (default 0.05)
+ *   converge    = p50,tput     any of p50, p99, tput (default p50,tput)
+ *   scale       = 0.001        hist value -> unit; results files carry their own
+ *   unit        = us
+ *   workdir     = sweep-runs   per-rep logs and samples
+ *   out         = sweep.csv    one summary row per point
+ *   cooldown_ms = 0            pause between reps
+ *
+ * Placeholders: {<axis name>}, {histdir}, {results}, {point}, {rep}.
+ * Every rep also lands in <workdir>/reps.csv, so a point can be audited
+ * or re-aggregated later.
+ */
+
+#define MAX_AXES        8
+#define MAX_VALUES      32
+#define MAX_REPS        100
+#define LINE_MAX_LEN    1024
+#define CMD_MAX_LEN     4096
+
+enum { M_P50 = 0, M_P99, M_TPUT, M_COUNT };
+static const char *g_metric_names[M_COUNT] = { "p50", "p99", "tput" };
+
+struct axis {
+    char name[32];
+    int  nvalues;
+    char *values[MAX_VALUES];
+};
+
+struct sweep_cfg {
+    char command[LINE_MAX_LEN];
+    struct axis axes[MAX_AXES];
+    int  naxes;
+    int  min_reps, max_reps;
+    double ci;
+    bool converge[M_COUNT];
+    double scale;
+    char unit[16];
+    char workdir[256];
+    char out[256];
+    int  cooldown_ms;
+};
+
+struct rep_result {
+    double   m[M_COUNT];        /* p50/p99 in unit, tput in samples/s */
+    uint64_t samples;
+    uint64_t lost;
+};
+
+static volatile sig_atomic_t g_got_sigint = 0;    /* the signal, once one arrived */
+
+static void on_sigint(int signo)
+{
+    g_got_sigint = signo;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--dry-run] [--out FILE] CONFIG\n"
+                    "See the comment at the top of sweep.c for the config format.\n", prog);
+}
+
+static char *trim(char *s)
+{
+    char *e;
+
+    while (isspace((unsigned char)*s))
+        s++;
+    e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        *--e = '\0';
+    return s;
+}
+
+static int parse_axis(struct sweep_cfg *cfg, const char *name, char *list)
+{
+    struct axis *a;
+    char *save = NULL;
+
+    if (cfg->naxes == MAX_AXES) {
+        fprintf(stderr, "at most %d axes\n", MAX_AXES);
+        return -1;
+    }
+    a = &cfg->axes[cfg->naxes++];
+    snprintf(a->name, sizeof(a->name), "%s", name);
+
+    for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (a->nvalues == MAX_VALUES) {
+            fprintf(stderr, "axis %s: at most %d values\n", name, MAX_VALUES);
+            return -1;
+        }
+        a->values[a->nvalues] = strdup(trim(tok));
+        if (!a->values[a->nvalues])
+            return -1;
+        a->nvalues++;
+    }
+    if (a->nvalues == 0) {
+        fprintf(stderr, "axis %s has no values\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+static int load_config(const char *path, struct sweep_cfg *cfg)
+{
+    char line[LINE_MAX_LEN];
+    FILE *f = fopen(path, "r");
+    int lineno = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->min_reps = 3;
+    cfg->max_reps = 10;
+    cfg->ci       = 0.05;
+    cfg->converge[M_P50]  = true;
+    cfg->converge[M_TPUT] = true;
+    cfg->scale    = 1.0;
+    snprintf(cfg->workdir, sizeof(cfg->workdir), "sweep-runs");
+    snprintf(cfg->out, sizeof(cfg->out), "sweep.csv");
+
+    while (fgets(line, sizeof(line), f)) {
+        char *key, *val, *eq, *hash;
+
+        lineno++;
+        /* A # starts a comment at the line start or after whitespace, so {x}#y survives */
+        for (hash = line; (hash = strchr(hash, '#')) != NULL; hash++) {
+            if (hash == line || isspace((unsigned char)hash[-1])) {
+                *hash = '\0';
+                break;
+            }
+        }
+        key = trim(line);
+        if (!*key)
+            continue;
+
+        eq = strchr(key, '=');
+        if (!eq) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        *eq = '\0';
+        key = trim(key);
+        val = trim(eq + 1);
+
+        if (strncmp(key, "axis", 4) == 0 && isspace((unsigned char)key[4])) {
+            if (parse_axis(cfg, trim(key + 4), val) != 0) {
+                fclose(f);
+                return -1;
+            }
+        }
+        else if (strcmp(key, "command") == 0) {
+            snprintf(cfg->command, sizeof(cfg->command), "%s", val);
+        }
+        else if (strcmp(key, "min_reps") == 0) {
+            cfg->min_reps = atoi(val);
+        }
+        else if (strcmp(key, "max_reps") == 0) {
+            cfg->max_reps = atoi(val);
+        }
+        else if (strcmp(key, "ci") == 0) {
+            cfg->ci = atof(val);
+        }
+        else if (strcmp(key, "converge") == 0) {
+            char *save = NULL;
+
+            memset(cfg->converge, 0, sizeof(cfg->converge));
+            for (char *tok = strtok_r(val, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+                int m;
+
+                tok = trim(tok);
+                for (m = 0; m < M_COUNT && strcmp(tok, g_metric_names[m]) != 0; m++)
+                    ;
+                if (m == M_COUNT) {
+                    fprintf(stderr, "%s:%d: unknown metric %s\n", path, lineno, tok);
+                    fclose(f);
+                    return -1;
+                }
+                cfg->converge[m] = true;
+            }
+        }
+        else if (strcmp(key, "scale") == 0) {
+            cfg->scale = atof(val);
+        }
+        else if (strcmp(key, "unit") == 0) {
+            snprintf(cfg->unit, sizeof(cfg->unit), "%s", val);
+        }
+        else if (strcmp(key, "workdir") == 0) {
+            snprintf(cfg->workdir, sizeof(cfg->workdir), "%s", val);
+        }
+        else if (strcmp(key, "out") == 0) {
+            snprintf(cfg->out, sizeof(cfg->out), "%s", val);
+        }
+        else if (strcmp(key, "cooldown_ms") == 0) {
+            cfg->cooldown_ms = atoi(val);
+        }
+        else {
+            fprintf(stderr, "%s:%d: unknown key %s\n", path, lineno, key);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+
+    if (!cfg->command[0]) {
+        fprintf(stderr, "%s: no command\n", path);
+        return -1;
+    }
+    if (cfg->min_reps < 1 || cfg->max_reps < cfg->min_reps || cfg->max_reps > MAX_REPS) {
+        fprintf(stderr, "%s: need 1 <= min_reps <= max_reps <= %d\n", path, MAX_REPS);
+        return -1;
+    }
+    return 0;
+}
+
+/* Expand the command for one rep; -1 on an unknown placeholder or overflow */
+static int expand(const struct sweep_cfg *cfg, const int *idx, const char *repdir,
+                  int point, int rep, char *out, size_t len)
+{
+    const char *s = cfg->command;
+    size_t n = 0;
+
+    while (*s) {
+        const char *val = NULL;
+        char num[16], path[512];
+        const char *end;
+        size_t klen, vlen;
+
+        if (*s != '{' || !(end = strchr(s, '}'))) {
+            if (n + 1 >= len)
+                return -1;
+            out[n++] = *s++;
+            continue;
+        }
+
+        klen = (size_t)(end - s - 1);
+        for (int a = 0; a < cfg->naxes; a++) {
+            if (strlen(cfg->axes[a].name) == klen && strncmp(s + 1, cfg->axes[a].name, klen) == 0)
+                val = cfg->axes[a].values[idx[a]];
+        }
+        if (!val && klen == 7 && strncmp(s + 1, "histdir", 7) == 0) {
+            val = repdir;
+        } else if (!val && klen == 7 && strncmp(s + 1, "results", 7) == 0) {
+            snprintf(path, sizeof(path), "%s/results.bin", repdir);
+            val = path;
+        } else if (!val && klen == 5 && strncmp(s + 1, "point", 5) == 0) {
+            snprintf(num, sizeof(num), "%d", point);
+            val = num;
+        } else if (!val && klen == 3 && strncmp(s + 1, "rep", 3) == 0) {
+            snprintf(num, sizeof(num), "%d", rep);
+            val = num;
+        }
+        if (!val) {
+            fprintf(stderr, "unknown placeholder %.*s\n", (int)(klen + 2), s);
+            return -1;
+        }
+
+        vlen = strlen(val);
+        if (n + vlen + 1 >= len)
+            return -1;
+        memcpy(out + n, val, vlen);
+        n += vlen;
+        s = end + 1;
+    }
+    out[n] = '\0';
+    return 0;
+}
+
+static double unit_to_sec(const char *unit)
+{
+    if (strcmp(unit, "ns") == 0) return 1e-9;
+    if (strcmp(unit, "us") == 0) return 1e-6;
+    if (strcmp(unit, "ms") == 0) return 1e-3;
+    if (strcmp(unit, "s")  == 0) return 1.0;
+    return 0.0;
+}
+
+/* Samples from a results_sink file; returns 0 and fills the span in file units */
+static int load_results(const char *path, struct hdr_hist *h, double *scale, char *unit, size_t ulen,
+                        uint64_t *span, uint64_t *lost)
+{
+    struct results_file_hdr hdr;
+    struct results_rec rec;
+    uint64_t tmin = UINT64_MAX, tmax = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+        return -1;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != RESULTS_MAGIC ||
+        hdr.rec_size != sizeof(rec)) {
+        fprintf(stderr, "%s: not a results file\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    *lost = 0;
+    for (uint64_t i = 0; i < hdr.records && fread(&rec, sizeof(rec), 1, f) == 1; i++) {
+        if (rec.flags & RESULTS_F_LOST) {
+            (*lost)++;
+            continue;
+        }
+        hdr_hist_record(h, rec.value);
+        if (rec.t < tmin) tmin = rec.t;
+        if (rec.t > tmax) tmax = rec.t;
+    }
+    fclose(f);
+
+    hdr.unit[sizeof(hdr.unit) - 1] = '\0';
+    *scale = hdr.scale;
+    snprintf(unit, ulen, "%s", hdr.unit);
+    *span = tmax > tmin ? tmax - tmin : 0;
+    return 0;
+}
+
+/* Merge every *.hist in @dir into @h; returns how many were read */
+static int load_hists(const char *dir, struct hdr_hist *h, struct hdr_hist *scratch)
+{
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    char path[768];
+    int n = 0;
+
+    if (!d)
+        return 0;
+    while ((de = readdir(d)) != NULL) {
+        size_t len = strlen(de->d_name);
+
+        if (len < 6 || strcmp(de->d_name + len - 5, ".hist") != 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (hdr_hist_load(scratch, path) != 0) {
+            perror(path);
+            continue;
+        }
+        hdr_hist_merge(h, scratch);
+        n++;
+    }
+    closedir(d);
+    return n;
+}
+
+/* Remove results.bin and *.hist left in @dir by an earlier run or retry */
+static void clear_results(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    char path[768];
+
+    if (!d)
+        return;
+    while ((de = readdir(d)) != NULL) {
+        size_t len = strlen(de->d_name);
+
+        if (strcmp(de->d_name, "results.bin") != 0 &&
+            (len < 6 || strcmp(de->d_name + len - 5, ".hist") != 0))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (unlink(path) != 0)
+            perror(path);
+    }
+    closedir(d);
+}
+
+/*
+ * system() without its signal handling: system() ignores SIGINT and SIGQUIT
+ * in the caller, so a Ctrl-C only killed the rep and the sweep went on. Here
+ * our handler stays armed, and a signal only we received is passed on.
+ */
+static int run_shell(const char *shell)
+{
+    bool forwarded = false;
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        execl("/bin/sh", "sh", "-c", shell, (char *)NULL);
+        _exit(127);
+    }
+
+    for (;;) {
+        if (g_got_sigint && !forwarded) {
+            kill(pid, g_got_sigint);
+            forwarded = true;
+        }
+        if (waitpid(pid, &status, 0) == pid)
+            return status;
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+static int run_rep(const struct sweep_cfg *cfg, const char *cmd, const char *repdir,
+                   struct hdr_hist *h, struct hdr_hist *scratch, struct rep_result *r, double *scale)
+{
+    char shell[CMD_MAX_LEN + 600], path[600], unit[16];
+    struct timespec t0, t1;
+    double wall, secs = 0.0;
+    uint64_t span = 0;
+    int status;
+
+    /* Rep directories are reused, so nothing stale may pass for this rep's output */
+    clear_results(repdir);
+    snprintf(shell, sizeof(shell), "%s > %s/log.txt 2>&1", cmd, repdir);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    status = run_shell(shell);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    /*
+     * Interrupted from the terminal: stop the sweep rather than retry the
+     * rep. sh reports a job killed by a signal as exit status 128 + signal.
+     */
+    if (status != -1) {
+        int sig = WIFSIGNALED(status) ? WTERMSIG(status) :
+                  WIFEXITED(status) && WEXITSTATUS(status) > 128 ? WEXITSTATUS(status) - 128 : 0;
+
+        if (sig == SIGINT || sig == SIGQUIT) {
+            if (!g_got_sigint)
+                g_got_sigint = sig;
+            fprintf(stderr, "  command interrupted, stopping\n");
+            return -1;
+        }
+    }
+
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "  command failed (status %d), see %s/log.txt\n", status, repdir);
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    hdr_hist_init(h);
+    *scale = cfg->scale;
+
+    snprintf(path, sizeof(path), "%s/results.bin", repdir);
+    if (access(path, R_OK) == 0) {
+        if (load_results(path, h, scale, unit, sizeof(unit), &span, &r->lost) != 0)
+            return -1;
+        if (cfg->unit[0] && strcmp(cfg->unit, unit) != 0)
+            fprintf(stderr, "  note: %s is in %s, not %s\n", path, unit, cfg->unit);
+        secs = span * *scale * unit_to_sec(unit);
+    } else if (load_hists(repdir, h, scratch) == 0) {
+        fprintf(stderr, "  no results.bin or *.hist in %s\n", repdir);
+        return -1;
+    }
+
+    /* Without a timestamped results file the command's wall time stands in */
+    if (secs <= 0.0)
+        secs = wall;
+
+    r->samples   = h->total;
+    r->m[M_P50]  = hdr_hist_percentile(h, 50.0) * *scale;
+    r->m[M_P99]  = hdr_hist_percentile(h, 99.0) * *scale;
+    r->m[M_TPUT] = secs > 0.0 ? h->total / secs : 0.0;
+    return 0;
+}
+
+/* Two-sided 95% Student t, df = n - 1 */
+static double t95(int n)
+{
+    static const double t[] = {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    int df = n - 1;
+
+    if (df < 1)
+        return INFINITY;
+    return df < (int)(sizeof(t) / sizeof(t[0])) ? t[df] : 1.96;
+}
+
+/* Mean and 95% CI half-width of one metric over the reps so far */
+static void mean_ci(const struct rep_result *reps, int n, int m, double *mean, double *hw)
+{
+    double sum = 0.0, ss = 0.0;
+
+    for (int i = 0; i < n; i++)
+        sum += reps[i].m[m];
+    *mean = n ? sum / n : 0.0;
+    for (int i = 0; i < n; i++)
+        ss += (reps[i].m[m] - *mean) * (reps[i].m[m] - *mean);
+    *hw = n > 1 ? t95(n) * sqrt(ss / (n - 1)) / sqrt((double)n) : INFINITY;
+}
+
+static bool converged(const struct sweep_cfg *cfg, const struct rep_result *reps, int n)
+{
+    for (int m = 0; m < M_COUNT; m++) {
+        double mean, hw;
+
+        if (!cfg->converge[m])
+            continue;
+        mean_ci(reps, n, m, &mean, &hw);
+        if (mean == 0.0 || hw / fabs(mean) > cfg->ci)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *prog = argv[0];
+    const char *config = NULL, *out_override = NULL;
+    bool dry_run = false;
+    struct sweep_cfg cfg;
+    struct hdr_hist *rep_hist, *pooled, *scratch;
+    struct rep_result reps[MAX_REPS];
+    int idx[MAX_AXES] = { 0 };
+    int npoints = 1;
+    char cmd[CMD_MAX_LEN], repdir[512], path[512];
+    FILE *summary, *replog;
+    struct sigaction sa;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dry-run") == 0) {
+            dry_run = true;
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_override = argv[++i];
+        }
+        else if (argv[i][0] == '-' || config) {
+            usage(prog);
+            return 1;
+        }
+        else {
+            config = argv[i];
+        }
+    }
+    if (!config) {
+        usage(prog);
+        return 1;
+    }
+    if (load_config(config, &cfg) != 0)
+        return 1;
+    if (out_override)
+        snprintf(cfg.out, sizeof(cfg.out), "%s", out_override);
+
+    for (int a = 0; a < cfg.naxes; a++)
+        npoints *= cfg.axes[a].nvalues;
+
+    /* Catch template typos before burning any run time */
+    if (expand(&cfg, idx, cfg.workdir, 0, 0, cmd, sizeof(cmd)) != 0)
+        return 1;
+
+    if (dry_run) {
+        for (int p = 0; p < npoints; p++) {
+            int rem = p;
+
+            for (int a = cfg.naxes - 1; a >= 0; a--) {
+                idx[a] = rem % cfg.axes[a].nvalues;
+                rem /= cfg.axes[a].nvalues;
+            }
+            snprintf(repdir, sizeof(repdir), "%s/p%03d-r00", cfg.workdir, p);
+            expand(&cfg, idx, repdir, p, 0, cmd, sizeof(cmd));
+            printf("%s\n", cmd);
+        }
+        printf("%d points, %d..%d reps each\n", npoints, cfg.min_reps, cfg.max_reps);
+        return 0;
+    }
+
+    rep_hist = malloc(sizeof(*rep_hist));
+    pooled   = malloc(sizeof(*pooled));
+    scratch  = malloc(sizeof(*scratch));
+    if (!rep_hist || !pooled || !scratch) {
+        perror("malloc");
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    mkdir(cfg.workdir, 0755);
+    snprintf(path, sizeof(path), "%s/reps.csv", cfg.workdir);
+    replog  = fopen(path, "w");
+    summary = fopen(cfg.out, "w");
+    if (!replog || !summary) {
+        perror(replog ? cfg.out : path);
+        return 1;
+    }
+
+    fprintf(replog, "point,rep");
+    fprintf(summary, "point");
+    for (int a = 0; a < cfg.naxes; a++) {
+        fprintf(replog, ",%s", cfg.axes[a].name);
+        fprintf(summary, ",%s", cfg.axes[a].name);
+    }
+    fprintf(replog, ",samples,lost,p50,p99,tput\n");
+    fprintf(summary, ",reps,converged,samples,tput,tput_ci,p50,p50_ci,p99,p99_ci,"
+                     "pooled_p50,pooled_p99,pooled_p99.9,pooled_max\n");
+
+    printf("%d points, %d..%d reps each, stop at +/-%.1f%% (95%% CI)\n\n",
+           npoints, cfg.min_reps, cfg.max_reps, cfg.ci * 100.0);
+
+    for (int p = 0; p < npoints && !g_got_sigint; p++) {
+        int rem = p, nreps = 0, failures = 0;
+        double scale = cfg.scale;
+        bool done = false;
+
+        for (int a = cfg.naxes - 1; a >= 0; a--) {
+            idx[a] = rem % cfg.axes[a].nvalues;
+            rem /= cfg.axes[a].nvalues;
+        }
+
+        printf("point %d/%d:", p + 1, npoints);
+        for (int a = 0; a < cfg.naxes; a++)
+            printf(" %s=%s", cfg.axes[a].name, cfg.axes[a].values[idx[a]]);
+        printf("\n");
+
+        hdr_hist_init(pooled);
+        /* A failing point gets as many tries as it would have reps, then is skipped */
+        for (int rep = 0; nreps < cfg.max_reps && failures < cfg.max_reps && !g_got_sigint; rep++) {
+            snprintf(repdir, sizeof(repdir), "%s/p%03d-r%02d", cfg.workdir, p, rep);
+            mkdir(repdir, 0755);
+            if (expand(&cfg, idx, repdir, p, rep, cmd, sizeof(cmd)) != 0)
+                return 1;
+
+            if (run_rep(&cfg, cmd, repdir, rep_hist, scratch, &reps[nreps], &scale) != 0) {
+                failures++;
+                continue;
+            }
+            hdr_hist_merge(pooled, rep_hist);
+
+            fprintf(replog, "%d,%d", p, rep);
+            for (int a = 0; a < cfg.naxes; a++)
+                fprintf(replog, ",%s", cfg.axes[a].values[idx[a]]);
+            fprintf(replog, ",%llu,%llu,%.3f,%.3f,%.1f\n",
+                    (unsigned long long)reps[nreps].samples, (unsigned long long)reps[nreps].lost,
+                    reps[nreps].m[M_P50], reps[nreps].m[M_P99], reps[nreps].m[M_TPUT]);
+            fflush(replog);
+
+            printf("  rep %d: n=%llu p50=%.3f p99=%.3f %s tput=%.0f/s\n", rep,
+                   (unsigned long long)reps[nreps].samples, reps[nreps].m[M_P50],
+                   reps[nreps].m[M_P99], cfg.unit, reps[nreps].m[M_TPUT]);
+            nreps++;
+
+            if (nreps >= cfg.min_reps && converged(&cfg, reps, nreps)) {
+                done = true;
+                break;
+            }
+            if (cfg.cooldown_ms > 0) {
+                struct timespec nap = { cfg.cooldown_ms / 1000, (cfg.cooldown_ms % 1000) * 1000000L };
+                nanosleep(&nap, NULL);
+            }
+        }
+
+        if (nreps == 0) {
+            printf("  no successful reps, skipped\n");
+            continue;
+        }
+
+        double mean[M_COUNT], hw[M_COUNT];
+        for (int m = 0; m < M_COUNT; m++)
+            mean_ci(reps, nreps, m, &mean[m], &hw[m]);
+
+        printf("  => %d reps%s: tput=%.0f +/- %.0f/s p50=%.3f +/- %.3f p99=%.3f +/- %.3f %s\n",
+               nreps, done ? "" : " (not converged)", mean[M_TPUT], hw[M_TPUT],
+               mean[M_P50], hw[M_P50], mean[M_P99], hw[M_P99], cfg.unit);
+
+        fprintf(summary, "%d", p);
+        for (int a = 0; a < cfg.naxes; a++)
+            fprintf(summary, ",%s", cfg.axes[a].values[idx[a]]);
+        fprintf(summary, ",%d,%d,%llu,%.1f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                nreps, done, (unsigned long long)pooled->total,
+                mean[M_TPUT], isinf(hw[M_TPUT]) ? 0.0 : hw[M_TPUT],
+                mean[M_P50], isinf(hw[M_P50]) ? 0.0 : hw[M_P50],
+                mean[M_P99], isinf(hw[M_P99]) ? 0.0 : hw[M_P99],
+                hdr_hist_percentile(pooled, 50.0) * scale,
+                hdr_hist_percentile(pooled, 99.0) * scale,
+                hdr_hist_percentile(pooled, 99.9) * scale,
+                pooled->max * scale);
+        fflush(summary);
+    }
+
+    fclose(replog);
+    fclose(summary);
+    printf("\nWrote summary to %s, per-rep results to %s/reps.csv\n", cfg.out, cfg.workdir);
+
+    free(rep_hist);
+    free(pooled);
+    free(scratch);
+    return g_got_sigint ? 130 : 0;
+}
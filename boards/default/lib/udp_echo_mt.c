@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "udp_echo_mt.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF    51
+#endif
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL                46
+#endif
+
+#define UDP_ECHO_WAKE_MS    100     /* how often a worker checks for shutdown */
+#define UDP_ECHO_MAX_EVENTS 64
+
+struct udp_echo_worker {
+    int              idx;
+    int              cpu;
+    const struct udp_echo_cfg *cfg;
+    int             *fds;           /* [nports] */
+    pthread_t        thread;
+
+    struct mmsghdr  *msgs;
+    struct iovec    *iov;
+    struct sockaddr_in *peers;
+    uint8_t         *bufs;
+
+    uint64_t         rx_pkts, tx_pkts, batches;
+} __attribute__((aligned(64)));
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int signo)
+{
+    (void)signo;
+    g_stop = 1;
+}
+
+void udp_echo_cfg_init(struct udp_echo_cfg *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->nports = 1;
+    cfg->batch  = UDP_ECHO_BATCH_DEFAULT;
+}
+
+void udp_echo_usage(FILE *out)
+{
+    fprintf(out,
+            "Multi-threaded mode:\n"
+            "  --threads N      N pinned workers, one SO_REUSEPORT socket each per port\n"
+            "  --ports K        listen on PORT .. PORT+K-1 (default 1)\n"
+            "  --cpu-base C     worker i on cpu C+i (default 0; -1 leaves them unpinned)\n"
+            "  --batch B        packets per recvmmsg/sendmmsg (default %d, max %d)\n"
+            "  --busy-poll US   SO_BUSY_POLL on every socket\n"
+            "  --cbpf           steer packets to the worker on their rx cpu (use --cpu-base 0)\n",
+            UDP_ECHO_BATCH_DEFAULT, UDP_ECHO_BATCH_MAX);
+}
+
+static int parse_int(const char *s, int lo, int hi, int *out)
+{
+    char *end = NULL;
+    long v = strtol(s, &end, 10);
+
+    if (!s[0] || (end && *end) || v < lo || v > hi)
+        return -1;
+    *out = (int)v;
+    return 0;
+}
+
+int udp_echo_parse_opt(struct udp_echo_cfg *cfg, int argc, char **argv, int *i)
+{
+    const char *opt = argv[*i];
+    int rc = 0;
+
+    if (strcmp(opt, "--cbpf") == 0) {
+        cfg->cbpf = true;
+        return 1;
+    }
+    if (strcmp(opt, "--threads") != 0 && strcmp(opt, "--ports") != 0 &&
+        strcmp(opt, "--cpu-base") != 0 && strcmp(opt, "--batch") != 0 &&
+        strcmp(opt, "--busy-poll") != 0)
+        return 0;
+
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "%s needs a value\n", opt);
+        return -1;
+    }
+    const char *val = argv[++*i];
+
+    if (strcmp(opt, "--threads") == 0)
+        rc = parse_int(val, 1, 1024, &cfg->nthreads);
+    else if (strcmp(opt, "--ports") == 0)
+        rc = parse_int(val, 1, 4096, &cfg->nports);
+    else if (strcmp(opt, "--cpu-base") == 0)
+        rc = parse_int(val, -1, 4095, &cfg->cpu_base);
+    else if (strcmp(opt, "--batch") == 0)
+        rc = parse_int(val, 1, UDP_ECHO_BATCH_MAX, &cfg->batch);
+    else
+        rc = parse_int(val, 0, 1000000, &cfg->busy_poll_us);
+
+    if (rc != 0) {
+        fprintf(stderr, "Invalid %s: %s\n", opt, val);
+        return -1;
+    }
+    return 1;
+}
+
+/* Pick the group's socket from the cpu the packet arrived on */
+static int attach_cpu_steering(int fd, int nsocks)
+{
+    struct sock_filter code[] = {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)nsocks },
+        { BPF_RET | BPF_A,           0, 0, 0 },
+    };
+    struct sock_fprog prog = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)");
+        return -1;
+    }
+    return 0;
+}
+
+static int open_reuseport_socket(const struct udp_echo_cfg *cfg, const struct in_addr *addr,
+                                 uint16_t port)
+{
+    struct sockaddr_in sa;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+    if (cfg->busy_poll_us > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &cfg->busy_poll_us, sizeof(cfg->busy_poll_us)) < 0)
+        perror("setsockopt(SO_BUSY_POLL)");     /* needs CAP_NET_ADMIN above the sysctl; keep going */
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port   = htons(port);
+    sa.sin_addr   = *addr;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Receive up to one batch from @fd and echo it back; returns packets echoed, -1 on error */
+static int echo_batch(struct udp_echo_worker *w, int fd, int flags)
+{
+    const struct udp_echo_cfg *cfg = w->cfg;
+    int got, sent = 0;
+
+    for (int k = 0; k < cfg->batch; k++) {
+        w->iov[k].iov_base = w->bufs + (size_t)k * UDP_ECHO_BUF_SIZE;
+        w->iov[k].iov_len  = UDP_ECHO_BUF_SIZE;
+        memset(&w->msgs[k].msg_hdr, 0, sizeof(w->msgs[k].msg_hdr));
+        w->msgs[k].msg_hdr.msg_name    = &w->peers[k];
+        w->msgs[k].msg_hdr.msg_namelen = sizeof(w->peers[k]);
+        w->msgs[k].msg_hdr.msg_iov     = &w->iov[k];
+        w->msgs[k].msg_hdr.msg_iovlen  = 1;
+    }
+
+    got = recvmmsg(fd, w->msgs, (unsigned)cfg->batch, flags, NULL);
+    if (got <= 0)
+        return got;
+    w->rx_pkts += (uint64_t)got;
+    w->batches++;
+
+    /* Reply in place: same buffers, same peers, trimmed to what arrived */
+    for (int k = 0; k < got; k++) {
+        w->iov[k].iov_len = w->msgs[k].msg_len;
+        if (cfg->mutate && w->msgs[k].msg_len > 0) {
+            uint8_t *p = w->iov[k].iov_base;
+            p[0] = (uint8_t)(p[0] + 1);
+        }
+    }
+    while (sent < got) {
+        int n = sendmmsg(fd, w->msgs + sent, (unsigned)(got - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("sendmmsg");
+            break;
+        }
+        sent += n;
+    }
+    w->tx_pkts += (uint64_t)sent;
+    return got;
+}
+
+static void *udp_echo_worker_fn(void *arg)
+{
+    struct udp_echo_worker *w = arg;
+    const struct udp_echo_cfg *cfg = w->cfg;
+    struct epoll_event evs[UDP_ECHO_MAX_EVENTS];
+    int ep = -1;
+
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "worker %d: cannot pin to cpu %d\n", w->idx, w->cpu);
+    }
+
+    /* One port: sleep in recvmmsg itself; the receive timeout lets us see g_stop */
+    if (cfg->nports == 1) {
+        while (!g_stop) {
+            if (echo_batch(w, w->fds[0], MSG_WAITFORONE) < 0 &&
+                errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("recvmmsg");
+                break;
+            }
+        }
+        return NULL;
+    }
+
+    ep = epoll_create1(0);
+    if (ep < 0) {
+        perror("epoll_create1");
+        return NULL;
+    }
+    for (int p = 0; p < cfg->nports; p++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = w->fds[p] };
+
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, w->fds[p], &ev) < 0) {
+            perror("epoll_ctl");
+            close(ep);
+            return NULL;
+        }
+    }
+
+    while (!g_stop) {
+        int n = epoll_wait(ep, evs, UDP_ECHO_MAX_EVENTS, UDP_ECHO_WAKE_MS);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        /* Drain each ready socket so one busy port cannot starve the rest for long */
+        for (int i = 0; i < n; i++) {
+            while (echo_batch(w, evs[i].data.fd, MSG_DONTWAIT) == cfg->batch)
+                ;
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+int udp_echo_run(const struct udp_echo_cfg *cfg, const char *bind_ip)
+{
+    struct udp_echo_worker *workers;
+    struct in_addr addr;
+    struct sigaction sa;
+    struct timeval tv = { 0, UDP_ECHO_WAKE_MS * 1000 };
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = cfg->nthreads, rc = 0;
+
+    if (strcmp(bind_ip, "0.0.0.0") == 0 || strcmp(bind_ip, "*") == 0) {
+        addr.s_addr = htonl(INADDR_ANY);
+    } else if (inet_pton(AF_INET, bind_ip, &addr) != 1) {
+        fprintf(stderr, "Invalid IPv4 address: %s\n", bind_ip);
+        return 1;
+    }
+    if ((int)cfg->port + cfg->nports - 1 > 65535) {
+        fprintf(stderr, "Ports %d..%d out of range\n", cfg->port, cfg->port + cfg->nports - 1);
+        return 1;
+    }
+
+    /* Workers sit on different cpus; keep their counters on separate lines */
+    if (posix_memalign((void **)&workers, 64, (size_t)nthreads * sizeof(*workers)) != 0) {
+        perror("posix_memalign");
+        return 1;
+    }
+    memset(workers, 0, (size_t)nthreads * sizeof(*workers));
+    for (int w = 0; w < nthreads; w++) {
+        struct udp_echo_worker *wk = &workers[w];
+
+        wk->idx   = w;
+        wk->cfg   = cfg;
+        wk->cpu   = (cfg->cpu_base < 0 || ncpu <= 0) ? -1 : (int)((cfg->cpu_base + w) % ncpu);
+        wk->fds   = malloc((size_t)cfg->nports * sizeof(*wk->fds));
+        wk->msgs  = calloc((size_t)cfg->batch, sizeof(*wk->msgs));
+        wk->iov   = calloc((size_t)cfg->batch, sizeof(*wk->iov));
+        wk->peers = calloc((size_t)cfg->batch, sizeof(*wk->peers));
+        wk->bufs  = malloc((size_t)cfg->batch * UDP_ECHO_BUF_SIZE);
+        if (wk->fds) {
+            for (int p = 0; p < cfg->nports; p++)
+                wk->fds[p] = -1;
+        }
+        /* The cleanup below frees what was set up, including this worker's partial state */
+        if (!wk->fds || !wk->msgs || !wk->iov || !wk->peers || !wk->bufs) {
+            perror("malloc");
+            rc = 1;
+            break;
+        }
+    }
+
+    /*
+     * Build each reuseport group in worker order: the group's socket index,
+     * which the CBPF program returns, is the order the sockets joined it.
+     */
+    for (int p = 0; p < cfg->nports && rc == 0; p++) {
+        for (int w = 0; w < nthreads; w++) {
+            int fd = open_reuseport_socket(cfg, &addr, (uint16_t)(cfg->port + p));
+
+            if (fd < 0) {
+                rc = 1;
+                break;
+            }
+            if (cfg->nports == 1)
+                (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            workers[w].fds[p] = fd;
+        }
+        if (rc == 0 && cfg->cbpf && attach_cpu_steering(workers[0].fds[p], nthreads) != 0)
+            rc = 1;
+    }
+
+    if (rc == 0) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT,  &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        printf("UDP server listening on %s:%d..%d, %d workers, batch %d%s%s\n",
+               bind_ip, cfg->port, cfg->port + cfg->nports - 1, nthreads, cfg->batch,
+               cfg->cbpf ? ", cpu steering" : "", cfg->busy_poll_us ? ", busy poll" : "");
+        fflush(stdout);
+
+        for (int w = 0; w < nthreads; w++) {
+            int err = pthread_create(&workers[w].thread, NULL, udp_echo_worker_fn, &workers[w]);
+            if (err) {
+                errno = err;
+                perror("pthread_create");
+                g_stop = 1;
+                nthreads = w;
+                rc = 1;
+                break;
+            }
+        }
+        for (int w = 0; w < nthreads; w++)
+            pthread_join(workers[w].thread, NULL);
+
+        /* Uneven counts mean the hash (or steering) is not spreading flows */
+        printf("\n%-8s %-5s %14s %14s %10s\n", "worker", "cpu", "rx_pkts", "tx_pkts", "avg_batch");
+        for (int w = 0; w < nthreads; w++) {
+            const struct udp_echo_worker *wk = &workers[w];
+
+            printf("%-8d %-5d %14llu %14llu %10.2f\n", w, wk->cpu,
+                   (unsigned long long)wk->rx_pkts, (unsigned long long)wk->tx_pkts,
+                   wk->batches ? (double)wk->rx_pkts / (double)wk->batches : 0.0);
+        }
+    }
+
+    for (int w = 0; w < cfg->nthreads; w++) {
+        struct udp_echo_worker *wk = &workers[w];
+
+        for (int p = 0; wk->fds && p < cfg->nports; p++)
+            if (wk->fds[p] >= 0)
+                close(wk->fds[p]);
+        free(wk->fds);
+        free(wk->msgs);
+        free(wk->iov);
+        free(wk->peers);
+        free(wk->bufs);
+    }
+    free(workers);
+    return rc;
+}
@@ -0,0 +1,64 @@
+#ifndef __UDP_ECHO_MT_H
+#define __UDP_ECHO_MT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Multi-threaded kernel-socket UDP echo, the fair baseline for the bypass
+ * path.
+ *
+ * Each of the N workers is pinned to a CPU and owns one SO_REUSEPORT
+ * socket per listening port. The kernel spreads flows over the sockets of
+ * a port by hash. With cbpf set, a classic BPF program on each reuseport
+ * group picks the socket instead: socket (rx cpu % N). That keeps a
+ * packet on the CPU whose softirq received it, provided worker i runs on
+ * CPU i (cpu_base 0). Packets move in batches of up to batch through
+ * recvmmsg/sendmmsg. busy_poll_us sets SO_BUSY_POLL on every socket.
+ *
+ * One port: a worker blocks in recvmmsg. Several ports (port ..
+ * port + nports - 1, as udp_mt_client and multi-server/run.sh use): a
+ * worker waits in epoll and drains each ready socket. Epoll only busy
+ * polls when net.core.busy_poll is set.
+ *
+ * Used by app/udp_server (host) and udp_server_kernel (target). Both keep
+ * their old single-socket loop when --threads is not given.
+ */
+#define UDP_ECHO_BATCH_DEFAULT  32
+#define UDP_ECHO_BATCH_MAX      256
+#define UDP_ECHO_BUF_SIZE       2048    /* per packet; above the 1500 MTU */
+
+struct udp_echo_cfg {
+    uint16_t port;
+    int      nports;        /* listen on port .. port + nports - 1 */
+    int      nthreads;      /* 0: caller's single-socket loop */
+    int      cpu_base;      /* worker i on cpu_base + i (mod online cpus); -1 unpinned */
+    int      batch;         /* recvmmsg/sendmmsg vector length */
+    int      busy_poll_us;  /* SO_BUSY_POLL; 0 leaves it off */
+    bool     cbpf;          /* steer each packet to the socket of its rx cpu */
+    bool     mutate;        /* increment byte 0 of each reply */
+};
+
+void udp_echo_cfg_init(struct udp_echo_cfg *cfg);
+
+/*
+ * Parse the option at argv[*i] if it is one of ours, advancing *i past its
+ * value. Returns 1 if consumed, 0 if not ours, -1 on a bad value.
+ */
+int  udp_echo_parse_opt(struct udp_echo_cfg *cfg, int argc, char **argv, int *i);
+
+void udp_echo_usage(FILE *out);
+
+/* Bind and serve until SIGINT/SIGTERM, then print per-worker counts. Nonzero on setup failure */
+int  udp_echo_run(const struct udp_echo_cfg *cfg, const char *bind_ip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UDP_ECHO_MT_H */
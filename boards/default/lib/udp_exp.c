@@ -30,6 +30,12 @@
 #include "iocache_ioctl.h"
 
 #include "accnet_lib.h"
+#include "accnet_frame.h"
+#include "accnet_reactor.h"
+#include "accnet_demux.h"
+#include "accnet_loadgen.h"
+#include "hdr_hist.h"
+#include "results_sink.h"
 #include "iocache_lib.h"
 
 #ifndef CLOCK_MONOTONIC
@@ -42,18 +48,32 @@
 #define MODE_SERVER "server"    // Blocking Server
 #define MODE_LOOP "loop"
 #define MODE_SINK  "sink"
+#define MODE_OPEN  "open"       // Open-loop client (framed)
+
+#define MAX_TX_THREADS 16
 
 struct timespec timespec_diff(struct timespec *start, struct timespec *end);
 struct timespec timespec_from_tick(uint64_t ns);
 uint64_t test_udp_latency_block(struct accnet_info *accnet, struct iocache_info *iocache,
                                         uint8_t payload[], uint32_t payload_size, bool debug);
-uint64_t test_udp_latency_poll(struct accnet_info *accnet, struct iocache_info *iocache, 
+uint64_t test_udp_latency_poll(struct accnet_info *accnet,
                                         uint8_t payload[], uint32_t payload_size, bool debug);
-void test_udp_server_block(struct accnet_info *accnet, struct iocache_info *iocache, bool debug);
+void test_udp_server_block(struct accnet_info *accnet, bool debug);
 static uint64_t test_loopback_throughput_local(struct accnet_info *accnet, struct iocache_info *iocache,
                                          uint32_t payload_size, size_t target_bytes, bool debug);
 void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info *iocache, 
-                                uint32_t payload_size, uint32_t ntest, bool debug);
+                                uint32_t payload_size, uint32_t ntest, int tx_threads, bool debug);
+uint64_t test_udp_latency_framed(struct accnet_info *accnet, struct iocache_info *iocache,
+                                 struct connection_info *conn, uint8_t payload[], uint32_t payload_size,
+                                 uint32_t seq, bool blocking, bool debug);
+void test_udp_server_framed(struct accnet_info *accnet, struct iocache_info *iocache, bool debug);
+void test_udp_server_demux(struct accnet_info *accnet, bool debug);
+static void test_udp_server_breakdown(struct accnet_info *accnet, struct iocache_info *iocache,
+                                      const char *hist_out, bool debug);
+static int test_udp_open_loop(struct accnet_info *accnet, struct connection_info *conn,
+                              const uint8_t payload[], uint32_t payload_size, const char *rates,
+                              enum accnet_arrival arrival, uint64_t count, uint64_t seed, uint32_t drain_us,
+                              int rx_cpu, const char *hist_out, bool write_csv);
 
 static inline bool is_power_of_two_u32(uint32_t x) {
     return x && ((x & (x - 1)) == 0);
@@ -82,13 +102,6 @@ static void install_sig_handlers(void) {
     sigaction(SIGTERM, &sa, NULL);  // optional: treat kill -TERM like Ctrl-C
 }
 
-static inline uint64_t rdcycle(void)
-{
-    uint64_t x;
-    __asm__ volatile ("rdcycle %0" : "=r"(x));
-    return x;
-}
-
 static void pin_to_cpu(int cpu) {
 
     long ncpu = sysconf(_SC_NPROCESSORS_CONF);
@@ -115,33 +128,16 @@ static inline uint32_t ring_free_bytes(uint32_t head, uint32_t tail, uint32_t si
     return (head - tail - 1);
 }
 
-// Copy 'len' bytes into a wrapping ring buffer at 'tail'
-static inline void ring_memcpy_wrap(uint8_t *base, uint32_t size, uint32_t tail, const uint8_t *src, uint32_t len)
-{
-    /* Let's skip copying... */
-    // uint32_t first = len;
-    // if (tail + len > size) first = size - tail;
-    // memcpy(base + tail, src, first);
-    // if (first < len) {
-    //     memcpy(base, src + first, len - first);
-    // }
-}
-
 // Fill at most 1/4 of the TX ring this call; return bytes actually queued
-static uint32_t try_fill_tx(struct accnet_info *accnet, struct iocache_info *iocache,
+static uint32_t try_fill_tx(struct accnet_info *accnet,
                             const uint8_t *payload, uint32_t chunk_bytes,
                             uint64_t need_bytes, bool debug)
 {
-    int row = iocache->row;
+    struct accnet_span span;
 
-    // Snapshot ring pointers/sizes
-    uint32_t tx_head = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    uint32_t tx_tail = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    uint32_t tx_size = reg_read32(iocache->regs,         IOCACHE_REG_TX_RING_SIZE(row));
-    mmio_rmb();
-
-    // Free space with "one empty byte" convention
-    uint32_t freeb = ring_free_bytes(tx_head, tx_tail, tx_size);
+    // Free space with "one empty byte" convention; only touches TX_HEAD when the shadow can't fit a chunk
+    uint32_t tx_size = accnet->ring.tx_size;
+    uint32_t freeb   = accnet_tx_space(accnet, chunk_bytes);
 
     // Cap to one quarter of the ring per call, and also to what's needed
     uint32_t quarter = tx_size / 2u;
@@ -153,41 +149,34 @@ static uint32_t try_fill_tx(struct accnet_info *accnet, struct iocache_info *ioc
     quota -= (quota % chunk_bytes);
     if (quota == 0) return 0;
 
-    // Copy 'quota' bytes in chunk_bytes steps, then publish the new tail once
+    if (accnet_tx_reserve(accnet, quota, &span) != 0)
+        return 0;
+
+    // Copy 'quota' bytes in chunk_bytes steps straight into the ring, then publish the new tail once
     uint32_t sent = 0;
     while (sent < quota) {
-        ring_memcpy_wrap((uint8_t*)iocache->udp_tx_buffer, tx_size, tx_tail,
-                         payload, chunk_bytes);
-        tx_tail = (tx_tail + chunk_bytes) % tx_size;
-        sent   += chunk_bytes;
+        accnet_span_write(&span, sent, payload, chunk_bytes);
+        sent += chunk_bytes;
     }
-
-    mmio_wmb();
-    reg_write32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row), tx_tail);
+    accnet_tx_commit(accnet, &span, sent);
 
     if (debug) {
         printf("try_fill_tx: quarter=%u freeb=%u quota=%u sent=%u new_tail=%u\n",
-               quarter, freeb, quota, sent, tx_tail);
+               quarter, freeb, quota, sent, (span.pos + sent) % tx_size);
     }
     return sent;
 }
 
 
 // Drain RX; returns bytes drained this call
-static uint32_t drain_rx(struct accnet_info *accnet, struct iocache_info *iocache)
+static uint32_t drain_rx(struct accnet_info *accnet)
 {
-    int row = iocache->row;
-
-    uint32_t rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    uint32_t rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-    uint32_t rx_size = reg_read32(iocache->regs,         IOCACHE_REG_RX_RING_SIZE(row));
-    mmio_rmb();
+    struct accnet_span span;
 
-    uint32_t avail = (rx_tail >= rx_head) ? (rx_tail - rx_head) : (rx_size - (rx_head - rx_tail));
+    uint32_t avail = accnet_rx_peek(accnet, &span);
     if (avail) {
         // Consume everything we see
-        mmio_wmb();
-        reg_write32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row), rx_tail);
+        accnet_rx_release(accnet, &span, avail);
     }
     return avail;
 }
@@ -210,12 +199,12 @@ static uint64_t test_loopback_throughput(struct accnet_info *accnet, struct ioca
         // 1) Try to fill TX as much as possible this iteration
         if (total_tx < target_bytes) {
             uint64_t need = target_bytes - total_tx;
-            uint32_t just_tx = try_fill_tx(accnet, iocache, payload, payload_size, need, debug);
+            uint32_t just_tx = try_fill_tx(accnet, payload, payload_size, need, debug);
             total_tx += just_tx;
         }
 
         // 2) Drain whatever RX arrived; advance RX_HEAD
-        uint32_t just_rx = drain_rx(accnet, iocache);
+        uint32_t just_rx = drain_rx(accnet);
         total_rx += just_rx;
 
         // If neither progressed, do a very small pause (or just continue tight)
@@ -251,6 +240,7 @@ struct tx_worker_args {
     uint32_t              ntest;
     bool                  debug;
     int                   pin_cpu;      // pin worker here (we'll use 3)
+    struct accnet_mp_tx  *mp;           // shared TX ring when several workers run
 };
 
 #include <sys/resource.h>
@@ -263,35 +253,26 @@ static void *tx_worker_fn(void *arg) {
         perror("pthread_setschedparam TX->SCHED_OTHER");
     }
 
-    uint32_t tx_head, tx_tail, tx_size;
-    uint32_t rx_head, rx_tail, rx_size;
-    int row = a->iocache->row;
-
-    int counter = 0;
-
-    /* Preparing to send the payload */
-    tx_head = reg_read32(a->accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    tx_tail = reg_read32(a->accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    tx_size = reg_read32(a->iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
+    struct accnet_span span;
+    struct accnet_mp_slot slot;
+    uint32_t sent = 0;
 
-    do {
-        tx_head = reg_read32(a->accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-        mmio_rmb();
-        uint32_t avail = (tx_tail >= tx_head) ? (tx_size - (tx_tail - tx_head) - 1) : (tx_head - tx_tail - 1);
-
-        // printf("in send thread...\n");
-        usleep(30);
-
-        if (a->payload_size <= avail) {
-            // printf("sending...\n");
-            // No need for copying
-            uint32_t new_tx_tail = (tx_tail + a->payload_size) % a->iocache->udp_tx_size;
-            reg_write32(a->accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row), new_tx_tail);
-            mmio_wmb();
-            tx_tail = new_tx_tail;
+    while (sent < a->ntest && !g_got_sigint) {
+        int ret = a->mp ? accnet_mp_tx_reserve(a->mp, a->payload_size, &slot)
+                        : accnet_tx_reserve(a->accnet, a->payload_size, &span);
+        if (ret != 0) {
+            /* Ring full: sleep until the NIC completes something (or 1s timeout) */
+            iocache_wait_on_txcomp(a->iocache);
+            continue;
         }
 
-    } while (counter++ < a->ntest && !g_got_sigint);
+        // No need for copying
+        if (a->mp)
+            accnet_mp_tx_commit(a->mp, &slot);
+        else
+            accnet_tx_commit(a->accnet, &span, a->payload_size);
+        sent++;
+    }
 
     printf("sending done!\n");
     return NULL;
@@ -308,6 +289,19 @@ int main(int argc, char **argv) {
     bool skip_file = false;
     bool reset = false;
     bool print_all = false;
+    bool pin_row = false;
+    bool kernel_hist = false;
+    bool framed = false;
+    bool wildcard = false;
+    bool breakdown = false;
+    char *hist_out = NULL;
+    char *results_out = NULL;
+    char *rates = "1000";
+    enum accnet_arrival arrival = ACCNET_ARRIVAL_POISSON;
+    uint64_t seed = 0;
+    uint32_t drain_us = 10000;
+    int rx_cpu = -1;
+    int tx_threads = 1;
     uint32_t payload_size = 1*1024;
     char *src_ip = "10.0.0.2";
     char *src_mac = "0c:42:a1:a8:2d:e6";
@@ -317,19 +311,20 @@ int main(int argc, char **argv) {
     uint16_t dst_port = 1234;
     uint16_t client_id = 0;
     char *mode = MODE_POLLING;
-    int ring = 0;
+    int ring = IOCACHE_ROW_ANY;
     size_t target_bytes = 1 * 1024 * 1024; // 1 MiB
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
             printf("Usage: %s [--cpu A]"
-                "[--ntest N] [--mode {" MODE_POLLING "|" MODE_BLOCKING "|" MODE_SERVER "}]"
-                "[--payload-size BYTES] [--ring R]"
+                "[--ntest N] [--mode {" MODE_POLLING "|" MODE_BLOCKING "|" MODE_SERVER "|" MODE_OPEN "}]"
+                "[--payload-size BYTES] [--ring R (default: any free row)]"
                 "[--src-ip ADDR] [--src-port PORT] "
                 "[--dst-ip ADDR] [--dst-port PORT] "
                 "[--client-id ID]"
-                "[--reset] [--skip-outfile]"
-                "[--debug] [--print-all] [--skip-first]\n", argv[0]);
+                "[--reset] [--skip-outfile] [--pin-row] [--kernel-hist] [--framed] [--wildcard (server, rx only)] [--breakdown (server)] [--tx-threads N (sink)]"
+                "[--hist-out FILE] [--results FILE] [--debug] [--print-all] [--skip-first]"
+                "[--rate PPS[,PPS...] (open)] [--arrival {poisson|fixed}] [--seed N] [--drain-us US] [--rx-cpu B]\n", argv[0]);
             return 0;
         }
         else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
@@ -359,11 +354,12 @@ int main(int argc, char **argv) {
                 strcmp(mode, MODE_BLOCKING) == 0 ||
                 strcmp(mode, MODE_SERVER)  == 0 ||
                 strcmp(mode, MODE_LOOP)    == 0 ||
-                strcmp(mode, MODE_SINK)   == 0) {
+                strcmp(mode, MODE_SINK)   == 0 ||
+                strcmp(mode, MODE_OPEN)   == 0) {
                 // ok
             } else {
-                fprintf(stderr, "Invalid mode (options: %s, %s, %s, %s, %s)\n",
-                    MODE_POLLING, MODE_BLOCKING, MODE_SERVER, MODE_LOOP, MODE_SINK);
+                fprintf(stderr, "Invalid mode (options: %s, %s, %s, %s, %s, %s)\n",
+                    MODE_POLLING, MODE_BLOCKING, MODE_SERVER, MODE_LOOP, MODE_SINK, MODE_OPEN);
                 return -1;
             }
         }
@@ -416,6 +412,54 @@ int main(int argc, char **argv) {
             reset = true;
             // printf("Parsed --reset\n");
         }
+        else if (strcmp(argv[i], "--kernel-hist") == 0) {
+            kernel_hist = true;
+        }
+        else if (strcmp(argv[i], "--framed") == 0) {
+            framed = true;
+        }
+        else if (strcmp(argv[i], "--breakdown") == 0) {
+            breakdown = true;   /* server: per-stage latency histograms */
+        }
+        else if (strcmp(argv[i], "--hist-out") == 0 && i + 1 < argc) {
+            hist_out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+            results_out = argv[++i];    /* stream samples to a binary file instead of the CSV */
+        }
+        else if (strcmp(argv[i], "--wildcard") == 0) {
+            wildcard = true;    /* any remote peer, receive only; needs framed clients */
+            framed = true;
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rates = argv[++i];
+        }
+        else if (strcmp(argv[i], "--arrival") == 0 && i + 1 < argc) {
+            const char *a = argv[++i];
+            if (strcmp(a, "poisson") == 0) {
+                arrival = ACCNET_ARRIVAL_POISSON;
+            } else if (strcmp(a, "fixed") == 0) {
+                arrival = ACCNET_ARRIVAL_FIXED;
+            } else {
+                fprintf(stderr, "Invalid arrival (options: poisson, fixed)\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--drain-us") == 0 && i + 1 < argc) {
+            drain_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--rx-cpu") == 0 && i + 1 < argc) {
+            rx_cpu = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--tx-threads") == 0 && i + 1 < argc) {
+            tx_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pin-row") == 0) {
+            pin_row = true;
+        }
         else if (strcmp(argv[i], "--print-all") == 0) {
             print_all = true;
             // printf("Parsed --print-all\n");
@@ -440,19 +484,35 @@ int main(int argc, char **argv) {
     bool is_server   = strcmp(mode, MODE_SERVER)  == 0;
     bool is_loop     = strcmp(mode, MODE_LOOP)    == 0;
     bool is_async    = strcmp(mode, MODE_SINK)   == 0;
+    bool is_open     = strcmp(mode, MODE_OPEN)   == 0;
 
     struct accnet_info *accnet      = malloc(sizeof(struct accnet_info));
     struct iocache_info *iocache    = calloc(1, sizeof(*iocache));
-    long long *rtts            = calloc(n_tests, sizeof(long long));
-    long long *network_latency = calloc(n_tests, sizeof(long long)); // if you keep it
-    if (!rtts || !network_latency) { perror("calloc"); return 1; }
+    /*
+     * Per-sample arrays only back the CSV and --print-all; the histogram is
+     * fixed size. With --results the samples go to the sink instead, so a
+     * long run stays in bounded memory.
+     */
+    bool keep_samples          = (print_all || (!skip_file && !results_out)) && !is_open;
+    long long *rtts            = keep_samples ? calloc(n_tests, sizeof(long long)) : NULL;
+    long long *network_latency = keep_samples ? calloc(n_tests, sizeof(long long)) : NULL;
+    struct hdr_hist *rtt_hist  = malloc(sizeof(*rtt_hist));
+    if ((keep_samples && (!rtts || !network_latency)) || !rtt_hist) { perror("calloc"); return 1; }
+    hdr_hist_init(rtt_hist);
 
     if (iocache_open(iocache_filename, iocache, ring) < 0) {
         fprintf(stderr, "iocache_open failed\n"); 
         return 1;
     }
 
-    // printf("row is %d\n", iocache->row);
+    if (debug)
+        printf("iocache row %d\n", iocache->row);
+
+    /* Fix the row's interrupts on --cpu instead of following the thread */
+    if (pin_row && iocache_set_row_affinity(iocache, cpu, true) < 0) {
+        fprintf(stderr, "iocache_set_row_affinity failed\n");
+        return 1;
+    }
 
     if (accnet_open(accnet_filename, accnet, iocache, true) < 0) {
         fprintf(stderr, "accnet_open failed\n"); 
@@ -480,7 +540,10 @@ int main(int argc, char **argv) {
     }
 
     accnet_setup_connection(accnet, conn);
-    iocache_setup_connection(iocache, conn);
+    if (wildcard && is_server)
+        iocache_setup_wildcard(iocache, conn);
+    else
+        iocache_setup_connection(iocache, conn);
 
     // if (is_blocking)
     //     iocache_start_scheduler(iocache);
@@ -492,10 +555,25 @@ int main(int argc, char **argv) {
         test_loopback_throughput_local(accnet, iocache, payload_size, target_bytes, debug);
     }
     else if (is_server) {
-        test_udp_server_block(accnet, iocache, debug);
+        if (wildcard)
+            test_udp_server_demux(accnet, debug);
+        else if (breakdown)
+            test_udp_server_breakdown(accnet, iocache, hist_out, debug);
+        else if (framed)
+            test_udp_server_framed(accnet, iocache, debug);
+        else
+            test_udp_server_block(accnet, debug);
     }
     else if (is_async) {
-        test_udp_server_throughput(accnet, iocache, payload_size, n_tests, debug);
+        test_udp_server_throughput(accnet, iocache, payload_size, n_tests, tx_threads, debug);
+    }
+    else if (is_open) {
+        uint8_t payload[payload_size];
+        for (uint32_t i = 0; i < payload_size; i++) {
+            payload[i] = i & 0xff;
+        }
+        test_udp_open_loop(accnet, conn, payload, payload_size, rates, arrival, (uint64_t)n_tests,
+                           seed, drain_us, rx_cpu, hist_out, !skip_file);
     }
     else {
         // This is client mode
@@ -508,6 +586,22 @@ int main(int argc, char **argv) {
 
         long long sum_ticks = 0, min_ticks = 0, max_ticks = 0;
         uint64_t sum_network_latency_tick = 0;
+
+        struct results_sink *sink = NULL;
+        struct results_stream *results = NULL;
+        if (results_out) {
+            struct results_sink_cfg rcfg = {
+                .scale = US_PER_TICK, .unit = "us", .clock = "accnet-ticks",
+                .col_t = "time", .col_value = "RTT", .col_aux = "network_time",
+                .writer_cpu = -1,
+            };
+            sink = results_sink_open(results_out, &rcfg);
+            results = sink ? results_sink_stream(sink) : NULL;
+            if (!results) {
+                perror(results_out);
+                return 1;
+            }
+        }
     
         /* Run Test */
         int received_ok = 0;
@@ -515,8 +609,12 @@ int main(int argc, char **argv) {
         for (int i = 0; i < n_tests && !g_got_sigint; i++) {
             uint64_t diff = 0;
     
-            if (strcmp(mode, MODE_POLLING) == 0) {
-                diff = test_udp_latency_poll(accnet, iocache, payload, payload_size, debug); 
+            if (framed) {
+                diff = test_udp_latency_framed(accnet, iocache, conn, payload, payload_size,
+                                               (uint32_t)i, is_blocking, debug);
+            }
+            else if (strcmp(mode, MODE_POLLING) == 0) {
+                diff = test_udp_latency_poll(accnet, payload, payload_size, debug); 
             }
             else if (strcmp(mode, MODE_BLOCKING) == 0) {
                 diff = test_udp_latency_block(accnet, iocache, payload, payload_size, debug);
@@ -540,10 +638,20 @@ int main(int argc, char **argv) {
                 if (diff > max_ticks) max_ticks = diff;
             }
             sum_ticks += diff;
-            rtts[i] = diff;
+            hdr_hist_record(rtt_hist, diff);
     
             sum_network_latency_tick += netdelay_tick;
-            network_latency[i] = netdelay_tick;
+            if (keep_samples) {
+                rtts[i] = diff;
+                network_latency[i] = netdelay_tick;
+            }
+            if (results) {
+                struct results_rec rec = {
+                    .seq = (uint32_t)i, .stream = src_port, .size = payload_size,
+                    .aux = (uint32_t)netdelay_tick, .t = accnet_get_time(accnet), .value = diff,
+                };
+                results_push(results, &rec);
+            }
     
             ++received_ok;
             // printf("iter=%d rtt=%.3f us\n", i, diff / 1e3);
@@ -556,6 +664,15 @@ int main(int argc, char **argv) {
         printf("\nResults (%s): recv=%d/%d  min=%.2f us , avg=%.2f us , max=%.2f us , network=%.2f us\n\n",
                     mode, received_total, n_tests, 
                     min_ticks * US_PER_TICK, avg_us, max_ticks * US_PER_TICK, avg_network_us);
+        hdr_hist_print(stdout, rtt_hist, "RTT", US_PER_TICK, "us");
+        printf("\n");
+
+        if (hist_out) {
+            if (hdr_hist_save(rtt_hist, hist_out) != 0)
+                perror("hdr_hist_save");
+            else
+                printf("Wrote RTT histogram (ticks) to %s\n", hist_out);
+        }
 
         // printf("Time breakdown average:\nEntry-Before: %.3f us\nPLIC-Entry: %.3f us\nIRQ-PLIC: %.3f us\n"
         //     "Syscall-IRQ: %.3f us\nAfter-Syscall: %.3f us\n",
@@ -566,13 +683,36 @@ int main(int argc, char **argv) {
         //         time_ns[4]/(double)received_ok/1e3
         //     );
     
+        if (kernel_hist) {
+            static const char *stage_names[IOCACHE_HIST_STAGE_COUNT] = {
+                "irq-entry -> isr", "isr -> task running", "wait syscall"
+            };
+            struct iocache_ioctl_hist hist;
+            char label[64];
+
+            for (int s = 0; s < IOCACHE_HIST_STAGE_COUNT; s++) {
+                if (iocache_get_hist(iocache, IOCACHE_HIST_SCOPE_ROW, iocache->row, s, true, &hist) == 0) {
+                    snprintf(label, sizeof(label), "row %d %s", iocache->row, stage_names[s]);
+                    iocache_print_hist(&hist, label);
+                }
+            }
+        }
+
+        if (sink) {
+            int64_t n = results_sink_close(sink);
+            if (n < 0)
+                fprintf(stderr, "results_sink_close: write to %s failed\n", results_out);
+            else
+                printf("Wrote %lld results to %s (results_dump converts to CSV)\n", (long long)n, results_out);
+        }
+
         if (print_all) {
             for (int i = 0; i < n_tests; i++) {
-                printf("iter=%d rtt=%.3f us\n", i, rtts[i] * US_PER_TICK / 1e3);
+                printf("iter=%d rtt=%.3f us\n", i, rtts[i] * US_PER_TICK);
             }
         }
 
-        if (!skip_file) {
+        if (!skip_file && !results_out) {
             // ---- Write results file: out-accio-[payloadsize]-[srcPort].csv ----
             char out_path[128];
             snprintf(out_path, sizeof(out_path), "out-accio-%u-%u.csv", payload_size, src_port);
@@ -613,15 +753,27 @@ int main(int argc, char **argv) {
 }
 
 void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info *iocache, 
-                                uint32_t payload_size, uint32_t ntest, bool debug) {
+                                uint32_t payload_size, uint32_t ntest, int tx_threads, bool debug) {
     // Prepare a deterministic payload once
     uint8_t *payload = aligned_alloc(64, payload_size);
     if (!payload) { perror("aligned_alloc"); return 1; }
     for (uint32_t i = 0; i < payload_size; i++) payload[i] = (uint8_t)(i & 0xff);
 
-    pthread_t tx_thr;
+    pthread_t tx_thr[MAX_TX_THREADS];
     pthread_attr_t attr;
     cpu_set_t cpus;
+    struct accnet_mp_tx mp;
+    int started = 0;
+
+    if (tx_threads < 1) tx_threads = 1;
+    if (tx_threads > MAX_TX_THREADS) tx_threads = MAX_TX_THREADS;
+
+    /* Several workers share this row's TX ring through the multi-producer path */
+    if (tx_threads > 1 && accnet_mp_tx_init(&mp, accnet) != 0) {
+        fprintf(stderr, "accnet_mp_tx_init failed\n");
+        free(payload);
+        return;
+    }
 
     pthread_attr_init(&attr);
 
@@ -633,7 +785,8 @@ void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info
         .payload_size = payload_size,
         .ntest        = ntest,
         .debug        = debug,
-        .pin_cpu      = 1
+        .pin_cpu      = 1,
+        .mp           = (tx_threads > 1) ? &mp : NULL
     };
 
     // RX draining on main thread; record first/last RX timestamps & bytes
@@ -641,19 +794,18 @@ void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info
     uint64_t first_tick = 0;
     uint64_t last_tick  = 0;
     volatile uint64_t now;
-    int row = iocache->row;
 
-    uint32_t rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    uint32_t rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-    uint32_t rx_size = reg_read32(iocache->regs,         IOCACHE_REG_RX_RING_SIZE(row));
-    mmio_rmb();
-
-    // if (pthread_create(&tx_thr, &attr, tx_worker_fn, &args) != 0) {
-    //     perror("pthread_create");
-    //     pthread_attr_destroy(&attr);
-    //     free(payload);
-    //     return 1;
-    // }
+    for (; started < tx_threads; started++) {
+        if (pthread_create(&tx_thr[started], &attr, tx_worker_fn, &args) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    if (started == 0) {
+        pthread_attr_destroy(&attr);
+        free(payload);
+        return;
+    }
 
     pthread_attr_destroy(&attr);
 
@@ -667,18 +819,11 @@ void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info
 
         // printf("received packet...\n");
 
-        rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-        mmio_rmb();
-
-        uint32_t got = (rx_tail >= rx_head) ? (rx_tail - rx_head) : (rx_size - (rx_head - rx_tail));
+        // Consume everything we see
+        uint32_t got = drain_rx(accnet);
         if (got) {
             // printf("received %u...\n", got);
 
-            // Consume everything we see
-            mmio_wmb();
-            reg_write32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row), rx_tail);
-            rx_head = rx_tail; // update software view
-            
             now = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
             mmio_rmb();
             if (first_tick == 0) {
@@ -689,8 +834,9 @@ void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info
         } 
     }
 
-    // // Stop TX worker and join
-    // pthread_join(tx_thr, NULL);
+    // Stop TX worker and join
+    for (int t = 0; t < started; t++)
+        pthread_join(tx_thr[t], NULL);
 
     // Compute throughput between first and last RX timestamps
     if (first_tick == 0 || last_tick <= first_tick) {
@@ -706,89 +852,495 @@ void test_udp_server_throughput(struct accnet_info *accnet, struct iocache_info
 
     free(payload);
 }
-void test_udp_server_block(struct accnet_info *accnet, struct iocache_info *iocache, bool debug) {
-    int ret;
-    int row = iocache->row;
-    volatile uint64_t before, after;
-    uint32_t nPackets = 0;
-    volatile total_ticks = 0;
-    volatile total_ticks_2 = 0;
-    
-    uint32_t size;
-    uint32_t new_tx_tail;
-    uint32_t tx_head, tx_tail, tx_size;
-    uint32_t rx_head, rx_tail, rx_size;
-    
-    tx_head = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    tx_tail = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    tx_size = reg_read32(iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
+struct echo_block_ctx {
+    uint32_t nPackets;
+    uint64_t total_ticks, total_ticks_2;
+};
 
-    /* Preparing to receive the payload */
-    rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-    rx_size = reg_read32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row));
+/* Reactor handler: echo everything readable RX ring -> TX ring in one copy */
+static uint32_t echo_block_handler(struct accnet_info *accnet, const struct accnet_span *rx, void *arg) {
+    struct echo_block_ctx *ctx = arg;
+    struct accnet_span tx;
+    uint32_t size = accnet_span_len(rx);
+    int row = accnet->iocache->row;
+    uint64_t after, rx_timestamp, tx_timestamp;
+
+    if (accnet_tx_reserve(accnet, size, &tx) != 0) {
+        /* Leave the bytes in RX; they are offered again next round */
+        iocache_wait_on_txcomp(accnet->iocache);
+        return 0;
+    }
+
+    accnet_span_copy(&tx, 0, rx);
+    accnet_tx_commit(accnet, &tx, size);
+    after = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+
+    rx_timestamp = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(row));
+    tx_timestamp = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row));
+    ctx->total_ticks   += tx_timestamp - rx_timestamp;
+    ctx->total_ticks_2 += after - rx_timestamp;
+    ctx->nPackets++;
+
+    return size;
+}
+
+void test_udp_server_block(struct accnet_info *accnet, bool debug) {
+    struct accnet_reactor reactor;
+    struct echo_block_ctx ctx = {0};
 
-    if (tx_head != tx_tail) {
+    if (accnet->ring.tx_head != accnet->ring.tx_tail) {
         printf("TX is weird!\n");
         return;
     }
 
-    if (rx_head != rx_tail) {
+    if (accnet->ring.rx_head != accnet->ring.rx_tail) {
         printf("RX is weird!\n");
         return;
     }
 
+    accnet_reactor_init(&reactor);
+    reactor.poll_spins = 0;     /* block right away, as this mode always has */
+    if (accnet_reactor_add(&reactor, accnet, echo_block_handler, &ctx) != 0) {
+        perror("accnet_reactor_add");
+        return;
+    }
+
+    while (!g_got_sigint) {
+        if (accnet_reactor_run_once(&reactor) < 0)
+            break;
+    }
+
+    if (debug)
+        printf("[reactor] dispatches=%" PRIu64 " sleeps=%" PRIu64 " timeouts=%" PRIu64 "\n",
+               reactor.dispatches, reactor.sleeps, reactor.timeouts);
+
+    printf("\nResults (%s): recv=%d, avg1=%.2f us, avg2=%.2f us\n\n",
+                    MODE_SERVER, ctx.nPackets, 
+                    (ctx.total_ticks / (double)ctx.nPackets) * US_PER_TICK,
+                    (ctx.total_ticks_2 / (double)ctx.nPackets) * US_PER_TICK);
+}
+
+#define FRAMED_ECHO_BATCH 32
+
+/*
+ * Framed echo server: answers every complete record per wakeup, copying RX ring -> TX ring
+ * directly. Replies go out in batches of up to FRAMED_ECHO_BATCH behind a single TX doorbell,
+ * and RX_HEAD is written once per wakeup.
+ */
+void test_udp_server_framed(struct accnet_info *accnet, struct iocache_info *iocache, bool debug) {
+    struct accnet_frame_iter it;
+    struct accnet_frame frames[FRAMED_ECHO_BATCH];
+    struct accnet_frame_hdr reply;
+    struct accnet_span tx;
+    uint64_t nRecords = 0, nWakeups = 0, nResyncs = 0, nDoorbells = 0;
+    int r = 1;
+
     do {
-        ret = iocache_wait_on_rx(iocache);
+        if (iocache_wait_on_rx(iocache) != 0) {
+            // timeout path (no-op)
+            continue;
+        }
+        nWakeups++;
 
-        if (ret == 0) {
-            // Means there is a packet
-            rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-            mmio_rmb();
+        accnet_frame_iter_init(accnet, &it);
+        do {
+            uint32_t n = 0, total = 0, off = 0;
 
-            if (rx_tail == rx_head) {
-                size = 0;
-                printf("Size is weird!\n");
-                continue;
-            } else if (rx_tail > rx_head) {
-                size = rx_tail - rx_head;
-            } else {
-                size = rx_size - (rx_head - rx_tail);
+            while (n < FRAMED_ECHO_BATCH && (r = accnet_frame_next(&it, &frames[n])) != 0) {
+                if (r < 0) {
+                    nResyncs++;
+                    if (debug) printf("framed: resync at offset %u\n", it.off);
+                    continue;
+                }
+                uint32_t size = accnet_frame_size(frames[n].hdr.len);
+                if (size >= accnet->ring.tx_size) {
+                    continue;   /* can never be echoed through our TX ring */
+                }
+                if (n > 0 && total + size > accnet->ring.tx_size / 2) {
+                    it.off -= size; /* leave it for the next batch */
+                    break;
+                }
+                total += size;
+                n++;
+            }
+            if (n == 0)
+                break;
+
+            while (accnet_tx_reserve(accnet, total, &tx) != 0 && !g_got_sigint)
+                iocache_wait_on_txcomp(iocache);
+            if (g_got_sigint)
+                break;
+
+            uint64_t now = accnet_get_time(accnet);
+            for (uint32_t i = 0; i < n; i++) {
+                accnet_frame_hdr_reply(&reply, &frames[i].hdr, frames[i].hdr.len);
+                reply.tx_timestamp = now;
+                accnet_span_write(&tx, off, &reply, sizeof(reply));
+                accnet_span_copy(&tx, off + sizeof(reply), &frames[i].payload);
+                off += accnet_frame_size(reply.len);
+
+                if (debug) {
+                    printf("framed: seq=%u len=%u from port %u\n",
+                           frames[i].hdr.seq, frames[i].hdr.len, frames[i].hdr.src_port);
+                }
+            }
+            accnet_tx_commit(accnet, &tx, total);
+            nRecords += n;
+            nDoorbells++;
+        } while (r != 0);
+        accnet_frame_iter_done(&it);
+
+    } while (!g_got_sigint);
+
+    printf("\nResults (%s, framed): records=%" PRIu64 " wakeups=%" PRIu64 " records/wakeup=%.2f "
+           "records/doorbell=%.2f resyncs=%" PRIu64 "\n\n",
+                    MODE_SERVER, nRecords, nWakeups,
+                    nWakeups ? nRecords / (double)nWakeups : 0.0,
+                    nDoorbells ? nRecords / (double)nDoorbells : 0.0, nResyncs);
+}
+
+/*
+ * Per-packet breakdown of the echo path, one histogram per stage (ns):
+ *
+ *   NIC RX -> IRQ entry -> PLIC claim -> ISR -> task running -> user
+ *          -> TX doorbell -> NIC TX
+ *
+ * NIC timestamps are device ticks (ring LAST_TIMESTAMP registers); the
+ * interrupt path comes from the driver's per-row ktimes (CLOCK_MONOTONIC).
+ * accnet_clock_sync() maps one onto the other; stages that cross clocks
+ * carry its +/- error, stages within one clock do not. Wakeups without a
+ * fresh interrupt (data was already there) only feed the user-side stages.
+ */
+enum {
+    BD_NIC_RX_TO_IRQ = 0,
+    BD_IRQ_TO_CLAIM,
+    BD_CLAIM_TO_ISR,
+    BD_ISR_TO_RUN,
+    BD_RUN_TO_USER,
+    BD_USER_TO_DOORBELL,
+    BD_DOORBELL_TO_NIC_TX,
+    BD_TOTAL,
+    BD_STAGE_COUNT
+};
+
+static const char *bd_names[BD_STAGE_COUNT] = {
+    "nic-rx -> irq-entry", "irq-entry -> plic-claim", "plic-claim -> isr", "isr -> task-running",
+    "task-running -> user", "user -> tx-doorbell", "tx-doorbell -> nic-tx", "nic-rx -> nic-tx",
+};
+
+static const char *bd_tags[BD_STAGE_COUNT] = {
+    "rx_irq", "irq_claim", "claim_isr", "isr_run", "run_user", "user_doorbell", "doorbell_tx", "total",
+};
+
+#define BD_CLOCK_SYNC_US    100000
+#define BD_TX_WAIT_US       1000
+
+/* Record b - a; cross-clock pairs can come out slightly negative, which is counted, not recorded */
+static inline void bd_record(struct hdr_hist *h, uint64_t a, uint64_t b, uint64_t *skew) {
+    if (b >= a)
+        hdr_hist_record(h, b - a);
+    else
+        (*skew)++;
+}
+
+static void test_udp_server_breakdown(struct accnet_info *accnet, struct iocache_info *iocache,
+                                      const char *hist_out, bool debug) {
+    struct hdr_hist *h = malloc(BD_STAGE_COUNT * sizeof(*h));
+    struct accnet_clock clk;
+    struct iocache_ioctl_row_ktimes kt;
+    struct accnet_span rx, tx = {0};
+    int row = iocache->row;
+    uint64_t last_isr = 0, last_tx_ts;
+    uint64_t nSamples = 0, nNoIrq = 0, nNoTxStamp = 0, nSkew = 0;
+
+    if (!h) {
+        perror("malloc");
+        return;
+    }
+    for (int s = 0; s < BD_STAGE_COUNT; s++)
+        hdr_hist_init(&h[s]);
+
+    if (accnet_clock_sync(accnet, &clk, BD_CLOCK_SYNC_US) != 0) {
+        perror("accnet_clock_sync");
+        free(h);
+        return;
+    }
+    printf("clock sync: %.4f ns/tick (nominal %.4f), +/- %" PRIu64 " ns\n",
+           clk.ns_per_tick, NS_PER_TICK, clk.err_ns);
+
+    last_tx_ts = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row));
+
+    while (!g_got_sigint) {
+        struct timespec ts;
+        uint64_t user_ns, rx_ts, tx_ts, doorbell, deadline;
+        uint32_t size;
+        bool irq;
+
+        if (iocache_wait_on_rx(iocache) != 0)
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        user_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+        rx_ts = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(row));
+        size  = accnet_rx_peek(accnet, &rx);
+        if (size == 0)
+            continue;
+        /* A backlog larger than the TX ring is echoed over several wakeups */
+        if (size > accnet->ring.tx_size - 1)
+            size = accnet->ring.tx_size - 1;
+
+        while (accnet_tx_reserve(accnet, size, &tx) != 0 && !g_got_sigint)
+            iocache_wait_on_txcomp(iocache);
+        if (g_got_sigint)
+            break;
+
+        /* Copy exactly the reserved bytes; rx may hold more */
+        accnet_span_read(&rx, 0, tx.ptr[0], tx.len[0]);
+        if (tx.len[1])
+            accnet_span_read(&rx, tx.len[0], tx.ptr[1], tx.len[1]);
+        doorbell = accnet_get_time(accnet);
+        accnet_tx_commit(accnet, &tx, size);
+        accnet_rx_release(accnet, &rx, size);
+
+        /* The engine stamps TX_RING_LAST_TIMESTAMP when the reply leaves */
+        deadline = doorbell + (uint64_t)BD_TX_WAIT_US * CPU_FREQ_MHZ;
+        while ((tx_ts = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row))) == last_tx_ts &&
+               accnet_get_time(accnet) < deadline)
+            ;
+
+        /* Off the measured path: the reply is already out */
+        if (iocache_get_row_ktimes(iocache, &kt) != 0)
+            break;
+
+        irq = kt.isr_ns > last_isr && kt.entry_ns && kt.entry_ns <= kt.claim_ns &&
+              kt.claim_ns <= kt.isr_ns && kt.isr_ns <= kt.wake_ns && kt.wake_ns <= user_ns;
+        last_isr = kt.isr_ns;
+
+        if (irq) {
+            bd_record(&h[BD_NIC_RX_TO_IRQ], accnet_clock_to_ns(&clk, rx_ts), kt.entry_ns, &nSkew);
+            hdr_hist_record(&h[BD_IRQ_TO_CLAIM], kt.claim_ns - kt.entry_ns);
+            hdr_hist_record(&h[BD_CLAIM_TO_ISR], kt.isr_ns - kt.claim_ns);
+            hdr_hist_record(&h[BD_ISR_TO_RUN],   kt.wake_ns - kt.isr_ns);
+            hdr_hist_record(&h[BD_RUN_TO_USER],  user_ns - kt.wake_ns);
+        } else {
+            nNoIrq++;
+        }
+        bd_record(&h[BD_USER_TO_DOORBELL], user_ns, accnet_clock_to_ns(&clk, doorbell), &nSkew);
+
+        if (tx_ts != last_tx_ts) {
+            hdr_hist_record(&h[BD_DOORBELL_TO_NIC_TX], (uint64_t)((tx_ts - doorbell) * clk.ns_per_tick));
+            if (tx_ts > rx_ts)
+                hdr_hist_record(&h[BD_TOTAL], (uint64_t)((tx_ts - rx_ts) * clk.ns_per_tick));
+            last_tx_ts = tx_ts;
+        } else {
+            nNoTxStamp++;
+        }
+        nSamples++;
+
+        if (debug) {
+            printf("breakdown: size=%u irq=%d rx_ts=%" PRIu64 " doorbell=%" PRIu64 " tx_ts=%" PRIu64 "\n",
+                   size, irq, rx_ts, doorbell, tx_ts);
+        }
+    }
+
+    printf("\nResults (%s, breakdown): samples=%" PRIu64 " no-irq=%" PRIu64 " no-tx-stamp=%" PRIu64
+           " clock-skew=%" PRIu64 "\n", MODE_SERVER, nSamples, nNoIrq, nNoTxStamp, nSkew);
+    for (int s = 0; s < BD_STAGE_COUNT; s++)
+        hdr_hist_print(stdout, &h[s], bd_names[s], 1e-3, "us");
+    printf("\n");
+
+    if (hist_out) {
+        char path[256];
+        for (int s = 0; s < BD_STAGE_COUNT; s++) {
+            snprintf(path, sizeof(path), "%s-%s", hist_out, bd_tags[s]);
+            if (hdr_hist_save(&h[s], path) != 0)
+                perror("hdr_hist_save");
+        }
+        printf("Wrote stage histograms (ns) to %s-*\n", hist_out);
+    }
+    free(h);
+}
+
+#define DEMUX_MAX_FLOWS     1024
+#define DEMUX_QUEUE_BYTES   (16 * 1024)
+#define DEMUX_IDLE_MS       1000
+
+/*
+ * Wildcard-row sink: one row takes framed datagrams from any peer, the demux
+ * splits them into per-sender queues and each ready flow is drained in turn.
+ *
+ * Receive only. The engine sends every TX record to the row's DST_IP and
+ * DST_PORT, which are the match-any zeros on a wildcard row. Retargeting
+ * them per reply would also change what the row matches, so replies have
+ * no path to their senders.
+ */
+void test_udp_server_demux(struct accnet_info *accnet, bool debug) {
+    struct accnet_reactor reactor;
+    struct accnet_demux demux;
+    struct accnet_flow *flow;
+    uint8_t *buf = malloc(ACCNET_FRAME_MAX_LEN);
+    struct accnet_msg msg = { .buf = buf, .buf_len = ACCNET_FRAME_MAX_LEN };
+    uint64_t nMsgs = 0, nBytes = 0, nFlowsSeen = 0;
+
+    if (!buf || accnet_demux_init(&demux, accnet, DEMUX_MAX_FLOWS, DEMUX_QUEUE_BYTES) != 0) {
+        perror("accnet_demux_init");
+        free(buf);
+        return;
+    }
+
+    /* Senders come and go; an idle one gives its slot back */
+    demux.idle_ns = (uint64_t)DEMUX_IDLE_MS * 1000000ULL;
+
+    accnet_reactor_init(&reactor);
+    reactor.poll_spins = 0;
+    accnet_reactor_add(&reactor, accnet, accnet_demux_rx_handler, &demux);
+
+    while (!g_got_sigint) {
+        if (accnet_reactor_run_once(&reactor) < 0)
+            break;
+        accnet_demux_expire(&demux, false);
+
+        while ((flow = accnet_demux_next_ready(&demux)) != NULL) {
+            if (flow->user == NULL) {
+                flow->user = flow;  /* first time we serve it */
+                nFlowsSeen++;
+                if (debug)
+                    printf("demux: new flow %u.%u.%u.%u:%u\n",
+                           (flow->src_ip >> 24) & 0xff, (flow->src_ip >> 16) & 0xff,
+                           (flow->src_ip >> 8) & 0xff, flow->src_ip & 0xff, flow->src_port);
             }
 
-            // Copy from RX ring -> TX ring
-            memcpy((char *)iocache->udp_tx_buffer + tx_tail, (char *)iocache->udp_rx_buffer + rx_head, size);
+            while (accnet_flow_recv(flow, &msg)) {
+                nMsgs++;
+                nBytes += msg.msg_len;
+            }
+        }
+    }
 
-            // We are done consuming RX bytes up to rx_tail: publish new RX_HEAD
-            mmio_wmb();
-            reg_write32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row), rx_tail);
+    printf("\nResults (%s, wildcard): records=%" PRIu64 " msgs=%" PRIu64 " bytes=%" PRIu64 " flows=%" PRIu64
+           " live=%u expired=%" PRIu64 " drops(no flow)=%" PRIu64 " drops(queue)=%" PRIu64
+           " resyncs=%" PRIu64 "\n\n",
+                    MODE_SERVER, demux.records, nMsgs, nBytes, nFlowsSeen, demux.count, demux.expired,
+                    demux.drops_no_flow, demux.drops_queue_full, demux.resyncs);
 
-            // Advance TX tail and notify HW
-            new_tx_tail = (tx_tail + size) % iocache->udp_tx_size;
+    accnet_demux_free(&demux);
+    free(buf);
+}
+
+/*
+ * Open-loop client: for each offered rate in @rates (comma separated, pps),
+ * send @count framed requests on a Poisson or fixed schedule and print one
+ * row of latency vs offered load. Latencies are coordinated-omission
+ * corrected (measured from when each request was due). Uncorrected service
+ * latency is shown next to them. Needs a framed echo server on the other side.
+ */
+static int test_udp_open_loop(struct accnet_info *accnet, struct connection_info *conn,
+                              const uint8_t payload[], uint32_t payload_size, const char *rates,
+                              enum accnet_arrival arrival, uint64_t count, uint64_t seed, uint32_t drain_us,
+                              int rx_cpu, const char *hist_out, bool write_csv) {
+    struct accnet_loadgen_result *res = malloc(sizeof(*res));
+    struct accnet_loadgen_cfg cfg = {
+        .accnet       = accnet,
+        .conn         = conn,
+        .payload      = payload,
+        .payload_size = (uint16_t)payload_size,
+        .arrival      = arrival,
+        .count        = count,
+        .seed         = seed,
+        .drain_us     = drain_us,
+        .rx_cpu       = rx_cpu,
+        .stop         = &g_got_sigint,
+    };
+    FILE *fout = NULL;
+    char *list, *save = NULL;
 
-            mmio_wmb();
-            reg_write32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row), new_tx_tail);
-            after = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+    if (!res || !(list = strdup(rates))) {
+        perror("malloc");
+        free(res);
+        return -1;
+    }
+    if (payload_size > ACCNET_FRAME_MAX_LEN) {
+        fprintf(stderr, "open loop: payload must be <= %u bytes\n", ACCNET_FRAME_MAX_LEN);
+        free(list);
+        free(res);
+        return -1;
+    }
 
-            // update our software view
-            rx_head = rx_tail;
-            tx_tail = new_tx_tail;
-            nPackets++;
-            volatile rx_timestamp = reg_read64(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_LAST_TIMESTAMP(row));
-            volatile tx_timestamp = reg_read64(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_LAST_TIMESTAMP(row));
-            total_ticks += tx_timestamp - rx_timestamp;
-            total_ticks_2 += after - rx_timestamp;
+    if (write_csv) {
+        char out_path[128];
+        snprintf(out_path, sizeof(out_path), "out-accio-open-%u-%u.csv", payload_size, conn->src_port);
+        fout = fopen(out_path, "w");
+        if (!fout) {
+            perror("fopen out-accio-open-[payload]-[srcPort].csv");
+        } else {
+            fprintf(fout, "offered_pps,sent_pps,recv_pps,sent,recv,unmatched,tx_stalls,max_lag(us),"
+                          "p50(us),p90(us),p99(us),p99.9(us),p99.99(us),max(us),"
+                          "svc_p50(us),svc_p99(us),svc_p99.9(us)\n");
+            printf("Writing results to %s\n", out_path);
         }
-        else {
-            // timeout path (no-op)
+    }
+
+    printf("\nOpen loop (%s arrivals, %" PRIu64 " requests/step, payload %u B), latency in us\n",
+           arrival == ACCNET_ARRIVAL_POISSON ? "poisson" : "fixed", count, payload_size);
+    printf("%12s %12s %12s %8s %9s %9s %9s %9s %9s | %9s %9s\n",
+           "offered_pps", "sent_pps", "recv_pps", "loss%",
+           "p50", "p99", "p99.9", "p99.99", "max", "svc_p50", "svc_p99");
+
+    for (char *tok = strtok_r(list, ",", &save); tok && !g_got_sigint; tok = strtok_r(NULL, ",", &save)) {
+        cfg.rate_pps = atof(tok);
+        if (accnet_loadgen_run(&cfg, res) != 0) {
+            fprintf(stderr, "open loop: bad step '%s': %s\n", tok, strerror(errno));
+            continue;
+        }
+        cfg.first_seq += (uint32_t)res->sent;
+
+        const struct hdr_hist *h = &res->corrected;
+        double loss = res->sent ? 100.0 * (res->sent - res->received) / (double)res->sent : 0.0;
+
+        printf("%12.0f %12.0f %12.0f %8.3f %9.2f %9.2f %9.2f %9.2f %9.2f | %9.2f %9.2f\n",
+               res->offered_pps, res->sent_pps, res->recv_pps, loss,
+               hdr_hist_percentile(h, 50.0) * US_PER_TICK,
+               hdr_hist_percentile(h, 99.0) * US_PER_TICK,
+               hdr_hist_percentile(h, 99.9) * US_PER_TICK,
+               hdr_hist_percentile(h, 99.99) * US_PER_TICK,
+               h->max * US_PER_TICK,
+               hdr_hist_percentile(&res->service, 50.0) * US_PER_TICK,
+               hdr_hist_percentile(&res->service, 99.0) * US_PER_TICK);
+        if (res->unmatched || res->resyncs || res->tx_stalls)
+            printf("%12s unmatched=%" PRIu64 " resyncs=%" PRIu64 " tx_stalls=%" PRIu64 " max_lag=%.2f us\n", "",
+                   res->unmatched, res->resyncs, res->tx_stalls, res->max_lag_ticks * US_PER_TICK);
+
+        if (fout) {
+            fprintf(fout, "%.0f,%.0f,%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,"
+                          "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    res->offered_pps, res->sent_pps, res->recv_pps, res->sent, res->received,
+                    res->unmatched, res->tx_stalls, res->max_lag_ticks * US_PER_TICK,
+                    hdr_hist_percentile(h, 50.0) * US_PER_TICK,
+                    hdr_hist_percentile(h, 90.0) * US_PER_TICK,
+                    hdr_hist_percentile(h, 99.0) * US_PER_TICK,
+                    hdr_hist_percentile(h, 99.9) * US_PER_TICK,
+                    hdr_hist_percentile(h, 99.99) * US_PER_TICK,
+                    h->max * US_PER_TICK,
+                    hdr_hist_percentile(&res->service, 50.0) * US_PER_TICK,
+                    hdr_hist_percentile(&res->service, 99.0) * US_PER_TICK,
+                    hdr_hist_percentile(&res->service, 99.9) * US_PER_TICK);
         }
 
-    } while (!g_got_sigint);
+        /* One corrected histogram per step: <hist_out>-<rate> */
+        if (hist_out) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s-%.0f", hist_out, res->offered_pps);
+            if (hdr_hist_save(h, path) != 0)
+                perror("hdr_hist_save");
+        }
+    }
+    printf("\n");
 
-    printf("\nResults (%s): recv=%d, avg1=%.2f us, avg2=%.2f us\n\n",
-                    MODE_SERVER, nPackets, 
-                    (total_ticks / (double)nPackets) * US_PER_TICK,
-                    (total_ticks_2 / (double)nPackets) * US_PER_TICK);
+    if (fout)
+        fclose(fout);
+    free(list);
+    free(res);
+    return 0;
 }
 
 static uint64_t test_loopback_throughput_local(struct accnet_info *accnet, struct iocache_info *iocache,
@@ -852,34 +1404,24 @@ static uint64_t test_loopback_throughput_local(struct accnet_info *accnet, struc
 uint64_t test_udp_latency_block(struct accnet_info *accnet, struct iocache_info *iocache,
 uint8_t payload[], uint32_t payload_size, bool debug) 
 {
-    int row = iocache->row;
     uint64_t before, after;
     uint64_t a1, a2;
     __u64 last_ktimes[5] = {0};
+    struct accnet_span tx, rx;
     int ret;
 
-    /* Preparing to send the payload */
-    uint32_t tx_head, tx_tail, tx_size;
-    tx_head = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    tx_tail = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    tx_size = reg_read32(iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
-
-    /* Preparing to receive the payload */
-    uint32_t rx_head, rx_tail, rx_size;
-    rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    rx_size = reg_read32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row));
-    mmio_rmb();
+    /* Preparing to send the payload; ring state comes from the host-side shadow */
+    if (accnet_tx_reserve(accnet, payload_size, &tx) != 0) {
+        perror("accnet_tx_reserve");
+        return 0;
+    }
+    accnet_span_write(&tx, 0, payload, payload_size);
 
     /* Triggering TX and starting time */
-    memcpy((char *)iocache->udp_tx_buffer + tx_tail, payload, payload_size);
-    uint32_t new_tx_tail = (tx_tail + payload_size) % iocache->udp_tx_size;
-
-
     // clock_gettime(CLOCK_MONOTONIC, &before);
     before = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
     mmio_rmb();
-    reg_write32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row), new_tx_tail);
-    mmio_wmb();
+    accnet_tx_commit(accnet, &tx, payload_size);
 
     /* Waiting for RX */
     ret = iocache_wait_on_rx(iocache);
@@ -887,9 +1429,8 @@ uint8_t payload[], uint32_t payload_size, bool debug)
     mmio_rmb();
 
     /* Updating RX HEAD */
-    rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-    int size = (rx_tail > rx_head) ? rx_tail - rx_head : rx_size - (rx_head - rx_tail);
-    reg_write32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row), rx_tail);
+    accnet_rx_peek(accnet, &rx);
+    accnet_rx_release(accnet, &rx, accnet_span_len(&rx));
 
     if (ret == -1) return 0;
 
@@ -923,72 +1464,56 @@ uint8_t payload[], uint32_t payload_size, bool debug)
     return after - before;
 }
 
-uint64_t test_udp_latency_poll(struct accnet_info *accnet, struct iocache_info *iocache, 
+uint64_t test_udp_latency_poll(struct accnet_info *accnet,
 uint8_t payload[], uint32_t payload_size, bool debug)
 {
     uint64_t before, after;
-    int row = iocache->row;
+    struct ring_info *ring = &accnet->ring;
+    struct accnet_span tx, rx;
 
     int counter = 0;
 
-    uint32_t rx_head, rx_tail, rx_size;
-    uint32_t tx_head, tx_tail, tx_size;
-
-    // Read buffer head/tail
-    rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-    rx_size = reg_read32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row));
-
-
-    tx_head = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    tx_tail = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    tx_size = reg_read32(iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
-    mmio_rmb();
-
     if (debug) {
-        printf("RX_HEAD: %u, RX_TAIL: %u, RX_SIZE: %u\n", rx_head, rx_tail, rx_size);
-        printf("TX_HEAD: %u, TX_TAIL: %u, TX_SIZE: %u\n", tx_head, tx_tail, tx_size);
+        printf("RX_HEAD: %u, RX_TAIL: %u, RX_SIZE: %u\n", ring->rx_head, ring->rx_tail, ring->rx_size);
+        printf("TX_HEAD: %u, TX_TAIL: %u, TX_SIZE: %u\n", ring->tx_head, ring->tx_tail, ring->tx_size);
+    }
+
+    if (accnet_tx_reserve(accnet, payload_size, &tx) != 0) {
+        perror("accnet_tx_reserve");
+        return 0;
     }
 
-    
     if (debug) printf("Copying mem...\n");
-    memcpy((char *)iocache->udp_tx_buffer + tx_tail, payload, payload_size);
-    
-    uint32_t val = (tx_tail + payload_size) % iocache->udp_tx_size;
-    if (debug) printf("Begin Test... (new_tail=%u) \n", val);
+    accnet_span_write(&tx, 0, payload, payload_size);
+
+    if (debug) printf("Begin Test... (new_tail=%u) \n", (tx.pos + payload_size) % ring->tx_size);
     
 
     before = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
     mmio_rmb();
 
-    reg_write32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row), val);
-    do {
-        rx_tail = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_TAIL(row));
-        mmio_rmb();
+    accnet_tx_commit(accnet, &tx, payload_size);
+
+    /* Only RX_TAIL is polled over MMIO, head and sizes come from the shadow */
+    while (accnet_rx_avail(accnet, payload_size) < payload_size && !g_got_sigint) {
         ++counter;
         if (debug) {
-            printf("Waiting for RX (new rx_tail=%u)...\n", rx_tail);
+            printf("Waiting for RX (new rx_tail=%u)...\n", ring->rx_tail);
         }
-    } while (rx_tail != (rx_head + payload_size) % iocache->udp_rx_size && !g_got_sigint);
+    }
     
     after = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
     mmio_rmb();
 
-
-    rx_head = reg_read32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row));
-    rx_size = reg_read32(iocache->regs, IOCACHE_REG_RX_RING_SIZE(row));
-    
-    // Read buffer head/tail
-    tx_head = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_HEAD(row));
-    tx_tail = reg_read32(accnet->udp_tx_regs, ACCNET_UDP_TX_RING_TAIL(row));
-    tx_size = reg_read32(iocache->regs, IOCACHE_REG_TX_RING_SIZE(row));
-    mmio_rmb();
+    accnet_rx_peek(accnet, &rx);
 
     if (debug) {
+        uint8_t *got = malloc(accnet_span_len(&rx));
+
         printf("RX waited %d times\n", counter);
 
-        printf("RX_HEAD: %u, RX_TAIL: %u, RX_SIZE: %u\n", rx_head, rx_tail, rx_size);
-        printf("TX_HEAD: %u, TX_TAIL: %u, TX_SIZE: %u\n", tx_head, tx_tail, tx_size);
+        printf("RX_HEAD: %u, RX_TAIL: %u, RX_SIZE: %u\n", ring->rx_head, ring->rx_tail, ring->rx_size);
+        printf("TX_HEAD: %u, TX_TAIL: %u, TX_SIZE: %u\n", accnet_get_tx_head(accnet), ring->tx_tail, ring->tx_size);
 
         printf("Original Payload:\n");
         for (uint32_t i = 0; i < payload_size; i++) {
@@ -996,18 +1521,75 @@ uint8_t payload[], uint32_t payload_size, bool debug)
         }
         printf("\n");
         printf("RX Payload:\n");
-        for (uint32_t i = rx_head; i < rx_tail; i++) {
-            printf("%02x", ((uint8_t*)iocache->udp_rx_buffer)[i]);
+        if (got) {
+            accnet_span_read(&rx, 0, got, accnet_span_len(&rx));
+            for (uint32_t i = 0; i < accnet_span_len(&rx); i++) {
+                printf("%02x", got[i]);
+            }
+            free(got);
         }
         printf("\n");
     }
 
     // Updating RX HEAD
-    reg_write32(accnet->udp_rx_regs, ACCNET_UDP_RX_RING_HEAD(row), rx_tail);
+    accnet_rx_release(accnet, &rx, accnet_span_len(&rx));
 
     return after - before;
 }
 
+/* One framed request/response; the echo is matched by seq so late replies to earlier requests are skipped */
+uint64_t test_udp_latency_framed(struct accnet_info *accnet, struct iocache_info *iocache,
+                                 struct connection_info *conn, uint8_t payload[], uint32_t payload_size,
+                                 uint32_t seq, bool blocking, bool debug)
+{
+    struct accnet_frame_hdr hdr;
+    struct accnet_frame_iter it;
+    struct accnet_frame frame;
+    uint64_t before, after = 0;
+    bool got = false;
+    int r;
+
+    if (payload_size > ACCNET_FRAME_MAX_LEN) {
+        fprintf(stderr, "framed payload too large (%u)\n", payload_size);
+        return 0;
+    }
+    accnet_frame_hdr_init(&hdr, conn, seq, (uint16_t)payload_size, 0);
+
+    before = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+    mmio_rmb();
+
+    if (accnet_frame_send(accnet, &hdr, payload) != 0) {
+        perror("accnet_frame_send");
+        return 0;
+    }
+
+    while (!got && !g_got_sigint) {
+        if (blocking) {
+            if (iocache_wait_on_rx(iocache) != 0)
+                return 0;   // timeout
+        } else if (accnet_rx_avail(accnet, sizeof(struct accnet_frame_hdr)) < sizeof(struct accnet_frame_hdr)) {
+            continue;
+        }
+
+        accnet_frame_iter_init(accnet, &it);
+        while ((r = accnet_frame_next(&it, &frame)) != 0) {
+            if (r < 0) {
+                if (debug) printf("framed: resync at offset %u\n", it.off);
+                continue;
+            }
+            if (frame.hdr.seq == seq) {
+                after = reg_read64(accnet->regs, ACCNET_CTRL_TIMESTAMP);
+                got = true;
+            } else if (debug) {
+                printf("framed: skipping stale seq %u (want %u)\n", frame.hdr.seq, seq);
+            }
+        }
+        accnet_frame_iter_done(&it);
+    }
+
+    return got ? after - before : 0;
+}
+
 struct timespec timespec_diff(struct timespec *start, struct timespec *end) {
     struct timespec temp;
     temp.tv_sec  = end->tv_sec  - start->tv_sec;
@@ -23,6 +23,8 @@
 #include <time.h>
 #include <termios.h>
 
+#include "udp_echo_mt.h"
+
 #define DEFAULT_ADDR "0.0.0.0"   // listen on all interfaces by default
 #define DEFAULT_PORT 1111
 #define BUF_SIZE     1500        // Typical MTU; bump if you expect larger packets
@@ -47,19 +49,23 @@ static void pin_to_cpu(int cpu) {
 
 static void usage(const char *prog) {
     fprintf(stderr,
-            "Usage: %s [BIND_IP [PORT [CPU]]]\n"
+            "Usage: %s [BIND_IP [PORT [CPU]]] [--threads N ...]\n"
             "  BIND_IP : IPv4 address to bind (default %s)\n"
             "  PORT    : UDP port number (default %d)\n"
             "Examples:\n"
             "  %s                 # listen on 0.0.0.0:%d (all interfaces)\n"
             "  %s 10.0.0.1        # listen on 10.0.0.1:%d\n"
-            "  %s 10.0.0.1 2222   # listen on 10.0.0.1:2222\n",
-            "  %s 10.0.0.1 2222 3 # listen on 10.0.0.1:2222, ping to cpu3\n",
+            "  %s 10.0.0.1 2222   # listen on 10.0.0.1:2222\n"
+            "  %s 10.0.0.1 2222 3 # listen on 10.0.0.1:2222, pin to cpu3\n"
+            "  %s 10.0.0.1 1200 --threads 4 --ports 64 --cbpf\n"
+            "                     # 4 workers on cpus 0-3 serve 1200..1263, steered by rx cpu\n",
             prog, DEFAULT_ADDR, DEFAULT_PORT,
             prog, DEFAULT_PORT,
             prog, DEFAULT_PORT,
             prog,
+            prog,
             prog);
+    udp_echo_usage(stderr);
 }
 
 int main(int argc, char **argv) {
@@ -67,36 +73,53 @@ int main(int argc, char **argv) {
     int port = DEFAULT_PORT;
     int cpu = 3;
 
-    if (argc >= 2) {
-        if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+    struct udp_echo_cfg mt;
+    int npos = 0;
+
+    udp_echo_cfg_init(&mt);
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
             usage(argv[0]);
             return 0;
         }
-        bind_ip = argv[1];
-    }
-    if (argc >= 3) {
-        char *end = NULL;
-        long p = strtol(argv[2], &end, 10);
-        if (!argv[2][0] || (end && *end) || p < 1 || p > 65535) {
-            fprintf(stderr, "Invalid port: %s\n", argv[2]);
+        int rc = udp_echo_parse_opt(&mt, argc, argv, &i);
+        if (rc < 0 || (rc == 0 && argv[i][0] == '-' && argv[i][1] == '-')) {
             usage(argv[0]);
             return 1;
         }
-        port = (int)p;
-    }
-    if (argc >= 4) {
-        char *end = NULL;
-        long p = strtol(argv[3], &end, 10);
-        if (!argv[3][0] || (end && *end) || p < 0 || p > 3) {
-            fprintf(stderr, "Invalid cpu: %s\n", argv[3]);
+        if (rc > 0) continue;
+
+        if (npos == 0) {
+            bind_ip = argv[i];
+        } else if (npos == 1) {
+            char *end = NULL;
+            long p = strtol(argv[i], &end, 10);
+            if (!argv[i][0] || (end && *end) || p < 1 || p > 65535) {
+                fprintf(stderr, "Invalid port: %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+            port = (int)p;
+        } else if (npos == 2) {
+            char *end = NULL;
+            long p = strtol(argv[i], &end, 10);
+            if (!argv[i][0] || (end && *end) || p < 0 || p > 3) {
+                fprintf(stderr, "Invalid cpu: %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+            cpu = (int)p;
+        } else {
             usage(argv[0]);
             return 1;
         }
-        cpu = (int)p;
+        npos++;
     }
-    if (argc > 4) {
-        usage(argv[0]);
-        return 1;
+
+    if (mt.nthreads > 0) {
+        mt.port = (uint16_t)port;
+        return udp_echo_run(&mt, bind_ip);
     }
 
     // pin_to_cpu(cpu);